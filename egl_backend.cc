@@ -0,0 +1,268 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fb.h>
+
+#include "egl_backend.h"
+#include "base/logging.h"
+
+// Under $XDG_RUNTIME_DIR, which only the user can write to
+#define OZONE_EGL_DEFAULT_BACKEND_CACHE "ozone_egl_backend"
+
+static const EGLint g_defaultConfigAttribs[] = {
+    EGL_RED_SIZE, 5,
+    EGL_GREEN_SIZE, 6,
+    EGL_BLUE_SIZE, 5,
+    EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+    EGL_NONE,
+};
+
+static const ozone_egl_BackendEntry g_Backends[] = {
+#if defined(EGL_API_DRM)
+    { "drm", CreateOzoneEglBackendDrm, 1 },
+#endif
+#if defined(EGL_API_BRCM)
+    { "dispmanx", CreateOzoneEglBackendDispmanx, 1 },
+#endif
+    { "vivante", CreateOzoneEglBackendVivante, 1 },
+    { "default", CreateOzoneEglBackendDefault, 1 },
+    { "software", CreateOzoneEglBackendSoftware, 1 },
+    { "surfaceless", CreateOzoneEglBackendSurfaceless, 0 },
+};
+
+static char g_PreferredBackend[32];
+static char g_BackendCachePath[256];
+
+const EGLint* ozone_egl_getDefaultConfigAttribs()
+{
+    return g_defaultConfigAttribs;
+}
+
+const EGLint* OzoneEglBackend::GetConfigAttribs()
+{
+    return g_defaultConfigAttribs;
+}
+
+bool OzoneEglBackend::ChooseConfig(EGLDisplay display, EGLConfig* config)
+{
+    EGLint matchingConfigs = 0;
+
+    if (!eglChooseConfig(display, GetConfigAttribs(), config, 1,
+                         &matchingConfigs))
+    {
+        LOG(ERROR) << "eglChooseConfig failed.";
+        return false;
+    }
+    if (matchingConfigs < 1)
+    {
+        LOG(ERROR) << "No matching configs found";
+        return false;
+    }
+    return true;
+}
+
+EGLSurface OzoneEglBackend::CreateSurface(EGLDisplay display, EGLConfig config,
+                                          NativeWindowType window)
+{
+    return eglCreateWindowSurface(display, config, window, NULL);
+}
+
+EGLSurface OzoneEglBackend::CreateFrontBufferSurface(EGLDisplay display,
+                                                     EGLConfig config,
+                                                     NativeWindowType window)
+{
+    const EGLint attribs[] =
+    {
+        EGL_RENDER_BUFFER, EGL_SINGLE_BUFFER,
+        EGL_NONE
+    };
+
+    return eglCreateWindowSurface(display, config, window, attribs);
+}
+
+bool OzoneEglBackend::Present(ozone_egl_FlipCallback callback, void* data)
+{
+    if (callback)
+        callback(data, ozone_egl_nowUsec());
+    return true;
+}
+
+const ozone_egl_BackendEntry* ozone_egl_getBackends(size_t* count)
+{
+    *count = sizeof(g_Backends) / sizeof(g_Backends[0]);
+    return g_Backends;
+}
+
+// NULL if there is nowhere private to keep the cache.
+static const char* ozone_egl_getBackendCachePath()
+{
+    const char* path = getenv("OZONE_EGL_BACKEND_CACHE");
+    const char* dir;
+
+    if (path && *path)
+        return path;
+    dir = getenv("XDG_RUNTIME_DIR");
+    if (!dir || !*dir)
+        return NULL;
+    snprintf(g_BackendCachePath, sizeof(g_BackendCachePath), "%s/%s", dir,
+             OZONE_EGL_DEFAULT_BACKEND_CACHE);
+    return g_BackendCachePath;
+}
+
+static const ozone_egl_BackendEntry* ozone_egl_findDisplayBackend(
+    const char* name)
+{
+    size_t count, i;
+    const ozone_egl_BackendEntry* entries = ozone_egl_getBackends(&count);
+
+    for (i = 0; i < count; i++)
+    {
+        if (entries[i].display && !strcmp(entries[i].name, name))
+            return &entries[i];
+    }
+    return NULL;
+}
+
+const char* ozone_egl_getPreferredBackend()
+{
+    const char* forced = getenv("OZONE_EGL_BACKEND");
+    const char* path = ozone_egl_getBackendCachePath();
+    ssize_t len;
+    int fd;
+
+    if (forced && *forced)
+        return forced;
+    if (!path)
+        return NULL;
+
+    fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    len = read(fd, g_PreferredBackend, sizeof(g_PreferredBackend) - 1);
+    close(fd);
+    if (len < 0)
+        len = 0;
+    g_PreferredBackend[len] = '\0';
+
+    while (len && (g_PreferredBackend[len - 1] == '\n' ||
+                   g_PreferredBackend[len - 1] == ' '))
+        g_PreferredBackend[--len] = '\0';
+    if (!len)
+        return NULL;
+    if (!ozone_egl_findDisplayBackend(g_PreferredBackend))
+    {
+        LOG(WARNING) << "Ignoring unknown EGL backend in " << path;
+        return NULL;
+    }
+    return g_PreferredBackend;
+}
+
+// Written to a private temporary file and renamed over the cache, so a
+// planted file or symlink is replaced rather than written through.
+void ozone_egl_cachePreferredBackend(const char* name)
+{
+    const char* path = ozone_egl_getBackendCachePath();
+    char temp[sizeof(g_BackendCachePath) + 16];
+    char line[sizeof(g_PreferredBackend) + 1];
+    int len;
+    int fd;
+
+    if (!ozone_egl_findDisplayBackend(name))
+        return;
+    if (!path)
+    {
+        LOG(WARNING) << "Not caching the EGL backend choice: no "
+                        "XDG_RUNTIME_DIR or OZONE_EGL_BACKEND_CACHE";
+        return;
+    }
+
+    snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+    fd = open(temp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+              0600);
+    if (fd < 0 && errno == EEXIST && !unlink(temp))
+        fd = open(temp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                  0600);
+    if (fd < 0)
+    {
+        PLOG(WARNING) << "Cannot cache backend choice in " << path;
+        return;
+    }
+    len = snprintf(line, sizeof(line), "%s\n", name);
+    if (write(fd, line, len) != len || close(fd) || rename(temp, path))
+    {
+        PLOG(WARNING) << "Cannot cache backend choice in " << path;
+        unlink(temp);
+    }
+}
+
+uint64_t ozone_egl_nowUsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+float ozone_egl_refreshRate(uint64_t pixel_clock_hz, int htotal, int vtotal,
+                            int interlaced, int doublescan)
+{
+    float rate;
+
+    if (!pixel_clock_hz || htotal <= 0 || vtotal <= 0)
+        return 0.0f;
+    rate = (float)pixel_clock_hz / ((float)htotal * vtotal);
+    if (interlaced)
+        rate *= 2.0f;
+    if (doublescan)
+        rate /= 2.0f;
+    return rate;
+}
+
+bool ozone_egl_getFbdevOutput(const char* device, ozone_egl_Output* output)
+{
+    struct fb_var_screeninfo var;
+    int fd = open(device, O_RDONLY | O_CLOEXEC);
+    int ret;
+
+    if (fd < 0)
+        return false;
+    ret = ioctl(fd, FBIOGET_VSCREENINFO, &var);
+    close(fd);
+    if (ret)
+        return false;
+
+    memset(output, 0, sizeof(*output));
+    output->id = 0;
+    snprintf(output->name, sizeof(output->name), "%s", device);
+    output->type = OZONE_EGL_OUTPUT_UNKNOWN;
+    // fbdev reports -1 or 0 when the panel size is unknown.
+    output->widthMm = (int)var.width > 0 ? (int)var.width : 0;
+    output->heightMm = (int)var.height > 0 ? (int)var.height : 0;
+    output->modeCount = 1;
+    output->currentMode = 0;
+    output->nativeMode = 0;
+    output->modes[0].width = var.xres;
+    output->modes[0].height = var.yres;
+    output->modes[0].interlaced =
+        (var.vmode & FB_VMODE_MASK) == FB_VMODE_INTERLACED;
+    // pixclock is the pixel period in picoseconds; 0 on drivers that do not
+    // program timings.
+    if (var.pixclock)
+    {
+        output->modes[0].refreshRate = ozone_egl_refreshRate(
+            1000000000000ull / var.pixclock,
+            var.xres + var.left_margin + var.right_margin + var.hsync_len,
+            var.yres + var.upper_margin + var.lower_margin + var.vsync_len,
+            output->modes[0].interlaced,
+            (var.vmode & FB_VMODE_MASK) == FB_VMODE_DOUBLE);
+    }
+    return true;
+}
@@ -0,0 +1,124 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef UI_OZONE_EGL_BACKEND_H_
+#define UI_OZONE_EGL_BACKEND_H_
+
+#include <stddef.h>
+
+#include "egl_wrapper.h"
+
+// A native window system the EGL wrapper can put pixels on. The wrapper owns
+// the generic EGL setup (display init, context, make-current, swap) and asks
+// the backend for everything platform specific.
+class OzoneEglBackend {
+ public:
+  virtual ~OzoneEglBackend() {}
+
+  virtual const char* GetName() const = 0;
+
+  // Cheap check that the platform is present at all (device node, vendor
+  // entry points). Does not open anything that has to be closed again.
+  virtual bool Probe() = 0;
+
+  // Opens the native display and reports its size in pixels.
+  virtual bool Initialize(int* width, int* height) = 0;
+  virtual void Shutdown() {}
+
+  virtual NativeDisplayType GetNativeDisplay() { return EGL_DEFAULT_DISPLAY; }
+  virtual EGLDisplay GetDisplay() { return eglGetDisplay(GetNativeDisplay()); }
+
+  virtual const EGLint* GetConfigAttribs();
+  virtual bool ChooseConfig(EGLDisplay display, EGLConfig* config);
+
+  // Asks the backend to apply an OZONE_EGL_TRANSFORM_* at scanout; called
+  // before CreateNativeWindow(), which then gets the size of the screen.
+  // Returning false makes the wrapper transform the present pass instead.
+  virtual bool SetTransform(int transform) { return false; }
+
+  virtual NativeWindowType CreateNativeWindow(int width, int height) = 0;
+  virtual void DestroyNativeWindow() {}
+  virtual EGLSurface CreateSurface(EGLDisplay display, EGLConfig config,
+                                   NativeWindowType window);
+  // Destroys a surface from CreateSurface() on suspend and teardown; the
+  // native window stays until DestroyNativeWindow(), and resume creates
+  // the next surface on it. Backends that hold the surface's buffers for
+  // scanout let go of them here first.
+  virtual void DestroySurface(EGLDisplay display, EGLSurface surface) {
+    eglDestroySurface(display, surface);
+  }
+  // Surface for OZONE_EGL_FRONT_BUFFER whose rendering goes straight to the
+  // buffer being scanned out. The wrapper checks that EGL really made it
+  // single buffered and otherwise uses CreateSurface(). Backends that copy
+  // out of a pbuffer return EGL_NO_SURFACE.
+  virtual EGLSurface CreateFrontBufferSurface(EGLDisplay display,
+                                              EGLConfig config,
+                                              NativeWindowType window);
+
+  // Called after eglSwapBuffers. Backends that scan out asynchronously call
+  // |callback| when the frame reached the screen; the default reports the
+  // frame as presented immediately.
+  virtual bool Present(ozone_egl_FlipCallback callback, void* data);
+  virtual bool GetVSyncParameters(uint64_t* timebase, uint64_t* interval) {
+    return false;
+  }
+  // OZONE_EGL_PRESENT_* flags describing the times Present() reports.
+  virtual int GetPresentFlags() { return 0; }
+
+  // Connected outputs, the one this backend draws on first. Returns the
+  // number filled in, 0 if the backend cannot tell.
+  virtual int GetOutputs(ozone_egl_Output* outputs, int max_outputs) {
+    return 0;
+  }
+
+  // Hardware cursor plane. |pixels| are tightly packed premultiplied ARGB,
+  // or NULL to hide it; (x, y) is the top-left corner. Returning false makes
+  // the wrapper composite the cursor in software.
+  virtual bool SetCursor(const void* pixels, int width, int height) {
+    return false;
+  }
+  virtual bool MoveCursor(int x, int y) { return false; }
+};
+
+typedef OzoneEglBackend* (*OzoneEglBackendFactory)();
+
+typedef struct
+{
+   const char* name;
+   OzoneEglBackendFactory create;
+   // Set for backends that put pixels on a screen; headless ones are never
+   // benchmarked or cached.
+   int display;
+} ozone_egl_BackendEntry;
+
+// Compiled-in backends in probing priority order.
+const ozone_egl_BackendEntry* ozone_egl_getBackends(size_t* count);
+
+// Config used before any backend is up and by backends without overrides.
+const EGLint* ozone_egl_getDefaultConfigAttribs();
+
+// Backend name forced through OZONE_EGL_BACKEND, or the winner of the last
+// self-benchmark cached in OZONE_EGL_BACKEND_CACHE (by default in
+// $XDG_RUNTIME_DIR). NULL if neither is set or the cache does not name a
+// registered display backend.
+const char* ozone_egl_getPreferredBackend();
+void ozone_egl_cachePreferredBackend(const char* name);
+
+uint64_t ozone_egl_nowUsec();
+
+// Refresh rate of a mode from its pixel clock and total (visible + blanking)
+// size; interlaced modes show two fields per frame.
+float ozone_egl_refreshRate(uint64_t pixel_clock_hz, int htotal, int vtotal,
+                            int interlaced, int doublescan);
+
+// Describes the fbdev head behind |device| from its current video mode.
+bool ozone_egl_getFbdevOutput(const char* device, ozone_egl_Output* output);
+
+OzoneEglBackend* CreateOzoneEglBackendDrm();
+OzoneEglBackend* CreateOzoneEglBackendDispmanx();
+OzoneEglBackend* CreateOzoneEglBackendVivante();
+OzoneEglBackend* CreateOzoneEglBackendDefault();
+OzoneEglBackend* CreateOzoneEglBackendSoftware();
+OzoneEglBackend* CreateOzoneEglBackendSurfaceless();
+
+#endif
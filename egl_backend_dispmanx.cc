@@ -0,0 +1,230 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bcm_host.h"
+
+#include "egl_backend.h"
+#include "base/logging.h"
+
+namespace {
+
+// Above the main element.
+const int32_t kCursorLayer = 2000;
+
+class OzoneEglBackendDispmanx : public OzoneEglBackend {
+ public:
+  OzoneEglBackendDispmanx()
+      : display_(0), element_(0), cursor_resource_(0), cursor_element_(0),
+        cursor_width_(0), cursor_height_(0), transform_(DISPMANX_NO_ROTATE) {
+    memset(&window_, 0, sizeof(window_));
+  }
+
+  const char* GetName() const override { return "dispmanx"; }
+
+  bool Probe() override {
+    return access("/dev/vchiq", R_OK | W_OK) == 0;
+  }
+
+  bool Initialize(int* width, int* height) override {
+    bcm_host_init();
+
+    uint32_t w = 1280;
+    uint32_t h = 720;
+    if (graphics_get_display_size(0, &w, &h) >= 0)
+      LOG(INFO) << "Detected display size: " << w << "x" << h;
+    else
+      LOG(ERROR) << "Failed to detect display size, using default: " << w
+                 << "x" << h;
+    *width = w;
+    *height = h;
+    return true;
+  }
+
+  void Shutdown() override {
+    bcm_host_deinit();
+  }
+
+  // The firmware latches the element's new buffer at vsync; the swap
+  // returns before that, so the time is still the CPU's.
+  int GetPresentFlags() override {
+    return OZONE_EGL_PRESENT_VSYNC | OZONE_EGL_PRESENT_ZERO_COPY;
+  }
+
+  // The firmware composites everything onto display 0; the TV service knows
+  // its timing when it is HDMI or composite.
+  int GetOutputs(ozone_egl_Output* outputs, int max_outputs) override {
+    uint32_t width, height;
+    TV_DISPLAY_STATE_T state;
+
+    if (max_outputs < 1 || graphics_get_display_size(0, &width, &height) < 0)
+      return 0;
+
+    ozone_egl_Output* output = outputs;
+    memset(output, 0, sizeof(*output));
+    snprintf(output->name, sizeof(output->name), "dispmanx-0");
+    output->type = OZONE_EGL_OUTPUT_INTERNAL;
+    output->modeCount = 1;
+    output->modes[0].width = width;
+    output->modes[0].height = height;
+
+    memset(&state, 0, sizeof(state));
+    if (vc_tv_get_display_state(&state) == 0) {
+      if (state.state & (VC_HDMI_HDMI | VC_HDMI_DVI)) {
+        output->type = (state.state & VC_HDMI_HDMI) ? OZONE_EGL_OUTPUT_HDMI
+                                                    : OZONE_EGL_OUTPUT_DVI;
+        output->modes[0].refreshRate = state.display.hdmi.frame_rate;
+        output->modes[0].interlaced = state.display.hdmi.scan_mode;
+      } else if (state.state & (VC_SDTV_NTSC | VC_SDTV_PAL)) {
+        output->type = OZONE_EGL_OUTPUT_UNKNOWN;
+        output->modes[0].refreshRate = state.display.sdtv.frame_rate;
+        output->modes[0].interlaced = state.display.sdtv.scan_mode;
+      }
+    }
+    return 1;
+  }
+
+  // The HVS mirrors elements in either direction, which covers half turns;
+  // quarter turns need the transposer and are left to the present pass.
+  bool SetTransform(int transform) override {
+    switch (transform) {
+      case OZONE_EGL_TRANSFORM_NORMAL:
+        transform_ = DISPMANX_NO_ROTATE;
+        return true;
+      case OZONE_EGL_TRANSFORM_ROT_180:
+        transform_ = DISPMANX_ROTATE_180;
+        return true;
+      case OZONE_EGL_TRANSFORM_FLIP_H:
+        transform_ = DISPMANX_FLIP_HRIZ;
+        return true;
+      case OZONE_EGL_TRANSFORM_FLIP_V:
+        transform_ = DISPMANX_FLIP_VERT;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  NativeWindowType CreateNativeWindow(int width, int height) override {
+    VC_RECT_T dst_rect;
+    VC_RECT_T src_rect;
+
+    dst_rect.x = 0;
+    dst_rect.y = 0;
+    dst_rect.width = width;
+    dst_rect.height = height;
+
+    src_rect.x = 0;
+    src_rect.y = 0;
+    src_rect.width = width << 16;
+    src_rect.height = height << 16;
+
+    display_ = vc_dispmanx_display_open(0);
+    DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
+    element_ = vc_dispmanx_element_add(update, display_, 0, &dst_rect, 0,
+                                       &src_rect, DISPMANX_PROTECTION_NONE,
+                                       0, 0, transform_);
+    vc_dispmanx_update_submit_sync(update);
+
+    window_.element = element_;
+    window_.width = width;
+    window_.height = height;
+    return static_cast<NativeWindowType>(&window_);
+  }
+
+  bool SetCursor(const void* pixels, int width, int height) override {
+    if (!display_)
+      return false;
+    RemoveCursor();
+    if (!pixels)
+      return true;
+
+    uint32_t image_handle;
+    cursor_resource_ = vc_dispmanx_resource_create(VC_IMAGE_ARGB8888, width,
+                                                   height, &image_handle);
+    if (!cursor_resource_)
+      return false;
+
+    VC_RECT_T rect;
+    vc_dispmanx_rect_set(&rect, 0, 0, width, height);
+    vc_dispmanx_resource_write_data(cursor_resource_, VC_IMAGE_ARGB8888,
+                                    width * 4, const_cast<void*>(pixels),
+                                    &rect);
+    cursor_width_ = width;
+    cursor_height_ = height;
+
+    VC_RECT_T src_rect;
+    vc_dispmanx_rect_set(&src_rect, 0, 0, width << 16, height << 16);
+    VC_DISPMANX_ALPHA_T alpha = {
+        static_cast<DISPMANX_FLAGS_ALPHA_T>(DISPMANX_FLAGS_ALPHA_FROM_SOURCE |
+                                            DISPMANX_FLAGS_ALPHA_PREMULT),
+        255, 0};
+    DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
+    cursor_element_ = vc_dispmanx_element_add(
+        update, display_, kCursorLayer, &rect, cursor_resource_, &src_rect,
+        DISPMANX_PROTECTION_NONE, &alpha, 0, DISPMANX_NO_ROTATE);
+    vc_dispmanx_update_submit_sync(update);
+    return cursor_element_ != 0;
+  }
+
+  bool MoveCursor(int x, int y) override {
+    if (!cursor_element_)
+      return false;
+    VC_RECT_T dst_rect;
+    vc_dispmanx_rect_set(&dst_rect, x, y, cursor_width_, cursor_height_);
+    DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
+    // Bit 2: destination rectangle.
+    vc_dispmanx_element_change_attributes(update, cursor_element_, 1 << 2, 0,
+                                          0, &dst_rect, NULL, 0,
+                                          DISPMANX_NO_ROTATE);
+    // Moves are frequent; do not wait for the compositor.
+    vc_dispmanx_update_submit(update, NULL, NULL);
+    return true;
+  }
+
+  void DestroyNativeWindow() override {
+    RemoveCursor();
+    if (element_) {
+      DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
+      vc_dispmanx_element_remove(update, element_);
+      vc_dispmanx_update_submit_sync(update);
+      element_ = 0;
+    }
+    if (display_) {
+      vc_dispmanx_display_close(display_);
+      display_ = 0;
+    }
+  }
+
+ private:
+  void RemoveCursor() {
+    if (cursor_element_) {
+      DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
+      vc_dispmanx_element_remove(update, cursor_element_);
+      vc_dispmanx_update_submit_sync(update);
+      cursor_element_ = 0;
+    }
+    if (cursor_resource_) {
+      vc_dispmanx_resource_delete(cursor_resource_);
+      cursor_resource_ = 0;
+    }
+  }
+
+  EGL_DISPMANX_WINDOW_T window_;
+  DISPMANX_DISPLAY_HANDLE_T display_;
+  DISPMANX_ELEMENT_HANDLE_T element_;
+  DISPMANX_RESOURCE_HANDLE_T cursor_resource_;
+  DISPMANX_ELEMENT_HANDLE_T cursor_element_;
+  int cursor_width_;
+  int cursor_height_;
+  DISPMANX_TRANSFORM_T transform_;
+};
+
+}  // namespace
+
+OzoneEglBackend* CreateOzoneEglBackendDispmanx() {
+  return new OzoneEglBackendDispmanx();
+}
@@ -0,0 +1,178 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include <EGL/egl.h>
+
+#include "egl_backend.h"
+#include "base/logging.h"
+
+namespace {
+
+// Vivante's libEGL exports these next to the EGL entry points. They are
+// resolved at runtime so one build runs on both Vivante and other GPUs.
+typedef NativeDisplayType (*FbGetDisplayByIndexFunc)(int index);
+typedef void (*FbGetDisplayGeometryFunc)(NativeDisplayType display,
+                                         int* width, int* height);
+typedef NativeWindowType (*FbCreateWindowFunc)(NativeDisplayType display,
+                                               int x, int y,
+                                               int width, int height);
+typedef void (*FbDestroyWindowFunc)(NativeWindowType window);
+typedef void (*FbDestroyDisplayFunc)(NativeDisplayType display);
+
+class OzoneEglBackendVivante : public OzoneEglBackend {
+ public:
+  OzoneEglBackendVivante()
+      : display_(NULL), window_(0),
+        get_display_(NULL), get_geometry_(NULL), create_window_(NULL),
+        destroy_window_(NULL), destroy_display_(NULL) {}
+
+  const char* GetName() const override { return "vivante"; }
+
+  bool Probe() override {
+    get_display_ = reinterpret_cast<FbGetDisplayByIndexFunc>(
+        dlsym(RTLD_DEFAULT, "fbGetDisplayByIndex"));
+    get_geometry_ = reinterpret_cast<FbGetDisplayGeometryFunc>(
+        dlsym(RTLD_DEFAULT, "fbGetDisplayGeometry"));
+    create_window_ = reinterpret_cast<FbCreateWindowFunc>(
+        dlsym(RTLD_DEFAULT, "fbCreateWindow"));
+    destroy_window_ = reinterpret_cast<FbDestroyWindowFunc>(
+        dlsym(RTLD_DEFAULT, "fbDestroyWindow"));
+    destroy_display_ = reinterpret_cast<FbDestroyDisplayFunc>(
+        dlsym(RTLD_DEFAULT, "fbDestroyDisplay"));
+    return get_display_ && get_geometry_ && create_window_;
+  }
+
+  bool Initialize(int* width, int* height) override {
+    display_ = get_display_(0);
+    if (!display_)
+      return false;
+    get_geometry_(display_, width, height);
+    return true;
+  }
+
+  void Shutdown() override {
+    if (display_ && destroy_display_)
+      destroy_display_(display_);
+    display_ = NULL;
+  }
+
+  NativeDisplayType GetNativeDisplay() override { return display_; }
+
+  int GetOutputs(ozone_egl_Output* outputs, int max_outputs) override {
+    if (max_outputs < 1)
+      return 0;
+    if (ozone_egl_getFbdevOutput("/dev/fb0", outputs))
+      return 1;
+    // No fbdev node to read timings from; geometry is all there is.
+    memset(outputs, 0, sizeof(*outputs));
+    get_geometry_(display_, &outputs->modes[0].width,
+                  &outputs->modes[0].height);
+    outputs->modeCount = 1;
+    return 1;
+  }
+
+  NativeWindowType CreateNativeWindow(int width, int height) override {
+    window_ = create_window_(display_, 0, 0, width, height);
+    return window_;
+  }
+
+  void DestroyNativeWindow() override {
+    if (window_ && destroy_window_)
+      destroy_window_(window_);
+    window_ = 0;
+  }
+
+ private:
+  NativeDisplayType display_;
+  NativeWindowType window_;
+  FbGetDisplayByIndexFunc get_display_;
+  FbGetDisplayGeometryFunc get_geometry_;
+  FbCreateWindowFunc create_window_;
+  FbDestroyWindowFunc destroy_window_;
+  FbDestroyDisplayFunc destroy_display_;
+};
+
+// Mali-style fbdev EGL: the default display scans out /dev/fb0 and the
+// native window is a plain width/height pair.
+typedef struct fbdev_window
+{
+    unsigned short width;
+    unsigned short height;
+} fbdev_window;
+
+class OzoneEglBackendDefault : public OzoneEglBackend {
+ public:
+  OzoneEglBackendDefault() : window_(NULL) {}
+
+  const char* GetName() const override { return "default"; }
+
+  bool Probe() override {
+    if (access("/dev/fb0", R_OK | W_OK))
+      return false;
+    // Desktops get a /dev/fb0 from fbdev emulation (efifb, simpledrm) too.
+    // Only ARM's EGL takes an fbdev_window; any other crashes in
+    // eglCreateWindowSurface instead of letting the next backend run.
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+      return false;
+    const char* vendor = eglQueryString(display, EGL_VENDOR);
+    bool mali = vendor && strstr(vendor, "ARM") != NULL;
+    if (!mali)
+      LOG(INFO) << "Skipping fbdev EGL from " << (vendor ? vendor : "?");
+    eglTerminate(display);
+    return mali;
+  }
+
+  bool Initialize(int* width, int* height) override {
+    struct fb_var_screeninfo fb_var;
+    int fd = open("/dev/fb0", O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+    int ret = ioctl(fd, FBIOGET_VSCREENINFO, &fb_var);
+    close(fd);
+    if (ret)
+      return false;
+    *width = fb_var.xres;
+    *height = fb_var.yres;
+    return true;
+  }
+
+  int GetOutputs(ozone_egl_Output* outputs, int max_outputs) override {
+    return max_outputs > 0 && ozone_egl_getFbdevOutput("/dev/fb0", outputs);
+  }
+
+  NativeWindowType CreateNativeWindow(int width, int height) override {
+    window_ = static_cast<fbdev_window*>(malloc(sizeof(fbdev_window)));
+    if (!window_)
+      return 0;
+    window_->width = width;
+    window_->height = height;
+    return (NativeWindowType)window_;
+  }
+
+  void DestroyNativeWindow() override {
+    free(window_);
+    window_ = NULL;
+  }
+
+ private:
+  fbdev_window* window_;
+};
+
+}  // namespace
+
+OzoneEglBackend* CreateOzoneEglBackendVivante() {
+  return new OzoneEglBackendVivante();
+}
+
+OzoneEglBackend* CreateOzoneEglBackendDefault() {
+  return new OzoneEglBackendDefault();
+}
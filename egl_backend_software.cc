@@ -0,0 +1,152 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+
+#include "egl_backend.h"
+#include "base/logging.h"
+
+namespace {
+
+const EGLint kPbufferConfigAttribs[] = {
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_NONE,
+};
+
+// Last resort for boards whose EGL cannot scan out: render into a pbuffer
+// and copy every frame into the mapped fbdev framebuffer.
+class OzoneEglBackendSoftware : public OzoneEglBackend {
+ public:
+  OzoneEglBackendSoftware()
+      : fd_(-1), map_(NULL), map_size_(0), width_(0), height_(0),
+        readback_(NULL) {
+    memset(&var_, 0, sizeof(var_));
+    memset(&fix_, 0, sizeof(fix_));
+  }
+
+  const char* GetName() const override { return "software"; }
+
+  bool Probe() override {
+    return access("/dev/fb0", R_OK | W_OK) == 0;
+  }
+
+  bool Initialize(int* width, int* height) override {
+    fd_ = open("/dev/fb0", O_RDWR | O_CLOEXEC);
+    if (fd_ < 0)
+      return false;
+    if (ioctl(fd_, FBIOGET_VSCREENINFO, &var_) ||
+        ioctl(fd_, FBIOGET_FSCREENINFO, &fix_) ||
+        (var_.bits_per_pixel != 16 && var_.bits_per_pixel != 32)) {
+      LOG(ERROR) << "Unsupported framebuffer format";
+      Shutdown();
+      return false;
+    }
+    map_size_ = fix_.line_length * var_.yres_virtual;
+    map_ = static_cast<uint8_t*>(
+        mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+    if (map_ == MAP_FAILED) {
+      map_ = NULL;
+      Shutdown();
+      return false;
+    }
+    *width = width_ = var_.xres;
+    *height = height_ = var_.yres;
+    readback_ = static_cast<uint8_t*>(malloc(width_ * height_ * 4));
+    return readback_ != NULL;
+  }
+
+  void Shutdown() override {
+    free(readback_);
+    readback_ = NULL;
+    if (map_)
+      munmap(map_, map_size_);
+    map_ = NULL;
+    if (fd_ >= 0)
+      close(fd_);
+    fd_ = -1;
+  }
+
+  const EGLint* GetConfigAttribs() override { return kPbufferConfigAttribs; }
+
+  NativeWindowType CreateNativeWindow(int width, int height) override {
+    return 0;
+  }
+
+  EGLSurface CreateSurface(EGLDisplay display, EGLConfig config,
+                           NativeWindowType window) override {
+    const EGLint attribs[] = {
+        EGL_WIDTH, width_,
+        EGL_HEIGHT, height_,
+        EGL_NONE,
+    };
+    return eglCreatePbufferSurface(display, config, attribs);
+  }
+
+  EGLSurface CreateFrontBufferSurface(EGLDisplay display, EGLConfig config,
+                                      NativeWindowType window) override {
+    return EGL_NO_SURFACE;
+  }
+
+  bool Present(ozone_egl_FlipCallback callback, void* data) override {
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, readback_);
+    uint8_t* dst_base = map_ + var_.yoffset * fix_.line_length +
+                        var_.xoffset * (var_.bits_per_pixel / 8);
+    for (int y = 0; y < height_; y++) {
+      // GL rows are bottom-up.
+      const uint8_t* src = readback_ + (height_ - 1 - y) * width_ * 4;
+      uint8_t* dst = dst_base + y * fix_.line_length;
+      if (var_.bits_per_pixel == 32)
+        CopyRow32(src, reinterpret_cast<uint32_t*>(dst));
+      else
+        CopyRow16(src, reinterpret_cast<uint16_t*>(dst));
+    }
+    return OzoneEglBackend::Present(callback, data);
+  }
+
+  int GetOutputs(ozone_egl_Output* outputs, int max_outputs) override {
+    return max_outputs > 0 && ozone_egl_getFbdevOutput("/dev/fb0", outputs);
+  }
+
+ private:
+  uint32_t Pack(const uint8_t* rgba) const {
+    return ((rgba[0] >> (8 - var_.red.length)) << var_.red.offset) |
+           ((rgba[1] >> (8 - var_.green.length)) << var_.green.offset) |
+           ((rgba[2] >> (8 - var_.blue.length)) << var_.blue.offset);
+  }
+
+  void CopyRow32(const uint8_t* src, uint32_t* dst) const {
+    for (int x = 0; x < width_; x++, src += 4)
+      dst[x] = Pack(src);
+  }
+
+  void CopyRow16(const uint8_t* src, uint16_t* dst) const {
+    for (int x = 0; x < width_; x++, src += 4)
+      dst[x] = static_cast<uint16_t>(Pack(src));
+  }
+
+  int fd_;
+  uint8_t* map_;
+  size_t map_size_;
+  struct fb_var_screeninfo var_;
+  struct fb_fix_screeninfo fix_;
+  int width_;
+  int height_;
+  uint8_t* readback_;
+};
+
+}  // namespace
+
+OzoneEglBackend* CreateOzoneEglBackendSoftware() {
+  return new OzoneEglBackendSoftware();
+}
@@ -0,0 +1,99 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "egl_backend.h"
+#include "base/logging.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace {
+
+const int kDefaultWidth = 1280;
+const int kDefaultHeight = 720;
+
+const EGLint kPbufferConfigAttribs[] = {
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_NONE,
+};
+
+// Headless rendering into a pbuffer. Nothing reaches a screen; useful for
+// CI, benchmarks and devices that only stream their output. The size comes
+// from OZONE_EGL_SURFACELESS_SIZE ("WIDTHxHEIGHT").
+class OzoneEglBackendSurfaceless : public OzoneEglBackend {
+ public:
+  OzoneEglBackendSurfaceless()
+      : width_(kDefaultWidth), height_(kDefaultHeight) {}
+
+  const char* GetName() const override { return "surfaceless"; }
+
+  bool Probe() override {
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    return extensions &&
+           strstr(extensions, "EGL_MESA_platform_surfaceless") &&
+           eglGetProcAddress("eglGetPlatformDisplayEXT");
+  }
+
+  bool Initialize(int* width, int* height) override {
+    const char* size = getenv("OZONE_EGL_SURFACELESS_SIZE");
+    int w, h;
+    if (size && sscanf(size, "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+      width_ = w;
+      height_ = h;
+    }
+    *width = width_;
+    *height = height_;
+    return true;
+  }
+
+  EGLDisplay GetDisplay() override {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    return get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                EGL_DEFAULT_DISPLAY, NULL);
+  }
+
+  const EGLint* GetConfigAttribs() override { return kPbufferConfigAttribs; }
+
+  NativeWindowType CreateNativeWindow(int width, int height) override {
+    return 0;
+  }
+
+  EGLSurface CreateSurface(EGLDisplay display, EGLConfig config,
+                           NativeWindowType window) override {
+    const EGLint attribs[] = {
+        EGL_WIDTH, width_,
+        EGL_HEIGHT, height_,
+        EGL_NONE,
+    };
+    return eglCreatePbufferSurface(display, config, attribs);
+  }
+
+  EGLSurface CreateFrontBufferSurface(EGLDisplay display, EGLConfig config,
+                                      NativeWindowType window) override {
+    return EGL_NO_SURFACE;
+  }
+
+ private:
+  int width_;
+  int height_;
+};
+
+}  // namespace
+
+OzoneEglBackend* CreateOzoneEglBackendSurfaceless() {
+  return new OzoneEglBackendSurfaceless();
+}
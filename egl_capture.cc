@@ -0,0 +1,598 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "egl_backend.h"
+#include "egl_capture.h"
+#include "egl_gl_trace.h"
+#include "base/logging.h"
+
+// Readbacks in flight. A slot is reused only after its pixels were
+// delivered, so with three the GPU gets two frames to finish a copy before
+// a capture is skipped.
+#define OZONE_EGL_CAPTURE_SLOTS 3
+// Swaps to wait before reading back when neither GLES3 fences nor
+// EGL_KHR_fence_sync are available.
+#define OZONE_EGL_CAPTURE_FALLBACK_FRAMES 2
+
+// GLES3 entry points, looked up at runtime since the context is created as
+// GLES2 and the headers may predate GLES3.
+#define OZONE_EGL_GL_PIXEL_PACK_BUFFER 0x88EB
+#define OZONE_EGL_GL_STREAM_READ 0x88E1
+#define OZONE_EGL_GL_MAP_READ_BIT 0x0001
+#define OZONE_EGL_GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define OZONE_EGL_GL_ALREADY_SIGNALED 0x911A
+#define OZONE_EGL_GL_CONDITION_SATISFIED 0x911C
+
+typedef void* ozone_egl_GLSync;
+typedef void* (GL_APIENTRYP ozone_egl_MapBufferRangeProc)(
+    GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (GL_APIENTRYP ozone_egl_UnmapBufferProc)(GLenum target);
+typedef ozone_egl_GLSync (GL_APIENTRYP ozone_egl_FenceSyncProc)(
+    GLenum condition, GLbitfield flags);
+typedef GLenum (GL_APIENTRYP ozone_egl_ClientWaitSyncProc)(
+    ozone_egl_GLSync sync, GLbitfield flags, uint64_t timeout);
+typedef void (GL_APIENTRYP ozone_egl_DeleteSyncProc)(ozone_egl_GLSync sync);
+
+typedef struct
+{
+    // Scaled copy of the captured rectangle, rows top-down
+    GLuint texture;
+    GLuint framebuffer;
+    GLint textureWidth;
+    GLint textureHeight;
+
+    // GLES3: pixel pack buffer the copy is read into without stalling
+    GLuint buffer;
+    GLsizeiptr bufferSize;
+    ozone_egl_GLSync glSync;
+
+    // GLES2: fence after the copy, then glReadPixels into |pixels|
+    EGLSyncKHR eglSync;
+    uint8_t* pixels;
+    size_t pixelsSize;
+
+    int pending;
+    int framesWaited;
+
+    // Delivered rectangle in scaled capture coordinates
+    int x;
+    int y;
+    int width;
+    int height;
+    uint64_t usec;
+} ozone_egl_CaptureSlot;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+
+    int active;
+    ozone_egl_CaptureParams params;
+    ozone_egl_CaptureCallback callback;
+    void* data;
+
+    // Window damage since the last captured frame
+    int damageLeft;
+    int damageTop;
+    int damageRight;
+    int damageBottom;
+    uint64_t lastCaptureUsec;
+
+    // GL objects, created on the presenting thread
+    int initialized;
+    int gles3;
+    GLuint program;
+    GLint positionLoc;
+    GLint texCoordLoc;
+    GLint samplerLoc;
+    // Unscaled copy of the back buffer
+    GLuint sourceTexture;
+    GLint sourceWidth;
+    GLint sourceHeight;
+    ozone_egl_CaptureSlot slots[OZONE_EGL_CAPTURE_SLOTS];
+    int nextSlot;
+
+    ozone_egl_MapBufferRangeProc mapBufferRange;
+    ozone_egl_UnmapBufferProc unmapBuffer;
+    ozone_egl_FenceSyncProc fenceSync;
+    ozone_egl_ClientWaitSyncProc clientWaitSync;
+    ozone_egl_DeleteSyncProc deleteSync;
+    PFNEGLCREATESYNCKHRPROC createSyncKHR;
+    PFNEGLCLIENTWAITSYNCKHRPROC clientWaitSyncKHR;
+    PFNEGLDESTROYSYNCKHRPROC destroySyncKHR;
+} ozone_egl_CaptureState;
+
+static ozone_egl_CaptureState g_Capture;
+static pthread_once_t g_CaptureOnce = PTHREAD_ONCE_INIT;
+
+static const char kCaptureVertexShader[] =
+    "attribute vec4 a_position;   \n"
+    "attribute vec2 a_texCoord;   \n"
+    "varying vec2 v_texCoord;     \n"
+    "void main()                  \n"
+    "{                            \n"
+    "   gl_Position = a_position; \n"
+    "   v_texCoord = a_texCoord;  \n"
+    "}                            \n";
+
+static const char kCaptureFragmentShader[] =
+    "precision mediump float;                            \n"
+    "varying vec2 v_texCoord;                            \n"
+    "uniform sampler2D s_texture;                        \n"
+    "void main()                                         \n"
+    "{                                                   \n"
+    "  gl_FragColor = texture2D( s_texture, v_texCoord );\n"
+    "}                                                   \n";
+
+static void ozone_egl_captureInitLock()
+{
+    pthread_mutexattr_t attr;
+
+    // Callbacks may stop the capture.
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&g_Capture.lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+class ozone_egl_CaptureLock
+{
+public:
+    ozone_egl_CaptureLock()
+    {
+        pthread_once(&g_CaptureOnce, ozone_egl_captureInitLock);
+        pthread_mutex_lock(&g_Capture.lock);
+    }
+    ~ozone_egl_CaptureLock()
+    {
+        pthread_mutex_unlock(&g_Capture.lock);
+    }
+};
+
+static void ozone_egl_captureClearDamage()
+{
+    g_Capture.damageLeft = g_Capture.damageTop = 0;
+    g_Capture.damageRight = g_Capture.damageBottom = 0;
+}
+
+int ozone_egl_captureStart(const ozone_egl_CaptureParams* params,
+                           ozone_egl_CaptureCallback callback, void* data)
+{
+    ozone_egl_CaptureLock lock;
+
+    if (!callback || params->width < 0 || params->height < 0 ||
+        params->scaledWidth < 0 || params->scaledHeight < 0)
+        return OZONE_EGL_FAILURE;
+
+    g_Capture.params = *params;
+    g_Capture.callback = callback;
+    g_Capture.data = data;
+    g_Capture.lastCaptureUsec = 0;
+    ozone_egl_captureClearDamage();
+    g_Capture.active = 1;
+    return OZONE_EGL_SUCCESS;
+}
+
+void ozone_egl_captureStop()
+{
+    ozone_egl_CaptureLock lock;
+
+    // The GL objects go with the next frame, on the presenting thread.
+    g_Capture.active = 0;
+    g_Capture.callback = NULL;
+    g_Capture.data = NULL;
+}
+
+void ozone_egl_captureDamage(int x, int y, int width, int height)
+{
+    ozone_egl_CaptureLock lock;
+
+    if (!g_Capture.active || width <= 0 || height <= 0)
+        return;
+    if (g_Capture.damageRight <= g_Capture.damageLeft ||
+        g_Capture.damageBottom <= g_Capture.damageTop)
+    {
+        g_Capture.damageLeft = x;
+        g_Capture.damageTop = y;
+        g_Capture.damageRight = x + width;
+        g_Capture.damageBottom = y + height;
+        return;
+    }
+    if (x < g_Capture.damageLeft)
+        g_Capture.damageLeft = x;
+    if (y < g_Capture.damageTop)
+        g_Capture.damageTop = y;
+    if (x + width > g_Capture.damageRight)
+        g_Capture.damageRight = x + width;
+    if (y + height > g_Capture.damageBottom)
+        g_Capture.damageBottom = y + height;
+}
+
+static int ozone_egl_captureInitGL(EGLDisplay display)
+{
+    const char* version = (const char*)OZONE_GL(glGetString)(GL_VERSION);
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+
+    g_Capture.program = ozone_egl_loadProgram(kCaptureVertexShader,
+                                              kCaptureFragmentShader);
+    if (!g_Capture.program)
+        return OZONE_EGL_FAILURE;
+    g_Capture.positionLoc = OZONE_GL(glGetAttribLocation)(g_Capture.program,
+                                                          "a_position");
+    g_Capture.texCoordLoc = OZONE_GL(glGetAttribLocation)(g_Capture.program,
+                                                          "a_texCoord");
+    g_Capture.samplerLoc = OZONE_GL(glGetUniformLocation)(g_Capture.program,
+                                                          "s_texture");
+
+    // Drivers commonly hand out their highest GLES version for a GLES2
+    // context request.
+    if (version && !strncmp(version, "OpenGL ES 3", 11))
+    {
+        g_Capture.mapBufferRange = (ozone_egl_MapBufferRangeProc)
+            eglGetProcAddress("glMapBufferRange");
+        g_Capture.unmapBuffer = (ozone_egl_UnmapBufferProc)
+            eglGetProcAddress("glUnmapBuffer");
+        g_Capture.fenceSync = (ozone_egl_FenceSyncProc)
+            eglGetProcAddress("glFenceSync");
+        g_Capture.clientWaitSync = (ozone_egl_ClientWaitSyncProc)
+            eglGetProcAddress("glClientWaitSync");
+        g_Capture.deleteSync = (ozone_egl_DeleteSyncProc)
+            eglGetProcAddress("glDeleteSync");
+        g_Capture.gles3 = g_Capture.mapBufferRange && g_Capture.unmapBuffer &&
+                          g_Capture.fenceSync && g_Capture.clientWaitSync &&
+                          g_Capture.deleteSync;
+    }
+    if (!g_Capture.gles3 && extensions &&
+        strstr(extensions, "EGL_KHR_fence_sync"))
+    {
+        g_Capture.createSyncKHR = (PFNEGLCREATESYNCKHRPROC)
+            eglGetProcAddress("eglCreateSyncKHR");
+        g_Capture.clientWaitSyncKHR = (PFNEGLCLIENTWAITSYNCKHRPROC)
+            eglGetProcAddress("eglClientWaitSyncKHR");
+        g_Capture.destroySyncKHR = (PFNEGLDESTROYSYNCKHRPROC)
+            eglGetProcAddress("eglDestroySyncKHR");
+        if (!g_Capture.clientWaitSyncKHR || !g_Capture.destroySyncKHR)
+            g_Capture.createSyncKHR = NULL;
+    }
+    LOG(INFO) << "Frame capture reads back through "
+              << (g_Capture.gles3 ? "pixel pack buffers" :
+                  g_Capture.createSyncKHR ? "EGL fences" : "delayed reads");
+    g_Capture.initialized = 1;
+    return OZONE_EGL_SUCCESS;
+}
+
+static void ozone_egl_captureReleaseSlot(EGLDisplay display,
+                                         ozone_egl_CaptureSlot* slot)
+{
+    if (slot->glSync)
+        g_Capture.deleteSync(slot->glSync);
+    if (slot->eglSync)
+        g_Capture.destroySyncKHR(display, slot->eglSync);
+    slot->glSync = NULL;
+    slot->eglSync = NULL;
+    slot->pending = 0;
+}
+
+void ozone_egl_captureReset(EGLDisplay display)
+{
+    ozone_egl_CaptureLock lock;
+    int i;
+
+    if (!g_Capture.initialized)
+        return;
+    for (i = 0; i < OZONE_EGL_CAPTURE_SLOTS; i++)
+    {
+        ozone_egl_CaptureSlot* slot = &g_Capture.slots[i];
+
+        ozone_egl_captureReleaseSlot(display, slot);
+        OZONE_GL(glDeleteFramebuffers)(1, &slot->framebuffer);
+        OZONE_GL(glDeleteTextures)(1, &slot->texture);
+        if (slot->buffer)
+            OZONE_GL(glDeleteBuffers)(1, &slot->buffer);
+        free(slot->pixels);
+        memset(slot, 0, sizeof(*slot));
+    }
+    OZONE_GL(glDeleteTextures)(1, &g_Capture.sourceTexture);
+    OZONE_GL(glDeleteProgram)(g_Capture.program);
+    g_Capture.sourceTexture = 0;
+    g_Capture.sourceWidth = 0;
+    g_Capture.sourceHeight = 0;
+    g_Capture.program = 0;
+    g_Capture.gles3 = 0;
+    g_Capture.createSyncKHR = NULL;
+    g_Capture.nextSlot = 0;
+    g_Capture.initialized = 0;
+}
+
+// Returns non-zero once the copy of |slot| finished on the GPU.
+static int ozone_egl_captureReady(EGLDisplay display,
+                                  ozone_egl_CaptureSlot* slot)
+{
+    GLenum gl_status;
+
+    if (slot->glSync)
+    {
+        gl_status = g_Capture.clientWaitSync(slot->glSync, 0, 0);
+        return gl_status == OZONE_EGL_GL_ALREADY_SIGNALED ||
+               gl_status == OZONE_EGL_GL_CONDITION_SATISFIED;
+    }
+    if (slot->eglSync)
+        return g_Capture.clientWaitSyncKHR(display, slot->eglSync, 0, 0) ==
+               EGL_CONDITION_SATISFIED_KHR;
+    return ++slot->framesWaited > OZONE_EGL_CAPTURE_FALLBACK_FRAMES;
+}
+
+static void ozone_egl_captureDeliver(EGLDisplay display,
+                                     ozone_egl_CaptureSlot* slot)
+{
+    int stride = slot->width * 4;
+    GLsizeiptr bytes = (GLsizeiptr)stride * slot->height;
+    void* pixels;
+
+    if (g_Capture.gles3)
+    {
+        // The mapping is handed out as is.
+        OZONE_GL(glBindBuffer)(OZONE_EGL_GL_PIXEL_PACK_BUFFER, slot->buffer);
+        pixels = g_Capture.mapBufferRange(OZONE_EGL_GL_PIXEL_PACK_BUFFER, 0,
+                                          bytes, OZONE_EGL_GL_MAP_READ_BIT);
+        if (pixels && g_Capture.callback)
+            g_Capture.callback(g_Capture.data, (const uint8_t*)pixels, stride,
+                               slot->x, slot->y, slot->width, slot->height,
+                               slot->usec);
+        if (pixels)
+            g_Capture.unmapBuffer(OZONE_EGL_GL_PIXEL_PACK_BUFFER);
+        OZONE_GL(glBindBuffer)(OZONE_EGL_GL_PIXEL_PACK_BUFFER, 0);
+    }
+    else
+    {
+        // The copy is done, so this read does not wait for rendering.
+        OZONE_GL(glBindFramebuffer)(GL_FRAMEBUFFER, slot->framebuffer);
+        OZONE_GL(glReadPixels)(0, 0, slot->width, slot->height, GL_RGBA,
+                               GL_UNSIGNED_BYTE, slot->pixels);
+        OZONE_GL(glBindFramebuffer)(GL_FRAMEBUFFER, 0);
+        if (g_Capture.callback)
+            g_Capture.callback(g_Capture.data, slot->pixels, stride,
+                               slot->x, slot->y, slot->width, slot->height,
+                               slot->usec);
+    }
+    ozone_egl_captureReleaseSlot(display, slot);
+}
+
+// Copies the window rectangle |src| of the back buffer into |slot|, scaled
+// to |width| x |height| and flipped to top-down rows, and starts reading
+// it back.
+static void ozone_egl_captureIssue(EGLDisplay display,
+                                   ozone_egl_CaptureSlot* slot,
+                                   int window_width, int window_height,
+                                   int src_x, int src_y,
+                                   int src_width, int src_height,
+                                   int width, int height)
+{
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GLfloat u = (GLfloat)src_width / g_Capture.sourceWidth;
+    GLfloat v = (GLfloat)src_height / g_Capture.sourceHeight;
+    // Window rows are bottom-up; the top of the copy lands at y = -1.
+    GLfloat vVertices[] = { -1.0f,  1.0f, 0.0f, 0.0f, 0.0f,
+                            -1.0f, -1.0f, 0.0f, 0.0f, v,
+                             1.0f, -1.0f, 0.0f, u,    v,
+                             1.0f,  1.0f, 0.0f, u,    0.0f };
+
+    OZONE_GL(glActiveTexture)(GL_TEXTURE0);
+    OZONE_GL(glBindTexture)(GL_TEXTURE_2D, g_Capture.sourceTexture);
+    OZONE_GL(glCopyTexSubImage2D)(GL_TEXTURE_2D, 0, 0, 0, src_x,
+                                  window_height - src_y - src_height,
+                                  src_width, src_height);
+
+    if (width > slot->textureWidth || height > slot->textureHeight)
+    {
+        if (!slot->texture)
+        {
+            OZONE_GL(glGenTextures)(1, &slot->texture);
+            OZONE_GL(glGenFramebuffers)(1, &slot->framebuffer);
+        }
+        OZONE_GL(glBindTexture)(GL_TEXTURE_2D, slot->texture);
+        OZONE_GL(glTexImage2D)(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+                               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        OZONE_GL(glBindFramebuffer)(GL_FRAMEBUFFER, slot->framebuffer);
+        OZONE_GL(glFramebufferTexture2D)(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                         GL_TEXTURE_2D, slot->texture, 0);
+        slot->textureWidth = width;
+        slot->textureHeight = height;
+        OZONE_GL(glBindTexture)(GL_TEXTURE_2D, g_Capture.sourceTexture);
+    }
+
+    OZONE_GL(glBindFramebuffer)(GL_FRAMEBUFFER, slot->framebuffer);
+    OZONE_GL(glViewport)(0, 0, width, height);
+    OZONE_GL(glUseProgram)(g_Capture.program);
+    OZONE_GL(glUniform1i)(g_Capture.samplerLoc, 0);
+    OZONE_GL(glEnableVertexAttribArray)(g_Capture.positionLoc);
+    OZONE_GL(glEnableVertexAttribArray)(g_Capture.texCoordLoc);
+    OZONE_GL(glVertexAttribPointer)(g_Capture.positionLoc, 3, GL_FLOAT,
+                                    GL_FALSE, 5 * sizeof(GLfloat), vVertices);
+    OZONE_GL(glVertexAttribPointer)(g_Capture.texCoordLoc, 2, GL_FLOAT,
+                                    GL_FALSE, 5 * sizeof(GLfloat),
+                                    &vVertices[3]);
+    OZONE_GL(glDisable)(GL_BLEND);
+    OZONE_GL(glDrawElements)(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
+
+    slot->width = width;
+    slot->height = height;
+    slot->framesWaited = 0;
+    if (g_Capture.gles3)
+    {
+        GLsizeiptr bytes = (GLsizeiptr)width * height * 4;
+
+        if (!slot->buffer)
+            OZONE_GL(glGenBuffers)(1, &slot->buffer);
+        OZONE_GL(glBindBuffer)(OZONE_EGL_GL_PIXEL_PACK_BUFFER, slot->buffer);
+        if (bytes > slot->bufferSize)
+        {
+            OZONE_GL(glBufferData)(OZONE_EGL_GL_PIXEL_PACK_BUFFER, bytes, NULL,
+                                   OZONE_EGL_GL_STREAM_READ);
+            slot->bufferSize = bytes;
+        }
+        // With a pack buffer bound this only queues the transfer.
+        OZONE_GL(glReadPixels)(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                               0);
+        OZONE_GL(glBindBuffer)(OZONE_EGL_GL_PIXEL_PACK_BUFFER, 0);
+        slot->glSync = g_Capture.fenceSync(
+            OZONE_EGL_GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    else
+    {
+        size_t bytes = (size_t)width * height * 4;
+
+        if (bytes > slot->pixelsSize)
+        {
+            free(slot->pixels);
+            slot->pixels = (uint8_t*)malloc(bytes);
+            slot->pixelsSize = slot->pixels ? bytes : 0;
+        }
+        if (g_Capture.createSyncKHR)
+            slot->eglSync = g_Capture.createSyncKHR(display, EGL_SYNC_FENCE_KHR,
+                                                    NULL);
+    }
+    OZONE_GL(glFlush)();
+
+    OZONE_GL(glBindFramebuffer)(GL_FRAMEBUFFER, 0);
+    OZONE_GL(glViewport)(0, 0, window_width, window_height);
+    slot->pending = slot->pixels || g_Capture.gles3;
+}
+
+void ozone_egl_captureFrame(EGLDisplay display, int window_width,
+                            int window_height)
+{
+    ozone_egl_CaptureLock lock;
+    ozone_egl_CaptureParams* params = &g_Capture.params;
+    int left, top, right, bottom;
+    int out_left, out_top, out_right, out_bottom;
+    int scaled_width, scaled_height;
+    uint64_t now;
+    int i;
+
+    if (!g_Capture.active)
+    {
+        ozone_egl_captureReset(display);
+        return;
+    }
+    if (!g_Capture.initialized && !ozone_egl_captureInitGL(display))
+    {
+        LOG(ERROR) << "Frame capture is unavailable";
+        g_Capture.active = 0;
+        return;
+    }
+
+    // Oldest first, so frames arrive in order.
+    for (i = 0; i < OZONE_EGL_CAPTURE_SLOTS; i++)
+    {
+        ozone_egl_CaptureSlot* slot =
+            &g_Capture.slots[(g_Capture.nextSlot + i) % OZONE_EGL_CAPTURE_SLOTS];
+
+        if (!slot->pending)
+            continue;
+        if (!ozone_egl_captureReady(display, slot))
+            break;
+        ozone_egl_captureDeliver(display, slot);
+        if (!g_Capture.active)
+            return;
+    }
+
+    now = ozone_egl_nowUsec();
+    if (params->intervalUsec &&
+        now - g_Capture.lastCaptureUsec < params->intervalUsec)
+        return;
+    ozone_egl_CaptureSlot* slot = &g_Capture.slots[g_Capture.nextSlot];
+    if (slot->pending)
+        return;
+
+    left = params->width ? params->x : 0;
+    top = params->width ? params->y : 0;
+    right = params->width ? params->x + params->width : window_width;
+    bottom = params->width ? params->y + params->height : window_height;
+    if (left < 0)
+        left = 0;
+    if (top < 0)
+        top = 0;
+    if (right > window_width)
+        right = window_width;
+    if (bottom > window_height)
+        bottom = window_height;
+    if (left >= right || top >= bottom)
+        return;
+    scaled_width = params->scaledWidth ? params->scaledWidth : right - left;
+    scaled_height = params->scaledHeight ? params->scaledHeight : bottom - top;
+
+    // Only what changed, in scaled coordinates rounded outwards.
+    out_left = 0;
+    out_top = 0;
+    out_right = scaled_width;
+    out_bottom = scaled_height;
+    if (params->damageOnly)
+    {
+        int damage_left = g_Capture.damageLeft > left ? g_Capture.damageLeft : left;
+        int damage_top = g_Capture.damageTop > top ? g_Capture.damageTop : top;
+        int damage_right = g_Capture.damageRight < right ? g_Capture.damageRight : right;
+        int damage_bottom = g_Capture.damageBottom < bottom ? g_Capture.damageBottom : bottom;
+
+        if (damage_left >= damage_right || damage_top >= damage_bottom)
+            return;
+        out_left = (int64_t)(damage_left - left) * scaled_width / (right - left);
+        out_top = (int64_t)(damage_top - top) * scaled_height / (bottom - top);
+        out_right = ((int64_t)(damage_right - left) * scaled_width +
+                     right - left - 1) / (right - left);
+        out_bottom = ((int64_t)(damage_bottom - top) * scaled_height +
+                      bottom - top - 1) / (bottom - top);
+        // Back to window pixels, covering whole output pixels.
+        damage_left = left + (int64_t)out_left * (right - left) / scaled_width;
+        damage_top = top + (int64_t)out_top * (bottom - top) / scaled_height;
+        damage_right = left + ((int64_t)out_right * (right - left) +
+                               scaled_width - 1) / scaled_width;
+        damage_bottom = top + ((int64_t)out_bottom * (bottom - top) +
+                               scaled_height - 1) / scaled_height;
+        left = damage_left;
+        top = damage_top;
+        right = damage_right < window_width ? damage_right : window_width;
+        bottom = damage_bottom < window_height ? damage_bottom : window_height;
+    }
+
+    if (window_width > g_Capture.sourceWidth ||
+        window_height > g_Capture.sourceHeight)
+    {
+        GLint alpha_bits = 0;
+        GLenum format;
+
+        // glCopyTexSubImage2D cannot add channels the window lacks.
+        OZONE_GL(glGetIntegerv)(GL_ALPHA_BITS, &alpha_bits);
+        format = alpha_bits ? GL_RGBA : GL_RGB;
+        if (!g_Capture.sourceTexture)
+            OZONE_GL(glGenTextures)(1, &g_Capture.sourceTexture);
+        OZONE_GL(glBindTexture)(GL_TEXTURE_2D, g_Capture.sourceTexture);
+        OZONE_GL(glTexImage2D)(GL_TEXTURE_2D, 0, format, window_width,
+                               window_height, 0, format, GL_UNSIGNED_BYTE,
+                               NULL);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        g_Capture.sourceWidth = window_width;
+        g_Capture.sourceHeight = window_height;
+    }
+
+    slot->x = out_left;
+    slot->y = out_top;
+    slot->usec = now;
+    ozone_egl_captureIssue(display, slot, window_width, window_height,
+                           left, top, right - left, bottom - top,
+                           out_right - out_left, out_bottom - out_top);
+    if (!slot->pending)
+        return;
+    g_Capture.nextSlot = (g_Capture.nextSlot + 1) % OZONE_EGL_CAPTURE_SLOTS;
+    g_Capture.lastCaptureUsec = now;
+    ozone_egl_captureClearDamage();
+}
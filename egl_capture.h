@@ -0,0 +1,24 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef UI_OZONE_EGL_CAPTURE_H_
+#define UI_OZONE_EGL_CAPTURE_H_
+
+#include "egl_wrapper.h"
+
+// Asynchronous readback behind ozone_egl_captureStart(). The wrapper calls
+// these on the presenting thread with its context current.
+
+// Adds a window rectangle to what changed since the last captured frame.
+void ozone_egl_captureDamage(int x, int y, int width, int height);
+
+// Called before eglSwapBuffers. Delivers captures whose GPU work finished
+// and, if a readback slot is free, copies the back buffer for the next one.
+// Never waits for the GPU.
+void ozone_egl_captureFrame(EGLDisplay display, int window_width,
+                            int window_height);
+
+// Frees the GL objects and drops pending captures, before the context goes.
+void ozone_egl_captureReset(EGLDisplay display);
+
+#endif
@@ -0,0 +1,107 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_cursor.h"
+
+#include "base/bind.h"
+#include "base/thread_task_runner_handle.h"
+#include "third_party/skia/include/core/SkBitmap.h"
+#include "ui/ozone/common/bitmap_cursor_factory_ozone.h"
+#include "egl_wrapper.h"
+
+namespace ui {
+
+EglCursor::EglCursor() : redraw_pending_(false), weak_factory_(this) {}
+
+EglCursor::~EglCursor() {}
+
+void EglCursor::SetCursor(PlatformCursor platform_cursor) {
+  scoped_refptr<BitmapCursorOzone> cursor =
+      BitmapCursorFactoryOzone::GetBitmapCursor(platform_cursor);
+  if (cursor == cursor_)
+    return;
+  cursor_ = cursor;
+
+  int hardware;
+  if (cursor_ && !cursor_->bitmaps().empty()) {
+    const SkBitmap& bitmap = cursor_->bitmaps()[0];
+    SkAutoLockPixels lock(bitmap);
+    hardware = ozone_egl_cursorSetImage(
+        bitmap.getPixels(), bitmap.width(), bitmap.height(),
+        bitmap.rowBytes(), cursor_->hotspot().x(), cursor_->hotspot().y());
+  } else {
+    hardware = ozone_egl_cursorSetImage(NULL, 0, 0, 0, 0, 0);
+  }
+  if (!hardware)
+    ScheduleRedraw();
+}
+
+void EglCursor::SetBounds(const gfx::Rect& bounds) {
+  bounds_ = bounds;
+  confined_bounds_ = bounds;
+  SetLocation(location_);
+}
+
+void EglCursor::ConfineCursorToBounds(const gfx::Rect& bounds) {
+  confined_bounds_ = bounds.IsEmpty() ? bounds_ : bounds;
+  SetLocation(location_);
+}
+
+void EglCursor::SetRedrawCallback(const base::Closure& redraw) {
+  redraw_ = redraw;
+}
+
+void EglCursor::MoveCursorTo(gfx::AcceleratedWidget widget,
+                             const gfx::PointF& location) {
+  SetLocation(location);
+}
+
+void EglCursor::MoveCursorTo(const gfx::PointF& location) {
+  SetLocation(location);
+}
+
+void EglCursor::MoveCursor(const gfx::Vector2dF& delta) {
+  SetLocation(location_ + delta);
+}
+
+bool EglCursor::IsCursorVisible() {
+  return cursor_.get() != NULL;
+}
+
+gfx::PointF EglCursor::GetLocation() {
+  return location_;
+}
+
+gfx::Rect EglCursor::GetCursorConfinedBounds() {
+  return confined_bounds_;
+}
+
+void EglCursor::SetLocation(const gfx::PointF& location) {
+  location_ = location;
+  if (!confined_bounds_.IsEmpty()) {
+    location_.SetToMax(
+        gfx::PointF(confined_bounds_.x(), confined_bounds_.y()));
+    location_.SetToMin(gfx::PointF(confined_bounds_.right() - 1,
+                                   confined_bounds_.bottom() - 1));
+  }
+
+  if (!ozone_egl_cursorMove(location_.x(), location_.y()))
+    ScheduleRedraw();
+}
+
+void EglCursor::ScheduleRedraw() {
+  if (redraw_pending_ || redraw_.is_null())
+    return;
+  redraw_pending_ = true;
+  base::ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE, base::Bind(&EglCursor::Redraw, weak_factory_.GetWeakPtr()));
+}
+
+void EglCursor::Redraw() {
+  redraw_pending_ = false;
+  if (!redraw_.is_null())
+    redraw_.Run();
+}
+
+}  // namespace ui
@@ -0,0 +1,65 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_CURSOR_H_
+#define UI_OZONE_PLATFORM_EGL_CURSOR_H_
+
+#include "base/callback.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "ui/base/cursor/cursor.h"
+#include "ui/events/ozone/evdev/cursor_delegate_evdev.h"
+#include "ui/gfx/geometry/point_f.h"
+#include "ui/gfx/geometry/rect.h"
+
+namespace ui {
+
+class BitmapCursorOzone;
+
+// Tracks the pointer for the evdev event factory and keeps the cursor out of
+// page content. The image goes to a hardware cursor plane or dispmanx
+// element when the backend has one; otherwise the canvas composites it as a
+// small quad on top of the last frame, so a move costs one tiny draw.
+class EglCursor : public CursorDelegateEvdev {
+ public:
+  EglCursor();
+  ~EglCursor() override;
+
+  void SetCursor(PlatformCursor platform_cursor);
+  void SetBounds(const gfx::Rect& bounds);
+  void ConfineCursorToBounds(const gfx::Rect& bounds);
+
+  // Set by the canvas that composites the software cursor. Run after the
+  // software cursor moved or changed, at most once per task.
+  void SetRedrawCallback(const base::Closure& redraw);
+
+  // CursorDelegateEvdev:
+  void MoveCursorTo(gfx::AcceleratedWidget widget,
+                    const gfx::PointF& location) override;
+  void MoveCursorTo(const gfx::PointF& location) override;
+  void MoveCursor(const gfx::Vector2dF& delta) override;
+  bool IsCursorVisible() override;
+  gfx::PointF GetLocation() override;
+  gfx::Rect GetCursorConfinedBounds() override;
+
+ private:
+  void SetLocation(const gfx::PointF& location);
+  void ScheduleRedraw();
+  void Redraw();
+
+  scoped_refptr<BitmapCursorOzone> cursor_;
+  gfx::PointF location_;
+  gfx::Rect bounds_;
+  gfx::Rect confined_bounds_;
+  base::Closure redraw_;
+  bool redraw_pending_;
+
+  base::WeakPtrFactory<EglCursor> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglCursor);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_CURSOR_H_
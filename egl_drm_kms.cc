@@ -0,0 +1,1106 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gbm.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "egl_backend.h"
+#include "egl_drm_kms.h"
+#include "base/logging.h"
+
+#define OZONE_EGL_DRM_MAX_CARDS 8
+#define OZONE_EGL_DRM_FORMAT GBM_FORMAT_XRGB8888
+
+typedef struct
+{
+    uint32_t connector_crtc_id;
+    uint32_t crtc_mode_id;
+    uint32_t crtc_active;
+    uint32_t plane_fb_id;
+    uint32_t plane_crtc_id;
+    uint32_t plane_src_x;
+    uint32_t plane_src_y;
+    uint32_t plane_src_w;
+    uint32_t plane_src_h;
+    uint32_t plane_crtc_x;
+    uint32_t plane_crtc_y;
+    uint32_t plane_crtc_w;
+    uint32_t plane_crtc_h;
+    // Optional
+    uint32_t plane_rotation;
+} ozone_egl_DrmProps;
+
+typedef struct
+{
+    int fd;
+    uint32_t connector_id;
+    uint32_t crtc_id;
+    uint32_t plane_id;
+    uint32_t mode_blob;
+    drmModeModeInfo mode;
+    drmModeCrtcPtr saved_crtc;
+    ozone_egl_DrmProps props;
+    // Value of the plane's rotation property, 0 to leave it alone
+    uint64_t rotation;
+
+    struct gbm_device* gbm;
+    struct gbm_surface* surface;
+
+    // Buffer on screen, buffer queued for the next vblank, and the buffer
+    // that left the screen but has not been handed back to GBM yet. GBM is
+    // only touched from the presenting thread, so the event thread defers
+    // the release.
+    struct gbm_bo* current_bo;
+    struct gbm_bo* pending_bo;
+    struct gbm_bo* retired_bo;
+    int modeset_done;
+
+    struct gbm_bo* cursor_bo;
+
+    ozone_egl_FlipCallback flip_callback;
+    void* flip_data;
+    uint64_t last_flip_usec;
+
+    pthread_t event_thread;
+    int event_thread_running;
+    int wake_pipe[2];
+    pthread_mutex_t lock;
+    pthread_cond_t flip_done;
+} ozone_egl_Drm;
+
+static ozone_egl_Drm g_Drm = {
+    -1,
+};
+
+static uint32_t ozone_egl_drm_findProperty(int fd, uint32_t object_id,
+                                           uint32_t object_type,
+                                           const char* name)
+{
+    drmModeObjectPropertiesPtr props;
+    uint32_t prop_id = 0;
+    uint32_t i;
+
+    props = drmModeObjectGetProperties(fd, object_id, object_type);
+    if (!props)
+        return 0;
+
+    for (i = 0; i < props->count_props && !prop_id; i++)
+    {
+        drmModePropertyPtr prop = drmModeGetProperty(fd, props->props[i]);
+        if (!prop)
+            continue;
+        if (!strcmp(prop->name, name))
+            prop_id = prop->prop_id;
+        drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(props);
+    return prop_id;
+}
+
+static int ozone_egl_drm_isPrimaryPlane(int fd, uint32_t plane_id)
+{
+    drmModeObjectPropertiesPtr props;
+    int primary = 0;
+    uint32_t i;
+
+    props = drmModeObjectGetProperties(fd, plane_id, DRM_MODE_OBJECT_PLANE);
+    if (!props)
+        return 0;
+
+    for (i = 0; i < props->count_props; i++)
+    {
+        drmModePropertyPtr prop = drmModeGetProperty(fd, props->props[i]);
+        if (!prop)
+            continue;
+        if (!strcmp(prop->name, "type") &&
+            props->prop_values[i] == DRM_PLANE_TYPE_PRIMARY)
+            primary = 1;
+        drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(props);
+    return primary;
+}
+
+static int ozone_egl_drm_findCrtc(int fd, drmModeResPtr res,
+                                  drmModeConnectorPtr conn,
+                                  int* crtc_index)
+{
+    int i, j;
+
+    if (conn->encoder_id)
+    {
+        drmModeEncoderPtr enc = drmModeGetEncoder(fd, conn->encoder_id);
+        if (enc)
+        {
+            for (i = 0; i < res->count_crtcs; i++)
+            {
+                if (res->crtcs[i] == enc->crtc_id)
+                {
+                    *crtc_index = i;
+                    drmModeFreeEncoder(enc);
+                    return 1;
+                }
+            }
+            drmModeFreeEncoder(enc);
+        }
+    }
+
+    for (i = 0; i < conn->count_encoders; i++)
+    {
+        drmModeEncoderPtr enc = drmModeGetEncoder(fd, conn->encoders[i]);
+        if (!enc)
+            continue;
+        for (j = 0; j < res->count_crtcs; j++)
+        {
+            if (enc->possible_crtcs & (1 << j))
+            {
+                *crtc_index = j;
+                drmModeFreeEncoder(enc);
+                return 1;
+            }
+        }
+        drmModeFreeEncoder(enc);
+    }
+    return 0;
+}
+
+static int ozone_egl_drm_findPrimaryPlane(int fd, int crtc_index,
+                                          uint32_t* plane_id)
+{
+    drmModePlaneResPtr planes;
+    uint32_t i;
+
+    planes = drmModeGetPlaneResources(fd);
+    if (!planes)
+        return 0;
+
+    for (i = 0; i < planes->count_planes; i++)
+    {
+        drmModePlanePtr plane = drmModeGetPlane(fd, planes->planes[i]);
+        if (!plane)
+            continue;
+        if ((plane->possible_crtcs & (1 << crtc_index)) &&
+            ozone_egl_drm_isPrimaryPlane(fd, plane->plane_id))
+        {
+            *plane_id = plane->plane_id;
+            drmModeFreePlane(plane);
+            drmModeFreePlaneResources(planes);
+            return 1;
+        }
+        drmModeFreePlane(plane);
+    }
+    drmModeFreePlaneResources(planes);
+    return 0;
+}
+
+// Binds |fd| to its first connected output. Returns 0 if the device has no
+// atomic support or nothing is plugged in, so the caller can try the next.
+static int ozone_egl_drm_initOutput(int fd)
+{
+    drmModeResPtr res;
+    drmModeConnectorPtr conn = NULL;
+    int crtc_index = -1;
+    int i;
+
+    if (drmSetClientCap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) ||
+        drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1))
+    {
+        LOG(INFO) << "DRM device has no atomic modesetting support";
+        return 0;
+    }
+
+    res = drmModeGetResources(fd);
+    if (!res)
+        return 0;
+
+    for (i = 0; i < res->count_connectors; i++)
+    {
+        conn = drmModeGetConnector(fd, res->connectors[i]);
+        if (conn && conn->connection == DRM_MODE_CONNECTED &&
+            conn->count_modes > 0)
+            break;
+        if (conn)
+            drmModeFreeConnector(conn);
+        conn = NULL;
+    }
+
+    if (!conn || !ozone_egl_drm_findCrtc(fd, res, conn, &crtc_index))
+    {
+        if (conn)
+            drmModeFreeConnector(conn);
+        drmModeFreeResources(res);
+        return 0;
+    }
+
+    g_Drm.connector_id = conn->connector_id;
+    g_Drm.crtc_id = res->crtcs[crtc_index];
+    g_Drm.mode = conn->modes[0];
+    for (i = 0; i < conn->count_modes; i++)
+    {
+        if (conn->modes[i].type & DRM_MODE_TYPE_PREFERRED)
+        {
+            g_Drm.mode = conn->modes[i];
+            break;
+        }
+    }
+    drmModeFreeConnector(conn);
+    drmModeFreeResources(res);
+
+    if (!ozone_egl_drm_findPrimaryPlane(fd, crtc_index, &g_Drm.plane_id))
+    {
+        LOG(ERROR) << "No primary plane for CRTC " << g_Drm.crtc_id;
+        return 0;
+    }
+    return 1;
+}
+
+static int ozone_egl_drm_lookupProperties(int fd)
+{
+    ozone_egl_DrmProps* p = &g_Drm.props;
+
+    p->connector_crtc_id = ozone_egl_drm_findProperty(fd, g_Drm.connector_id,
+        DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID");
+    p->crtc_mode_id = ozone_egl_drm_findProperty(fd, g_Drm.crtc_id,
+        DRM_MODE_OBJECT_CRTC, "MODE_ID");
+    p->crtc_active = ozone_egl_drm_findProperty(fd, g_Drm.crtc_id,
+        DRM_MODE_OBJECT_CRTC, "ACTIVE");
+#define PLANE_PROP(field, name) \
+    p->field = ozone_egl_drm_findProperty(fd, g_Drm.plane_id, \
+                                          DRM_MODE_OBJECT_PLANE, name)
+    PLANE_PROP(plane_fb_id, "FB_ID");
+    PLANE_PROP(plane_crtc_id, "CRTC_ID");
+    PLANE_PROP(plane_src_x, "SRC_X");
+    PLANE_PROP(plane_src_y, "SRC_Y");
+    PLANE_PROP(plane_src_w, "SRC_W");
+    PLANE_PROP(plane_src_h, "SRC_H");
+    PLANE_PROP(plane_crtc_x, "CRTC_X");
+    PLANE_PROP(plane_crtc_y, "CRTC_Y");
+    PLANE_PROP(plane_crtc_w, "CRTC_W");
+    PLANE_PROP(plane_crtc_h, "CRTC_H");
+    PLANE_PROP(plane_rotation, "rotation");
+#undef PLANE_PROP
+
+    return p->connector_crtc_id && p->crtc_mode_id && p->crtc_active &&
+           p->plane_fb_id && p->plane_crtc_id && p->plane_src_w &&
+           p->plane_crtc_w;
+}
+
+static void ozone_egl_drm_pageFlipHandler(int fd, unsigned int sequence,
+                                          unsigned int tv_sec,
+                                          unsigned int tv_usec,
+                                          void* user_data)
+{
+    ozone_egl_FlipCallback callback;
+    void* data;
+    uint64_t usec = (uint64_t)tv_sec * 1000000 + tv_usec;
+
+    pthread_mutex_lock(&g_Drm.lock);
+    // pageFlip() reclaims the retired buffer before queueing a new flip, so
+    // the slot is always free here.
+    DCHECK(!g_Drm.retired_bo);
+    g_Drm.retired_bo = g_Drm.current_bo;
+    g_Drm.current_bo = g_Drm.pending_bo;
+    g_Drm.pending_bo = NULL;
+    g_Drm.last_flip_usec = usec;
+    callback = g_Drm.flip_callback;
+    data = g_Drm.flip_data;
+    g_Drm.flip_callback = NULL;
+    g_Drm.flip_data = NULL;
+    pthread_cond_broadcast(&g_Drm.flip_done);
+    pthread_mutex_unlock(&g_Drm.lock);
+
+    if (callback)
+        callback(data, usec);
+}
+
+static void* ozone_egl_drm_eventThread(void* arg)
+{
+    drmEventContext evctx;
+    struct pollfd fds[2];
+
+    memset(&evctx, 0, sizeof(evctx));
+    evctx.version = 2;
+    evctx.page_flip_handler = ozone_egl_drm_pageFlipHandler;
+
+    fds[0].fd = g_Drm.fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = g_Drm.wake_pipe[0];
+    fds[1].events = POLLIN;
+
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG(ERROR) << "poll on DRM fd failed, errno " << errno;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (fds[0].revents & POLLIN)
+            drmHandleEvent(g_Drm.fd, &evctx);
+    }
+    return NULL;
+}
+
+static void ozone_egl_drm_destroyFb(struct gbm_bo* bo, void* data)
+{
+    uint32_t fb_id = (uint32_t)(uintptr_t)data;
+    int fd = gbm_device_get_fd(gbm_bo_get_device(bo));
+
+    if (fb_id)
+        drmModeRmFB(fd, fb_id);
+}
+
+static uint32_t ozone_egl_drm_fbForBo(struct gbm_bo* bo)
+{
+    uint32_t fb_id = (uint32_t)(uintptr_t)gbm_bo_get_user_data(bo);
+    uint32_t handles[4] = { 0 };
+    uint32_t strides[4] = { 0 };
+    uint32_t offsets[4] = { 0 };
+
+    if (fb_id)
+        return fb_id;
+
+    handles[0] = gbm_bo_get_handle(bo).u32;
+    strides[0] = gbm_bo_get_stride(bo);
+    if (drmModeAddFB2(g_Drm.fd, gbm_bo_get_width(bo), gbm_bo_get_height(bo),
+                      gbm_bo_get_format(bo), handles, strides, offsets,
+                      &fb_id, 0))
+    {
+        LOG(ERROR) << "drmModeAddFB2 failed, errno " << errno;
+        return 0;
+    }
+
+    gbm_bo_set_user_data(bo, (void*)(uintptr_t)fb_id, ozone_egl_drm_destroyFb);
+    return fb_id;
+}
+
+// The |index|th device to try: OZONE_EGL_DRM_DEVICE alone if it is set,
+// otherwise the first OZONE_EGL_DRM_MAX_CARDS cards. Returns 0 past the end.
+static int ozone_egl_drm_devicePath(int index, char* path, size_t size)
+{
+    const char* device = getenv("OZONE_EGL_DRM_DEVICE");
+
+    if (device)
+    {
+        if (index)
+            return 0;
+        snprintf(path, size, "%s", device);
+        return 1;
+    }
+    if (index >= OZONE_EGL_DRM_MAX_CARDS)
+        return 0;
+    snprintf(path, size, "/dev/dri/card%d", index);
+    return 1;
+}
+
+int ozone_egl_drm_open(int* width, int* height)
+{
+    char path[PATH_MAX];
+    int i;
+
+    if (g_Drm.fd >= 0)
+    {
+        *width = g_Drm.mode.hdisplay;
+        *height = g_Drm.mode.vdisplay;
+        return 1;
+    }
+
+    for (i = 0; ozone_egl_drm_devicePath(i, path, sizeof(path)); i++)
+    {
+        int fd = open(path, O_RDWR | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            if (ozone_egl_drm_initOutput(fd) &&
+                ozone_egl_drm_lookupProperties(fd))
+            {
+                g_Drm.fd = fd;
+                break;
+            }
+            close(fd);
+        }
+    }
+
+    if (g_Drm.fd < 0)
+    {
+        LOG(ERROR) << "No KMS device with a connected output found";
+        return 0;
+    }
+
+    LOG(INFO) << "Using " << path << " mode " << g_Drm.mode.hdisplay << "x"
+              << g_Drm.mode.vdisplay << "@" << g_Drm.mode.vrefresh;
+
+    g_Drm.saved_crtc = drmModeGetCrtc(g_Drm.fd, g_Drm.crtc_id);
+    if (drmModeCreatePropertyBlob(g_Drm.fd, &g_Drm.mode, sizeof(g_Drm.mode),
+                                  &g_Drm.mode_blob))
+    {
+        LOG(ERROR) << "Failed to create mode blob, errno " << errno;
+        ozone_egl_drm_close();
+        return 0;
+    }
+
+    g_Drm.gbm = gbm_create_device(g_Drm.fd);
+    if (!g_Drm.gbm)
+    {
+        LOG(ERROR) << "gbm_create_device failed";
+        ozone_egl_drm_close();
+        return 0;
+    }
+
+    // ozone_egl_drm_close() only tears these down once the thread runs.
+    if (pipe(g_Drm.wake_pipe))
+    {
+        LOG(ERROR) << "Failed to create DRM wake pipe, errno " << errno;
+        ozone_egl_drm_close();
+        return 0;
+    }
+    pthread_mutex_init(&g_Drm.lock, NULL);
+    pthread_cond_init(&g_Drm.flip_done, NULL);
+    if (pthread_create(&g_Drm.event_thread, NULL, ozone_egl_drm_eventThread,
+                       NULL))
+    {
+        LOG(ERROR) << "Failed to start DRM event thread";
+        pthread_cond_destroy(&g_Drm.flip_done);
+        pthread_mutex_destroy(&g_Drm.lock);
+        close(g_Drm.wake_pipe[0]);
+        close(g_Drm.wake_pipe[1]);
+        ozone_egl_drm_close();
+        return 0;
+    }
+    g_Drm.event_thread_running = 1;
+
+    *width = g_Drm.mode.hdisplay;
+    *height = g_Drm.mode.vdisplay;
+    return 1;
+}
+
+NativeDisplayType ozone_egl_drm_getNativeDisplay()
+{
+    return (NativeDisplayType)g_Drm.gbm;
+}
+
+NativeWindowType ozone_egl_drm_createWindow(int width, int height)
+{
+    g_Drm.surface = gbm_surface_create(g_Drm.gbm, width, height,
+                                       OZONE_EGL_DRM_FORMAT,
+                                       GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
+    if (!g_Drm.surface)
+        LOG(ERROR) << "gbm_surface_create failed";
+    return (NativeWindowType)g_Drm.surface;
+}
+
+// Bit of the named value of the plane's rotation bitmask, 0 if the plane
+// does not offer it.
+static uint64_t ozone_egl_drm_rotationBit(drmModePropertyPtr prop,
+                                          const char* name)
+{
+    int i;
+
+    for (i = 0; i < prop->count_enums; i++)
+    {
+        if (!strcmp(prop->enums[i].name, name))
+            return 1ull << prop->enums[i].value;
+    }
+    return 0;
+}
+
+int ozone_egl_drm_setTransform(int transform)
+{
+    drmModePropertyPtr prop;
+    uint64_t rotation = 0;
+    const char* reflect = NULL;
+
+    g_Drm.rotation = 0;
+    if (!g_Drm.props.plane_rotation)
+        return transform == OZONE_EGL_TRANSFORM_NORMAL;
+    prop = drmModeGetProperty(g_Drm.fd, g_Drm.props.plane_rotation);
+    if (!prop)
+        return transform == OZONE_EGL_TRANSFORM_NORMAL;
+
+    // Quarter turns need a plane that can scan out rotated, which usually
+    // means buffers tiled in a way GBM scanout buffers are not.
+    switch (transform)
+    {
+    case OZONE_EGL_TRANSFORM_NORMAL:
+        // Undoes whatever the last user of the plane left behind.
+        rotation = ozone_egl_drm_rotationBit(prop, "rotate-0");
+        break;
+    case OZONE_EGL_TRANSFORM_ROT_180:
+        rotation = ozone_egl_drm_rotationBit(prop, "rotate-180");
+        break;
+    case OZONE_EGL_TRANSFORM_FLIP_H:
+        reflect = "reflect-x";
+        break;
+    case OZONE_EGL_TRANSFORM_FLIP_V:
+        reflect = "reflect-y";
+        break;
+    }
+    if (reflect)
+    {
+        uint64_t rotate_0 = ozone_egl_drm_rotationBit(prop, "rotate-0");
+        uint64_t reflect_bit = ozone_egl_drm_rotationBit(prop, reflect);
+        if (rotate_0 && reflect_bit)
+            rotation = rotate_0 | reflect_bit;
+    }
+    drmModeFreeProperty(prop);
+
+    g_Drm.rotation = rotation;
+    return rotation || transform == OZONE_EGL_TRANSFORM_NORMAL;
+}
+
+int ozone_egl_drm_chooseConfig(EGLDisplay display, EGLConfig* config)
+{
+    static const EGLint attribs[] = {
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE,
+    };
+    EGLConfig configs[64];
+    EGLint count = 0;
+    EGLint i;
+
+    if (!eglChooseConfig(display, attribs, configs,
+                         sizeof(configs) / sizeof(configs[0]), &count))
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        EGLint visual = 0;
+        if (eglGetConfigAttrib(display, configs[i], EGL_NATIVE_VISUAL_ID,
+                               &visual) &&
+            visual == OZONE_EGL_DRM_FORMAT)
+        {
+            *config = configs[i];
+            return 1;
+        }
+    }
+    LOG(ERROR) << "No EGL config matches the GBM scanout format";
+    return 0;
+}
+
+static int ozone_egl_drm_commit(uint32_t fb_id)
+{
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+    ozone_egl_DrmProps* p = &g_Drm.props;
+    uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+    int ret;
+
+    if (!req)
+        return -ENOMEM;
+
+    drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_fb_id, fb_id);
+    if (!g_Drm.modeset_done)
+    {
+        drmModeAtomicAddProperty(req, g_Drm.connector_id,
+                                 p->connector_crtc_id, g_Drm.crtc_id);
+        drmModeAtomicAddProperty(req, g_Drm.crtc_id, p->crtc_mode_id,
+                                 g_Drm.mode_blob);
+        drmModeAtomicAddProperty(req, g_Drm.crtc_id, p->crtc_active, 1);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_crtc_id,
+                                 g_Drm.crtc_id);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_src_x, 0);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_src_y, 0);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_src_w,
+                                 (uint64_t)g_Drm.mode.hdisplay << 16);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_src_h,
+                                 (uint64_t)g_Drm.mode.vdisplay << 16);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_crtc_x, 0);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_crtc_y, 0);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_crtc_w,
+                                 g_Drm.mode.hdisplay);
+        drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_crtc_h,
+                                 g_Drm.mode.vdisplay);
+        if (g_Drm.rotation)
+            drmModeAtomicAddProperty(req, g_Drm.plane_id, p->plane_rotation,
+                                     g_Drm.rotation);
+        flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+    }
+    else
+    {
+        flags |= DRM_MODE_ATOMIC_NONBLOCK;
+    }
+
+    ret = drmModeAtomicCommit(g_Drm.fd, req, flags, NULL);
+    drmModeAtomicFree(req);
+    if (ret)
+        return -errno;
+
+    g_Drm.modeset_done = 1;
+    return 0;
+}
+
+int ozone_egl_drm_pageFlip(ozone_egl_FlipCallback callback, void* data)
+{
+    struct gbm_bo* bo;
+    struct gbm_bo* retired;
+    uint32_t fb_id;
+    int ret;
+
+    // Only one flip may be in flight. In the common case the previous one
+    // completed during the last frame and this does not wait at all.
+    pthread_mutex_lock(&g_Drm.lock);
+    while (g_Drm.pending_bo)
+        pthread_cond_wait(&g_Drm.flip_done, &g_Drm.lock);
+    retired = g_Drm.retired_bo;
+    g_Drm.retired_bo = NULL;
+    pthread_mutex_unlock(&g_Drm.lock);
+
+    if (retired)
+        gbm_surface_release_buffer(g_Drm.surface, retired);
+
+    bo = gbm_surface_lock_front_buffer(g_Drm.surface);
+    if (!bo)
+    {
+        LOG(ERROR) << "gbm_surface_lock_front_buffer failed";
+        return 0;
+    }
+
+    fb_id = ozone_egl_drm_fbForBo(bo);
+    if (!fb_id)
+    {
+        gbm_surface_release_buffer(g_Drm.surface, bo);
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_Drm.lock);
+    g_Drm.pending_bo = bo;
+    g_Drm.flip_callback = callback;
+    g_Drm.flip_data = data;
+    pthread_mutex_unlock(&g_Drm.lock);
+
+    ret = ozone_egl_drm_commit(fb_id);
+    if (ret)
+    {
+        LOG(ERROR) << "Atomic commit failed: " << strerror(-ret);
+        pthread_mutex_lock(&g_Drm.lock);
+        g_Drm.pending_bo = NULL;
+        g_Drm.flip_callback = NULL;
+        g_Drm.flip_data = NULL;
+        pthread_mutex_unlock(&g_Drm.lock);
+        gbm_surface_release_buffer(g_Drm.surface, bo);
+        return 0;
+    }
+    return 1;
+}
+
+int ozone_egl_drm_setCursor(const void* pixels, int width, int height)
+{
+    uint64_t cursor_width = 64, cursor_height = 64;
+    uint32_t* buffer;
+    int y, ret;
+
+    if (g_Drm.fd < 0)
+        return 0;
+
+    if (!pixels)
+        return drmModeSetCursor(g_Drm.fd, g_Drm.crtc_id, 0, 0, 0) == 0;
+
+    drmGetCap(g_Drm.fd, DRM_CAP_CURSOR_WIDTH, &cursor_width);
+    drmGetCap(g_Drm.fd, DRM_CAP_CURSOR_HEIGHT, &cursor_height);
+    if ((uint64_t)width > cursor_width || (uint64_t)height > cursor_height)
+        return 0;
+
+    if (!g_Drm.cursor_bo)
+    {
+        g_Drm.cursor_bo = gbm_bo_create(g_Drm.gbm, cursor_width, cursor_height,
+                                        GBM_FORMAT_ARGB8888,
+                                        GBM_BO_USE_CURSOR | GBM_BO_USE_WRITE);
+        if (!g_Drm.cursor_bo)
+            return 0;
+    }
+
+    buffer = (uint32_t*)calloc(cursor_width * cursor_height, 4);
+    if (!buffer)
+        return 0;
+    for (y = 0; y < height; y++)
+        memcpy(buffer + y * cursor_width,
+               (const uint8_t*)pixels + y * width * 4, width * 4);
+    ret = gbm_bo_write(g_Drm.cursor_bo, buffer,
+                       cursor_width * cursor_height * 4);
+    free(buffer);
+    if (ret)
+        return 0;
+
+    return drmModeSetCursor(g_Drm.fd, g_Drm.crtc_id,
+                            gbm_bo_get_handle(g_Drm.cursor_bo).u32,
+                            cursor_width, cursor_height) == 0;
+}
+
+int ozone_egl_drm_moveCursor(int x, int y)
+{
+    return g_Drm.fd >= 0 &&
+           drmModeMoveCursor(g_Drm.fd, g_Drm.crtc_id, x, y) == 0;
+}
+
+int ozone_egl_drm_getVSyncParameters(uint64_t* timebase, uint64_t* interval)
+{
+    uint64_t htotal = g_Drm.mode.htotal;
+    uint64_t vtotal = g_Drm.mode.vtotal;
+
+    if (g_Drm.fd < 0 || !g_Drm.mode.clock || !htotal || !vtotal)
+        return 0;
+
+    pthread_mutex_lock(&g_Drm.lock);
+    *timebase = g_Drm.last_flip_usec;
+    pthread_mutex_unlock(&g_Drm.lock);
+    // mode.clock is in kHz.
+    *interval = htotal * vtotal * 1000 / g_Drm.mode.clock;
+    return *timebase != 0;
+}
+
+static int ozone_egl_drm_outputType(uint32_t connector_type)
+{
+    switch (connector_type)
+    {
+    case DRM_MODE_CONNECTOR_LVDS:
+    case DRM_MODE_CONNECTOR_eDP:
+    case DRM_MODE_CONNECTOR_DSI:
+        return OZONE_EGL_OUTPUT_INTERNAL;
+    case DRM_MODE_CONNECTOR_VGA:
+        return OZONE_EGL_OUTPUT_VGA;
+    case DRM_MODE_CONNECTOR_HDMIA:
+    case DRM_MODE_CONNECTOR_HDMIB:
+        return OZONE_EGL_OUTPUT_HDMI;
+    case DRM_MODE_CONNECTOR_DVII:
+    case DRM_MODE_CONNECTOR_DVID:
+    case DRM_MODE_CONNECTOR_DVIA:
+        return OZONE_EGL_OUTPUT_DVI;
+    case DRM_MODE_CONNECTOR_DisplayPort:
+        return OZONE_EGL_OUTPUT_DISPLAYPORT;
+    default:
+        return OZONE_EGL_OUTPUT_UNKNOWN;
+    }
+}
+
+// Mode the connector's CRTC currently scans out, if any.
+static int ozone_egl_drm_currentMode(int fd, drmModeConnectorPtr conn,
+                                     drmModeModeInfo* mode)
+{
+    drmModeEncoderPtr enc;
+    drmModeCrtcPtr crtc;
+    int valid = 0;
+
+    // Ours may not be programmed yet; report what we are going to show.
+    if (conn->connector_id == g_Drm.connector_id)
+    {
+        *mode = g_Drm.mode;
+        return 1;
+    }
+    if (!conn->encoder_id)
+        return 0;
+    enc = drmModeGetEncoder(fd, conn->encoder_id);
+    if (!enc)
+        return 0;
+    crtc = enc->crtc_id ? drmModeGetCrtc(fd, enc->crtc_id) : NULL;
+    if (crtc && crtc->mode_valid)
+    {
+        *mode = crtc->mode;
+        valid = 1;
+    }
+    if (crtc)
+        drmModeFreeCrtc(crtc);
+    drmModeFreeEncoder(enc);
+    return valid;
+}
+
+static void ozone_egl_drm_fillOutput(int fd, drmModeConnectorPtr conn,
+                                     ozone_egl_Output* output)
+{
+    drmModeModeInfo current;
+    int has_current = ozone_egl_drm_currentMode(fd, conn, &current);
+    int i;
+
+    memset(output, 0, sizeof(*output));
+    output->id = conn->connector_id;
+    snprintf(output->name, sizeof(output->name), "connector-%u-%u",
+             conn->connector_type, conn->connector_type_id);
+    output->type = ozone_egl_drm_outputType(conn->connector_type);
+    output->widthMm = conn->mmWidth;
+    output->heightMm = conn->mmHeight;
+    output->currentMode = -1;
+    output->nativeMode = -1;
+
+    for (i = 0; i < conn->count_modes && i < OZONE_EGL_MAX_MODES; i++)
+    {
+        const drmModeModeInfo* mode = &conn->modes[i];
+        ozone_egl_Mode* out = &output->modes[i];
+
+        out->width = mode->hdisplay;
+        out->height = mode->vdisplay;
+        out->interlaced = (mode->flags & DRM_MODE_FLAG_INTERLACE) != 0;
+        // vrefresh is rounded to whole Hz; 59.94 matters to the scheduler.
+        out->refreshRate = ozone_egl_refreshRate(
+            (uint64_t)mode->clock * 1000, mode->htotal, mode->vtotal,
+            out->interlaced, (mode->flags & DRM_MODE_FLAG_DBLSCAN) != 0);
+        if (!out->refreshRate)
+            out->refreshRate = mode->vrefresh;
+
+        if (output->nativeMode < 0 && (mode->type & DRM_MODE_TYPE_PREFERRED))
+            output->nativeMode = i;
+        if (output->currentMode < 0 && has_current &&
+            !memcmp(mode, &current, sizeof(current)))
+            output->currentMode = i;
+    }
+    output->modeCount = i;
+    if (output->nativeMode < 0 && output->modeCount)
+        output->nativeMode = 0;
+}
+
+int ozone_egl_drm_getOutputs(ozone_egl_Output* outputs, int max_outputs)
+{
+    drmModeResPtr res;
+    int count = 0;
+    int x = 0;
+    int pass, i;
+
+    if (g_Drm.fd < 0)
+        return 0;
+    res = drmModeGetResources(g_Drm.fd);
+    if (!res)
+        return 0;
+
+    // The connector we drive comes first, the others follow left to right.
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < res->count_connectors && count < max_outputs; i++)
+        {
+            drmModeConnectorPtr conn;
+            ozone_egl_Output* output;
+
+            if ((res->connectors[i] == g_Drm.connector_id) != (pass == 0))
+                continue;
+            conn = drmModeGetConnector(g_Drm.fd, res->connectors[i]);
+            if (!conn)
+                continue;
+            if (conn->connection == DRM_MODE_CONNECTED && conn->count_modes)
+            {
+                output = &outputs[count++];
+                ozone_egl_drm_fillOutput(g_Drm.fd, conn, output);
+                output->x = x;
+                if (output->currentMode >= 0)
+                    x += output->modes[output->currentMode].width;
+            }
+            drmModeFreeConnector(conn);
+        }
+    }
+    drmModeFreeResources(res);
+    return count;
+}
+
+static void ozone_egl_drm_disablePlane()
+{
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+
+    if (!req)
+        return;
+    drmModeAtomicAddProperty(req, g_Drm.plane_id, g_Drm.props.plane_fb_id, 0);
+    drmModeAtomicAddProperty(req, g_Drm.plane_id, g_Drm.props.plane_crtc_id,
+                             0);
+    if (drmModeAtomicCommit(g_Drm.fd, req, DRM_MODE_ATOMIC_ALLOW_MODESET, NULL))
+        LOG(ERROR) << "Failed to disable the primary plane, errno " << errno;
+    drmModeAtomicFree(req);
+}
+
+// Stops scanning out of the window: waits for the flip in flight, puts the
+// saved CRTC back and hands the buffers that were on screen back to GBM.
+// The next pageFlip() sets the mode again.
+static void ozone_egl_drm_releaseBuffers()
+{
+    if (!g_Drm.surface)
+        return;
+
+    pthread_mutex_lock(&g_Drm.lock);
+    while (g_Drm.pending_bo)
+        pthread_cond_wait(&g_Drm.flip_done, &g_Drm.lock);
+    pthread_mutex_unlock(&g_Drm.lock);
+
+    // The buffers must be off the plane before GBM may render into them.
+    if (g_Drm.modeset_done)
+    {
+        if (g_Drm.saved_crtc && g_Drm.saved_crtc->buffer_id)
+        {
+            drmModeSetCrtc(g_Drm.fd, g_Drm.saved_crtc->crtc_id,
+                           g_Drm.saved_crtc->buffer_id, g_Drm.saved_crtc->x,
+                           g_Drm.saved_crtc->y, &g_Drm.connector_id, 1,
+                           &g_Drm.saved_crtc->mode);
+        }
+        else
+        {
+            ozone_egl_drm_disablePlane();
+        }
+    }
+    if (g_Drm.cursor_bo)
+        drmModeSetCursor(g_Drm.fd, g_Drm.crtc_id, 0, 0, 0);
+
+    if (g_Drm.retired_bo)
+        gbm_surface_release_buffer(g_Drm.surface, g_Drm.retired_bo);
+    if (g_Drm.current_bo)
+        gbm_surface_release_buffer(g_Drm.surface, g_Drm.current_bo);
+    g_Drm.retired_bo = NULL;
+    g_Drm.current_bo = NULL;
+    g_Drm.modeset_done = 0;
+}
+
+void ozone_egl_drm_destroySurface(EGLDisplay display, EGLSurface surface)
+{
+    ozone_egl_drm_releaseBuffers();
+    eglDestroySurface(display, surface);
+}
+
+void ozone_egl_drm_destroyWindow()
+{
+    ozone_egl_drm_releaseBuffers();
+
+    if (g_Drm.cursor_bo)
+    {
+        gbm_bo_destroy(g_Drm.cursor_bo);
+        g_Drm.cursor_bo = NULL;
+    }
+
+    if (g_Drm.surface)
+        gbm_surface_destroy(g_Drm.surface);
+    g_Drm.surface = NULL;
+}
+
+void ozone_egl_drm_close()
+{
+    ozone_egl_drm_destroyWindow();
+
+    if (g_Drm.event_thread_running)
+    {
+        if (write(g_Drm.wake_pipe[1], "x", 1) != 1)
+            LOG(ERROR) << "Failed to wake DRM event thread";
+        pthread_join(g_Drm.event_thread, NULL);
+        g_Drm.event_thread_running = 0;
+        close(g_Drm.wake_pipe[0]);
+        close(g_Drm.wake_pipe[1]);
+        pthread_cond_destroy(&g_Drm.flip_done);
+        pthread_mutex_destroy(&g_Drm.lock);
+    }
+
+    if (g_Drm.gbm)
+        gbm_device_destroy(g_Drm.gbm);
+    g_Drm.gbm = NULL;
+
+    if (g_Drm.saved_crtc)
+        drmModeFreeCrtc(g_Drm.saved_crtc);
+    g_Drm.saved_crtc = NULL;
+
+    if (g_Drm.mode_blob)
+        drmModeDestroyPropertyBlob(g_Drm.fd, g_Drm.mode_blob);
+    g_Drm.mode_blob = 0;
+    g_Drm.rotation = 0;
+
+    if (g_Drm.fd >= 0)
+        close(g_Drm.fd);
+    g_Drm.fd = -1;
+}
+
+namespace {
+
+const EGLint kDrmConfigAttribs[] = {
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_NONE,
+};
+
+class OzoneEglBackendDrm : public OzoneEglBackend {
+ public:
+  OzoneEglBackendDrm() {}
+
+  const char* GetName() const override { return "drm"; }
+
+  // Cheap: the devices ozone_egl_drm_open() would try, without opening
+  // them.
+  bool Probe() override {
+    char path[PATH_MAX];
+    for (int i = 0; ozone_egl_drm_devicePath(i, path, sizeof(path)); i++) {
+      if (access(path, R_OK | W_OK) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  bool Initialize(int* width, int* height) override {
+    return ozone_egl_drm_open(width, height) != 0;
+  }
+
+  void Shutdown() override { ozone_egl_drm_close(); }
+
+  NativeDisplayType GetNativeDisplay() override {
+    return ozone_egl_drm_getNativeDisplay();
+  }
+
+  const EGLint* GetConfigAttribs() override { return kDrmConfigAttribs; }
+
+  bool ChooseConfig(EGLDisplay display, EGLConfig* config) override {
+    return ozone_egl_drm_chooseConfig(display, config) != 0;
+  }
+
+  bool SetTransform(int transform) override {
+    return ozone_egl_drm_setTransform(transform) != 0;
+  }
+
+  NativeWindowType CreateNativeWindow(int width, int height) override {
+    return ozone_egl_drm_createWindow(width, height);
+  }
+
+  void DestroySurface(EGLDisplay display, EGLSurface surface) override {
+    ozone_egl_drm_destroySurface(display, surface);
+  }
+
+  void DestroyNativeWindow() override { ozone_egl_drm_destroyWindow(); }
+
+  bool Present(ozone_egl_FlipCallback callback, void* data) override {
+    return ozone_egl_drm_pageFlip(callback, data) != 0;
+  }
+
+  bool GetVSyncParameters(uint64_t* timebase, uint64_t* interval) override {
+    return ozone_egl_drm_getVSyncParameters(timebase, interval) != 0;
+  }
+
+  // Page flip events carry the vblank timestamp of the GBM buffer going on
+  // screen.
+  int GetPresentFlags() override {
+    return OZONE_EGL_PRESENT_VSYNC | OZONE_EGL_PRESENT_HW_CLOCK |
+           OZONE_EGL_PRESENT_HW_COMPLETION | OZONE_EGL_PRESENT_ZERO_COPY;
+  }
+
+  int GetOutputs(ozone_egl_Output* outputs, int max_outputs) override {
+    return ozone_egl_drm_getOutputs(outputs, max_outputs);
+  }
+
+  bool SetCursor(const void* pixels, int width, int height) override {
+    return ozone_egl_drm_setCursor(pixels, width, height) != 0;
+  }
+
+  bool MoveCursor(int x, int y) override {
+    return ozone_egl_drm_moveCursor(x, y) != 0;
+  }
+};
+
+}  // namespace
+
+OzoneEglBackend* CreateOzoneEglBackendDrm() {
+  return new OzoneEglBackendDrm();
+}
@@ -0,0 +1,53 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef UI_OZONE_EGL_DRM_KMS_H_
+#define UI_OZONE_EGL_DRM_KMS_H_
+
+#include "egl_wrapper.h"
+
+// GBM + DRM/KMS native window support for boards that only expose KMS.
+// Frames are put on screen with non-blocking atomic commits; the flip
+// completion event is delivered on a dedicated event thread, so
+// ozone_egl_FlipCallback runs on that thread for this backend.
+
+// Opens the KMS device (OZONE_EGL_DRM_DEVICE or the first /dev/dri/cardN
+// with a connected output) and picks the preferred mode of that output.
+int ozone_egl_drm_open(int* width, int* height);
+void ozone_egl_drm_close();
+
+NativeDisplayType ozone_egl_drm_getNativeDisplay();
+NativeWindowType ozone_egl_drm_createWindow(int width, int height);
+void ozone_egl_drm_destroyWindow();
+
+// Destroys the EGL surface on the GBM window after taking its buffers off
+// the screen and back from the flip queue; releasing them afterwards would
+// hand GBM buffers that died with the surface. The window stays, and the
+// next pageFlip() on a new surface sets the mode again.
+void ozone_egl_drm_destroySurface(EGLDisplay display, EGLSurface surface);
+
+// Mirrors or turns the primary plane by half a turn through its rotation
+// property, applied with the first commit. Fails for quarter turns and
+// for values the plane does not offer.
+int ozone_egl_drm_setTransform(int transform);
+
+// Picks the config whose native visual matches the GBM scanout format.
+int ozone_egl_drm_chooseConfig(EGLDisplay display, EGLConfig* config);
+
+// Queues the front buffer of the GBM surface for scanout. Must be called
+// after eglSwapBuffers. Only waits if the previous flip is still pending.
+int ozone_egl_drm_pageFlip(ozone_egl_FlipCallback callback, void* data);
+
+// Legacy cursor plane. |pixels| is tightly packed ARGB8888 or NULL to hide.
+// Fails if the image does not fit the driver's cursor size.
+int ozone_egl_drm_setCursor(const void* pixels, int width, int height);
+int ozone_egl_drm_moveCursor(int x, int y);
+
+// Returns the timestamp of the last completed flip and the mode's refresh
+// interval, both in microseconds.
+int ozone_egl_drm_getVSyncParameters(uint64_t* timebase, uint64_t* interval);
+
+// Connected connectors of the device, the driven one first.
+int ozone_egl_drm_getOutputs(ozone_egl_Output* outputs, int max_outputs);
+
+#endif
@@ -0,0 +1,539 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Suspend and resume of the DRM backend against a fake KMS device. libdrm,
+// GBM and eglDestroySurface are replaced below; the DRM fd is a FIFO, so
+// the backend's event thread sees page flip events the fake commit writes
+// into it.
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <gbm.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "base/macros.h"
+#include "egl_backend.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const uint32_t kConnectorId = 1;
+const uint32_t kEncoderId = 2;
+const uint32_t kCrtcId = 3;
+const uint32_t kPlaneId = 4;
+const uint32_t kConsoleFbId = 50;
+const int kBufferCount = 3;
+
+struct FakeProperty {
+  uint32_t object_id;
+  uint32_t prop_id;
+  const char* name;
+  uint64_t value;
+};
+
+const FakeProperty kProperties[] = {
+    {kConnectorId, 10, "CRTC_ID", kCrtcId},
+    {kCrtcId, 20, "MODE_ID", 0},
+    {kCrtcId, 21, "ACTIVE", 1},
+    {kPlaneId, 30, "type", DRM_PLANE_TYPE_PRIMARY},
+    {kPlaneId, 31, "FB_ID", 0},
+    {kPlaneId, 32, "CRTC_ID", 0},
+    {kPlaneId, 33, "SRC_X", 0},
+    {kPlaneId, 34, "SRC_Y", 0},
+    {kPlaneId, 35, "SRC_W", 0},
+    {kPlaneId, 36, "SRC_H", 0},
+    {kPlaneId, 37, "CRTC_X", 0},
+    {kPlaneId, 38, "CRTC_Y", 0},
+    {kPlaneId, 39, "CRTC_W", 0},
+    {kPlaneId, 40, "CRTC_H", 0},
+};
+
+// Everything the fakes saw, in order. Flips are read on the backend's
+// event thread.
+pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+std::vector<std::string> g_events;
+int g_fd = -1;
+int g_locked_buffers = 0;
+int g_flip_delay_ms = 0;
+
+void Record(const std::string& event) {
+  pthread_mutex_lock(&g_lock);
+  g_events.push_back(event);
+  pthread_mutex_unlock(&g_lock);
+}
+
+std::vector<std::string> TakeEvents() {
+  std::vector<std::string> events;
+  pthread_mutex_lock(&g_lock);
+  events.swap(g_events);
+  pthread_mutex_unlock(&g_lock);
+  return events;
+}
+
+void* DeliverFlip(void* arg) {
+  struct timespec delay = {0, (long)(intptr_t)arg * 1000000};
+  nanosleep(&delay, NULL);
+  if (write(g_fd, "f", 1) != 1)
+    ADD_FAILURE() << "Failed to queue the flip event";
+  return NULL;
+}
+
+}  // namespace
+
+struct gbm_device {
+  int fd;
+};
+
+struct gbm_surface {
+  int unused;
+};
+
+struct gbm_bo {
+  bool locked;
+  void* user_data;
+  void (*destroy_user_data)(struct gbm_bo*, void*);
+};
+
+struct _drmModeAtomicReq {
+  bool sets_fb;
+};
+
+namespace {
+
+gbm_device g_gbm;
+gbm_surface g_surface;
+gbm_bo g_buffers[kBufferCount];
+gbm_bo g_cursor;
+
+}  // namespace
+
+extern "C" {
+
+int drmSetClientCap(int fd, uint64_t capability, uint64_t value) {
+  return 0;
+}
+
+int drmGetCap(int fd, uint64_t capability, uint64_t* value) {
+  return 0;
+}
+
+int drmHandleEvent(int fd, drmEventContextPtr evctx) {
+  char event;
+  struct timespec now;
+
+  if (read(fd, &event, 1) != 1)
+    return -1;
+  // Before the backend hears of it, so that anything waiting for the flip
+  // is logged after it.
+  Record("flip");
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  evctx->page_flip_handler(fd, 0, now.tv_sec, now.tv_nsec / 1000, NULL);
+  return 0;
+}
+
+drmModeResPtr drmModeGetResources(int fd) {
+  drmModeResPtr res = (drmModeResPtr)calloc(1, sizeof(drmModeRes));
+  res->count_crtcs = 1;
+  res->crtcs = (uint32_t*)calloc(1, sizeof(uint32_t));
+  res->crtcs[0] = kCrtcId;
+  res->count_connectors = 1;
+  res->connectors = (uint32_t*)calloc(1, sizeof(uint32_t));
+  res->connectors[0] = kConnectorId;
+  return res;
+}
+
+void drmModeFreeResources(drmModeResPtr res) {
+  free(res->crtcs);
+  free(res->connectors);
+  free(res);
+}
+
+drmModeConnectorPtr drmModeGetConnector(int fd, uint32_t connector_id) {
+  drmModeConnectorPtr conn =
+      (drmModeConnectorPtr)calloc(1, sizeof(drmModeConnector));
+  conn->connector_id = connector_id;
+  conn->encoder_id = kEncoderId;
+  conn->connection = DRM_MODE_CONNECTED;
+  conn->count_modes = 1;
+  conn->modes = (drmModeModeInfoPtr)calloc(1, sizeof(drmModeModeInfo));
+  conn->modes[0].hdisplay = 640;
+  conn->modes[0].vdisplay = 480;
+  conn->modes[0].type = DRM_MODE_TYPE_PREFERRED;
+  return conn;
+}
+
+void drmModeFreeConnector(drmModeConnectorPtr conn) {
+  free(conn->modes);
+  free(conn);
+}
+
+drmModeEncoderPtr drmModeGetEncoder(int fd, uint32_t encoder_id) {
+  drmModeEncoderPtr enc = (drmModeEncoderPtr)calloc(1, sizeof(drmModeEncoder));
+  enc->encoder_id = encoder_id;
+  enc->crtc_id = kCrtcId;
+  return enc;
+}
+
+void drmModeFreeEncoder(drmModeEncoderPtr enc) {
+  free(enc);
+}
+
+drmModeCrtcPtr drmModeGetCrtc(int fd, uint32_t crtc_id) {
+  drmModeCrtcPtr crtc = (drmModeCrtcPtr)calloc(1, sizeof(drmModeCrtc));
+  crtc->crtc_id = crtc_id;
+  crtc->buffer_id = kConsoleFbId;
+  crtc->mode_valid = 1;
+  return crtc;
+}
+
+void drmModeFreeCrtc(drmModeCrtcPtr crtc) {
+  free(crtc);
+}
+
+int drmModeSetCrtc(int fd, uint32_t crtc_id, uint32_t buffer_id, uint32_t x,
+                   uint32_t y, uint32_t* connectors, int count,
+                   drmModeModeInfoPtr mode) {
+  EXPECT_EQ(kConsoleFbId, buffer_id);
+  Record("restore console");
+  return 0;
+}
+
+int drmModeSetCursor(int fd, uint32_t crtc_id, uint32_t bo_handle,
+                     uint32_t width, uint32_t height) {
+  return 0;
+}
+
+int drmModeMoveCursor(int fd, uint32_t crtc_id, int x, int y) {
+  return 0;
+}
+
+int drmModeAddFB2(int fd, uint32_t width, uint32_t height,
+                  uint32_t pixel_format, const uint32_t bo_handles[4],
+                  const uint32_t pitches[4], const uint32_t offsets[4],
+                  uint32_t* buf_id, uint32_t flags) {
+  static uint32_t next_fb_id = 100;
+  *buf_id = next_fb_id++;
+  return 0;
+}
+
+int drmModeRmFB(int fd, uint32_t buffer_id) {
+  return 0;
+}
+
+drmModePlaneResPtr drmModeGetPlaneResources(int fd) {
+  drmModePlaneResPtr planes =
+      (drmModePlaneResPtr)calloc(1, sizeof(drmModePlaneRes));
+  planes->count_planes = 1;
+  planes->planes = (uint32_t*)calloc(1, sizeof(uint32_t));
+  planes->planes[0] = kPlaneId;
+  return planes;
+}
+
+void drmModeFreePlaneResources(drmModePlaneResPtr planes) {
+  free(planes->planes);
+  free(planes);
+}
+
+drmModePlanePtr drmModeGetPlane(int fd, uint32_t plane_id) {
+  drmModePlanePtr plane = (drmModePlanePtr)calloc(1, sizeof(drmModePlane));
+  plane->plane_id = plane_id;
+  plane->possible_crtcs = 1;
+  return plane;
+}
+
+void drmModeFreePlane(drmModePlanePtr plane) {
+  free(plane);
+}
+
+drmModeObjectPropertiesPtr drmModeObjectGetProperties(int fd,
+                                                      uint32_t object_id,
+                                                      uint32_t object_type) {
+  drmModeObjectPropertiesPtr props = (drmModeObjectPropertiesPtr)calloc(
+      1, sizeof(drmModeObjectProperties));
+  props->props = (uint32_t*)calloc(arraysize(kProperties), sizeof(uint32_t));
+  props->prop_values =
+      (uint64_t*)calloc(arraysize(kProperties), sizeof(uint64_t));
+  for (size_t i = 0; i < arraysize(kProperties); i++) {
+    if (kProperties[i].object_id != object_id)
+      continue;
+    props->props[props->count_props] = kProperties[i].prop_id;
+    props->prop_values[props->count_props] = kProperties[i].value;
+    props->count_props++;
+  }
+  return props;
+}
+
+void drmModeFreeObjectProperties(drmModeObjectPropertiesPtr props) {
+  free(props->props);
+  free(props->prop_values);
+  free(props);
+}
+
+drmModePropertyPtr drmModeGetProperty(int fd, uint32_t property_id) {
+  for (size_t i = 0; i < arraysize(kProperties); i++) {
+    if (kProperties[i].prop_id != property_id)
+      continue;
+    drmModePropertyPtr prop =
+        (drmModePropertyPtr)calloc(1, sizeof(drmModePropertyRes));
+    prop->prop_id = property_id;
+    strncpy(prop->name, kProperties[i].name, sizeof(prop->name) - 1);
+    return prop;
+  }
+  return NULL;
+}
+
+void drmModeFreeProperty(drmModePropertyPtr prop) {
+  free(prop);
+}
+
+drmModeAtomicReqPtr drmModeAtomicAlloc() {
+  return new _drmModeAtomicReq();
+}
+
+void drmModeAtomicFree(drmModeAtomicReqPtr req) {
+  delete req;
+}
+
+int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id,
+                             uint32_t property_id, uint64_t value) {
+  if (object_id == kPlaneId && property_id == 31 && value)
+    req->sets_fb = true;
+  return 0;
+}
+
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags,
+                        void* user_data) {
+  pthread_t thread;
+
+  if (!req->sets_fb) {
+    Record("disable plane");
+    return 0;
+  }
+  Record(flags & DRM_MODE_ATOMIC_ALLOW_MODESET ? "modeset" : "commit");
+  if (flags & DRM_MODE_PAGE_FLIP_EVENT) {
+    EXPECT_EQ(0, pthread_create(&thread, NULL, DeliverFlip,
+                                (void*)(intptr_t)g_flip_delay_ms));
+    pthread_detach(thread);
+  }
+  return 0;
+}
+
+int drmModeCreatePropertyBlob(int fd, const void* data, size_t size,
+                              uint32_t* id) {
+  *id = 60;
+  return 0;
+}
+
+int drmModeDestroyPropertyBlob(int fd, uint32_t id) {
+  return 0;
+}
+
+struct gbm_device* gbm_create_device(int fd) {
+  g_gbm.fd = fd;
+  return &g_gbm;
+}
+
+void gbm_device_destroy(struct gbm_device* gbm) {}
+
+int gbm_device_get_fd(struct gbm_device* gbm) {
+  return gbm->fd;
+}
+
+struct gbm_bo* gbm_bo_create(struct gbm_device* gbm, uint32_t width,
+                             uint32_t height, uint32_t format,
+                             uint32_t flags) {
+  return &g_cursor;
+}
+
+void gbm_bo_destroy(struct gbm_bo* bo) {}
+
+struct gbm_device* gbm_bo_get_device(struct gbm_bo* bo) {
+  return &g_gbm;
+}
+
+uint32_t gbm_bo_get_width(struct gbm_bo* bo) {
+  return 640;
+}
+
+uint32_t gbm_bo_get_height(struct gbm_bo* bo) {
+  return 480;
+}
+
+uint32_t gbm_bo_get_stride(struct gbm_bo* bo) {
+  return 640 * 4;
+}
+
+uint32_t gbm_bo_get_format(struct gbm_bo* bo) {
+  return GBM_FORMAT_XRGB8888;
+}
+
+union gbm_bo_handle gbm_bo_get_handle(struct gbm_bo* bo) {
+  union gbm_bo_handle handle;
+  handle.u64 = 1;
+  return handle;
+}
+
+void gbm_bo_set_user_data(struct gbm_bo* bo, void* data,
+                          void (*destroy_user_data)(struct gbm_bo*, void*)) {
+  bo->user_data = data;
+  bo->destroy_user_data = destroy_user_data;
+}
+
+void* gbm_bo_get_user_data(struct gbm_bo* bo) {
+  return bo->user_data;
+}
+
+int gbm_bo_write(struct gbm_bo* bo, const void* buf, size_t count) {
+  return 0;
+}
+
+struct gbm_surface* gbm_surface_create(struct gbm_device* gbm, uint32_t width,
+                                       uint32_t height, uint32_t format,
+                                       uint32_t flags) {
+  return &g_surface;
+}
+
+struct gbm_bo* gbm_surface_lock_front_buffer(struct gbm_surface* surface) {
+  for (int i = 0; i < kBufferCount; i++) {
+    if (!g_buffers[i].locked) {
+      g_buffers[i].locked = true;
+      g_locked_buffers++;
+      return &g_buffers[i];
+    }
+  }
+  ADD_FAILURE() << "All buffers are held by the backend";
+  return NULL;
+}
+
+void gbm_surface_release_buffer(struct gbm_surface* surface,
+                                struct gbm_bo* bo) {
+  EXPECT_TRUE(bo->locked);
+  bo->locked = false;
+  g_locked_buffers--;
+  Record("release");
+}
+
+void gbm_surface_destroy(struct gbm_surface* surface) {
+  EXPECT_EQ(0, g_locked_buffers);
+  Record("destroy window");
+}
+
+EGLBoolean eglDestroySurface(EGLDisplay display, EGLSurface surface) {
+  EXPECT_EQ(0, g_locked_buffers);
+  Record("destroy surface");
+  return EGL_TRUE;
+}
+
+}  // extern "C"
+
+namespace {
+
+class EglDrmKmsTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/ozone_egl_drm_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir));
+    device_ = std::string(dir) + "/card0";
+    dir_ = dir;
+    ASSERT_EQ(0, mkfifo(device_.c_str(), 0600));
+    setenv("OZONE_EGL_DRM_DEVICE", device_.c_str(), 1);
+
+    backend_ = CreateOzoneEglBackendDrm();
+    int width = 0, height = 0;
+    ASSERT_TRUE(backend_->Initialize(&width, &height));
+    EXPECT_EQ(640, width);
+    EXPECT_EQ(480, height);
+    ASSERT_TRUE(backend_->CreateNativeWindow(width, height));
+    // The backend opens the FIFO read-write, so it never blocks.
+    g_fd = open(device_.c_str(), O_WRONLY);
+    ASSERT_GE(g_fd, 0);
+    g_flip_delay_ms = 0;
+    TakeEvents();
+  }
+
+  void TearDown() override {
+    backend_->Shutdown();
+    delete backend_;
+    close(g_fd);
+    g_fd = -1;
+    unsetenv("OZONE_EGL_DRM_DEVICE");
+    unlink(device_.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  // Queues a flip and waits for it to reach the screen.
+  void PresentAndWait() {
+    ASSERT_TRUE(backend_->Present(NULL, NULL));
+    for (int i = 0; i < 1000; i++) {
+      std::vector<std::string> events = TakeEvents();
+      for (size_t j = 0; j < events.size(); j++) {
+        if (events[j] == "flip")
+          return;
+      }
+      usleep(1000);
+    }
+    FAIL() << "Page flip never completed";
+  }
+
+  OzoneEglBackend* backend_;
+  std::string dir_;
+  std::string device_;
+};
+
+TEST_F(EglDrmKmsTest, SuspendReleasesBuffersBeforeTheSurface) {
+  PresentAndWait();
+  PresentAndWait();
+  EXPECT_EQ(2, g_locked_buffers);
+
+  // Suspend while a flip is still in flight.
+  g_flip_delay_ms = 50;
+  ASSERT_TRUE(backend_->Present(NULL, NULL));
+  backend_->DestroySurface(EGL_NO_DISPLAY, EGL_NO_SURFACE);
+
+  std::vector<std::string> events = TakeEvents();
+  // The retired buffer is handed back when the third frame is queued.
+  const char* expected[] = {"release",         "commit",  "flip",
+                            "restore console", "release", "release",
+                            "destroy surface"};
+  ASSERT_EQ(arraysize(expected), events.size());
+  for (size_t i = 0; i < arraysize(expected); i++)
+    EXPECT_EQ(expected[i], events[i]) << "event " << i;
+  EXPECT_EQ(0, g_locked_buffers);
+}
+
+TEST_F(EglDrmKmsTest, ResumeSetsTheModeAgain) {
+  PresentAndWait();
+  PresentAndWait();
+  backend_->DestroySurface(EGL_NO_DISPLAY, EGL_NO_SURFACE);
+  TakeEvents();
+
+  // The wrapper creates the next surface on the same window.
+  ASSERT_TRUE(backend_->Present(NULL, NULL));
+  std::vector<std::string> events = TakeEvents();
+  ASSERT_FALSE(events.empty());
+  EXPECT_EQ("modeset", events[0]);
+  EXPECT_EQ(1, g_locked_buffers);
+}
+
+TEST_F(EglDrmKmsTest, ShutdownWithoutSuspend) {
+  PresentAndWait();
+  backend_->Shutdown();
+
+  std::vector<std::string> events = TakeEvents();
+  ASSERT_FALSE(events.empty());
+  EXPECT_EQ("destroy window", events.back());
+  EXPECT_EQ(0, g_locked_buffers);
+}
+
+}  // namespace
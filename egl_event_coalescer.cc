@@ -0,0 +1,104 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_event_coalescer.h"
+
+#include "base/bind.h"
+#include "ui/events/event.h"
+
+namespace ui {
+
+namespace {
+
+const int64 kDefaultFrameIntervalUs = 16667;
+
+}  // namespace
+
+EglEventCoalescer::EglEventCoalescer(const DispatchCallback& dispatch)
+    : dispatch_(dispatch),
+      flush_timer_(false, false),
+      interval_(base::TimeDelta::FromMicroseconds(kDefaultFrameIntervalUs)),
+      current_samples_(&no_samples_) {}
+
+EglEventCoalescer::~EglEventCoalescer() {}
+
+// static
+bool EglEventCoalescer::IsCoalescable(const Event& event) {
+  return event.type() == ET_MOUSE_MOVED || event.type() == ET_MOUSE_DRAGGED ||
+         event.type() == ET_TOUCH_MOVED;
+}
+
+// static
+bool EglEventCoalescer::CanMerge(const Event& pending, const Event& incoming) {
+  if (pending.type() != incoming.type() || pending.flags() != incoming.flags())
+    return false;
+  if (incoming.IsTouchEvent()) {
+    return static_cast<const TouchEvent&>(pending).touch_id() ==
+           static_cast<const TouchEvent&>(incoming).touch_id();
+  }
+  return true;
+}
+
+bool EglEventCoalescer::OnEvent(const Event& event) {
+  if (!IsCoalescable(event)) {
+    Flush();
+    return false;
+  }
+
+  for (Pending* pending : pending_) {
+    if (!CanMerge(*pending->event, event))
+      continue;
+    const LocatedEvent* old_event =
+        static_cast<const LocatedEvent*>(pending->event.get());
+    Sample sample;
+    sample.location = old_event->location_f();
+    sample.time_stamp = old_event->time_stamp();
+    pending->samples.push_back(sample);
+    pending->event = Event::Clone(event);
+    return true;
+  }
+
+  Pending* pending = new Pending;
+  pending->event = Event::Clone(event);
+  pending_.push_back(pending);
+  ScheduleFlush();
+  return true;
+}
+
+void EglEventCoalescer::Flush() {
+  flush_timer_.Stop();
+
+  // Dispatching may re-enter OnEvent() (e.g. a delegate that warps the
+  // cursor), so detach the batch first.
+  ScopedVector<Pending> batch;
+  batch.swap(pending_);
+  for (Pending* pending : batch) {
+    current_samples_ = &pending->samples;
+    dispatch_.Run(pending->event.get());
+  }
+  current_samples_ = &no_samples_;
+}
+
+void EglEventCoalescer::SetFrameTiming(base::TimeTicks timebase,
+                                       base::TimeDelta interval) {
+  if (interval <= base::TimeDelta())
+    return;
+  timebase_ = timebase;
+  interval_ = interval;
+}
+
+void EglEventCoalescer::ScheduleFlush() {
+  if (flush_timer_.IsRunning())
+    return;
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::TimeDelta since_vsync = (now - timebase_) % interval_;
+  if (since_vsync < base::TimeDelta())
+    since_vsync += interval_;
+  flush_timer_.Start(FROM_HERE, interval_ - since_vsync,
+                     base::Bind(&EglEventCoalescer::Flush,
+                                base::Unretained(this)));
+}
+
+}  // namespace ui
@@ -0,0 +1,79 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_EVENT_COALESCER_H_
+#define UI_OZONE_PLATFORM_EGL_EVENT_COALESCER_H_
+
+#include <vector>
+
+#include "base/callback.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "ui/gfx/geometry/point_f.h"
+
+namespace ui {
+
+class Event;
+
+// Merges runs of mouse-move and touch-move events so that at most one move
+// per pointer reaches the delegate per frame. Held moves are flushed at the
+// next frame boundary or as soon as any other event arrives; clicks, keys
+// and touch press/release are never delayed.
+class EglEventCoalescer {
+ public:
+  typedef base::Callback<void(Event*)> DispatchCallback;
+
+  // A move that was merged into a later one.
+  struct Sample {
+    gfx::PointF location;
+    base::TimeDelta time_stamp;
+  };
+
+  explicit EglEventCoalescer(const DispatchCallback& dispatch);
+  ~EglEventCoalescer();
+
+  // Returns true if |event| was held back; the caller keeps ownership and
+  // the coalescer keeps its own copy. Otherwise pending moves have been
+  // flushed and the caller must dispatch |event| itself.
+  bool OnEvent(const Event& event);
+
+  // Dispatches all held moves now.
+  void Flush();
+
+  // Aligns flushes to vsync. Defaults to 60 Hz on an arbitrary timebase.
+  void SetFrameTiming(base::TimeTicks timebase, base::TimeDelta interval);
+
+  // Older samples merged into the move being dispatched, oldest first.
+  // Empty outside of a coalesced dispatch.
+  const std::vector<Sample>& historical_samples() const {
+    return *current_samples_;
+  }
+
+ private:
+  struct Pending {
+    scoped_ptr<Event> event;
+    std::vector<Sample> samples;
+  };
+
+  static bool IsCoalescable(const Event& event);
+  static bool CanMerge(const Event& pending, const Event& incoming);
+  void ScheduleFlush();
+
+  DispatchCallback dispatch_;
+  ScopedVector<Pending> pending_;
+  base::Timer flush_timer_;
+  base::TimeTicks timebase_;
+  base::TimeDelta interval_;
+
+  const std::vector<Sample> no_samples_;
+  const std::vector<Sample>* current_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglEventCoalescer);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_EVENT_COALESCER_H_
@@ -0,0 +1,172 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "egl_gl_trace.h"
+
+#if OZONE_EGL_GL_TRACE
+
+#include <string.h>
+#include <time.h>
+
+#include <GLES2/gl2.h>
+
+#include "base/logging.h"
+
+// Frames between two summaries in the log.
+#define OZONE_GL_TRACE_LOG_INTERVAL 300
+#define OZONE_GL_TRACE_MAX_STATES 32
+
+typedef struct
+{
+   const char* key;
+   uint64_t value;
+} ozone_egl_GLTraceState;
+
+// The wrapper issues GL from one thread at a time, so plain globals are
+// enough here.
+static ozone_egl_GLTraceFrame g_Current;
+static ozone_egl_GLTraceFrame g_Last;
+static int g_HaveLast = 0;
+static ozone_egl_GLTraceState g_States[OZONE_GL_TRACE_MAX_STATES];
+static size_t g_StateCount = 0;
+#if OZONE_EGL_GL_TRACE >= 2
+static uint64_t g_CallStart = 0;
+
+static uint64_t ozone_egl_glTraceNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+int ozone_egl_glTraceEntry(const char* name)
+{
+    size_t i;
+
+    for (i = 0; i < g_Current.entry_count; i++)
+    {
+        if (g_Current.entries[i].name == name ||
+            !strcmp(g_Current.entries[i].name, name))
+            return i;
+    }
+    if (g_Current.entry_count == OZONE_GL_TRACE_MAX_ENTRIES)
+        return -1;
+
+    g_Current.entries[i].name = name;
+    g_Current.entries[i].calls = 0;
+    g_Current.entries[i].usec = 0;
+    g_Current.entry_count++;
+    return i;
+}
+
+void ozone_egl_glTraceBegin(int entry)
+{
+    g_Current.total_calls++;
+    if (entry >= 0)
+        g_Current.entries[entry].calls++;
+#if OZONE_EGL_GL_TRACE >= 2
+    glFinish();
+    g_CallStart = ozone_egl_glTraceNow();
+#endif
+}
+
+void ozone_egl_glTraceEnd(int entry)
+{
+#if OZONE_EGL_GL_TRACE >= 2
+    glFinish();
+    if (entry >= 0)
+        g_Current.entries[entry].usec += ozone_egl_glTraceNow() - g_CallStart;
+#endif
+}
+
+void ozone_egl_glTraceUpload(uint64_t bytes)
+{
+    g_Current.upload_bytes += bytes;
+}
+
+void ozone_egl_glTraceState(const char* key, uint64_t value)
+{
+    size_t i;
+
+    for (i = 0; i < g_StateCount; i++)
+    {
+        if (g_States[i].key == key || !strcmp(g_States[i].key, key))
+        {
+            if (g_States[i].value == value)
+                g_Current.redundant_state_changes++;
+            g_States[i].value = value;
+            return;
+        }
+    }
+    if (g_StateCount == OZONE_GL_TRACE_MAX_STATES)
+        return;
+    g_States[g_StateCount].key = key;
+    g_States[g_StateCount].value = value;
+    g_StateCount++;
+}
+
+void ozone_egl_glTraceCheckError(const char* file, int line)
+{
+    GLenum err;
+
+    while ((err = glGetError()) != GL_NO_ERROR)
+    {
+        g_Current.errors++;
+        LOG(WARNING) << file << ":" << line << " GL error 0x" << std::hex
+                     << err;
+    }
+}
+
+static void ozone_egl_glTraceLogFrame(const ozone_egl_GLTraceFrame* frame)
+{
+    size_t i;
+
+    LOG(INFO) << "GL frame " << frame->frame << ": " << frame->total_calls
+              << " calls, " << frame->upload_bytes << " upload bytes, "
+              << frame->redundant_state_changes << " redundant state changes, "
+              << frame->errors << " errors";
+    for (i = 0; i < frame->entry_count; i++)
+    {
+        if (!frame->entries[i].calls)
+            continue;
+        LOG(INFO) << "  " << frame->entries[i].name << ": "
+                  << frame->entries[i].calls << " calls"
+#if OZONE_EGL_GL_TRACE >= 2
+                  << ", " << frame->entries[i].usec << " us"
+#endif
+                  ;
+    }
+}
+
+void ozone_egl_glTraceEndFrame()
+{
+    size_t i;
+
+    g_Last = g_Current;
+    g_HaveLast = 1;
+    if (g_Last.frame % OZONE_GL_TRACE_LOG_INTERVAL == 0)
+        ozone_egl_glTraceLogFrame(&g_Last);
+
+    // Keep the registered entry points, reset the per-frame numbers.
+    g_Current.frame++;
+    g_Current.total_calls = 0;
+    g_Current.upload_bytes = 0;
+    g_Current.redundant_state_changes = 0;
+    g_Current.errors = 0;
+    for (i = 0; i < g_Current.entry_count; i++)
+    {
+        g_Current.entries[i].calls = 0;
+        g_Current.entries[i].usec = 0;
+    }
+}
+
+int ozone_egl_glTraceGetLastFrame(ozone_egl_GLTraceFrame* frame)
+{
+    if (!g_HaveLast)
+        return 0;
+    *frame = g_Last;
+    return 1;
+}
+
+#endif
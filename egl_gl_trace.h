@@ -0,0 +1,111 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef UI_OZONE_EGL_GL_TRACE_H_
+#define UI_OZONE_EGL_GL_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compile-time GL/EGL instrumentation for the wrapper, selected with the
+// ozone_egl_gl_trace gyp variable:
+//   0  off: every macro expands to the plain call or to nothing.
+//   1  count calls per frame by entry point, upload bytes and redundant
+//      state changes.
+//   2  as 1, and time every call with glFinish() on both sides.
+//
+// Usage:
+//   OZONE_GL(glClear)(GL_COLOR_BUFFER_BIT);
+//   OZONE_GL_UPLOAD_BYTES(width * height * 4);
+//   OZONE_GL_STATE("program", program);
+//   OZONE_GL_TRACE_END_FRAME();
+#ifndef OZONE_EGL_GL_TRACE
+#define OZONE_EGL_GL_TRACE 0
+#endif
+
+#define OZONE_GL_TRACE_MAX_ENTRIES 64
+
+typedef struct
+{
+   const char* name;
+   uint32_t calls;
+   uint64_t usec;
+} ozone_egl_GLTraceEntry;
+
+typedef struct
+{
+   uint64_t frame;
+   uint32_t total_calls;
+   uint64_t upload_bytes;
+   uint32_t redundant_state_changes;
+   uint32_t errors;
+   size_t entry_count;
+   ozone_egl_GLTraceEntry entries[OZONE_GL_TRACE_MAX_ENTRIES];
+} ozone_egl_GLTraceFrame;
+
+#if OZONE_EGL_GL_TRACE
+
+int ozone_egl_glTraceEntry(const char* name);
+void ozone_egl_glTraceBegin(int entry);
+void ozone_egl_glTraceEnd(int entry);
+void ozone_egl_glTraceUpload(uint64_t bytes);
+void ozone_egl_glTraceState(const char* key, uint64_t value);
+void ozone_egl_glTraceCheckError(const char* file, int line);
+void ozone_egl_glTraceEndFrame();
+
+// Stats of the last completed frame. Returns 0 before the first frame.
+int ozone_egl_glTraceGetLastFrame(ozone_egl_GLTraceFrame* frame);
+
+namespace ozone_egl {
+
+template <typename R, typename... Args>
+class GLTraceCall {
+ public:
+  GLTraceCall(R (*function)(Args...), int entry)
+      : function_(function), entry_(entry) {}
+
+  R operator()(Args... args) const {
+    Scope scope(entry_);
+    return function_(args...);
+  }
+
+ private:
+  class Scope {
+   public:
+    explicit Scope(int entry) : entry_(entry) { ozone_egl_glTraceBegin(entry); }
+    ~Scope() { ozone_egl_glTraceEnd(entry_); }
+
+   private:
+    int entry_;
+  };
+
+  R (*function_)(Args...);
+  int entry_;
+};
+
+template <typename R, typename... Args>
+GLTraceCall<R, Args...> MakeGLTraceCall(R (*function)(Args...),
+                                        const char* name) {
+  return GLTraceCall<R, Args...>(function, ozone_egl_glTraceEntry(name));
+}
+
+}  // namespace ozone_egl
+
+#define OZONE_GL(function) ozone_egl::MakeGLTraceCall(&function, #function)
+#define OZONE_GL_UPLOAD_BYTES(bytes) ozone_egl_glTraceUpload(bytes)
+#define OZONE_GL_STATE(key, value) \
+    ozone_egl_glTraceState(key, (uint64_t)(value))
+#define OZONE_GL_CHECK_ERROR() ozone_egl_glTraceCheckError(__FILE__, __LINE__)
+#define OZONE_GL_TRACE_END_FRAME() ozone_egl_glTraceEndFrame()
+
+#else
+
+#define OZONE_GL(function) function
+#define OZONE_GL_UPLOAD_BYTES(bytes) ((void)0)
+#define OZONE_GL_STATE(key, value) ((void)0)
+#define OZONE_GL_CHECK_ERROR() ((void)0)
+#define OZONE_GL_TRACE_END_FRAME() ((void)0)
+
+#endif
+
+#endif
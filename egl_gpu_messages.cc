@@ -0,0 +1,7 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Generate the message classes; the parameters all have stock traits.
+#define IPC_MESSAGE_IMPL
+#include "ui/ozone/platform/egl/egl_gpu_messages.h"
@@ -0,0 +1,26 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Multiply-included message file, hence no include guard here.
+
+#include "base/time/time.h"
+#include "ipc/ipc_message_macros.h"
+#include "ipc/ipc_message_utils.h"
+#include "ui/gfx/native_widget_types.h"
+
+// Message IDs are made from the class and the line number, so the EGL
+// platform has a class of its own, registered in ipc/ipc_message_start.h
+// next to OzoneGpuMsgStart.
+#define IPC_MESSAGE_START OzoneEglMsgStart
+
+//------------------------------------------------------------------------------
+// GPU Process -> Browser Process
+
+// A frame swapped for |widget| reached the screen at |timestamp|. |flags|
+// are the OZONE_EGL_PRESENT_* flags of the backend.
+IPC_MESSAGE_CONTROL4(OzoneHostMsg_EglFramePresented,
+                     gfx::AcceleratedWidget /* widget */,
+                     base::TimeTicks /* timestamp */,
+                     base::TimeDelta /* interval */,
+                     uint32_t /* flags */)
@@ -0,0 +1,49 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_gpu_platform_support.h"
+
+#include "base/logging.h"
+#include "base/trace_event/trace_event.h"
+#include "ipc/ipc_sender.h"
+#include "ui/ozone/platform/egl/egl_gpu_messages.h"
+#include "ui/ozone/platform/egl/egl_presentation_feedback.h"
+
+namespace ui {
+
+EglGpuPlatformSupport::EglGpuPlatformSupport() : sender_(nullptr) {
+  // Created on the main thread, used on the GPU main thread.
+  thread_checker_.DetachFromThread();
+}
+
+EglGpuPlatformSupport::~EglGpuPlatformSupport() {
+}
+
+void EglGpuPlatformSupport::OnFramePresented(
+    gfx::AcceleratedWidget widget,
+    const EglPresentationFeedback& feedback) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  TRACE_EVENT_INSTANT1("ozone", "EglGpuPlatformSupport::OnFramePresented",
+                       TRACE_EVENT_SCOPE_THREAD, "flags", feedback.flags);
+  if (!sender_)
+    return;
+  sender_->Send(new OzoneHostMsg_EglFramePresented(
+      widget, feedback.timestamp, feedback.interval, feedback.flags));
+}
+
+void EglGpuPlatformSupport::OnChannelEstablished(IPC::Sender* sender) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  sender_ = sender;
+}
+
+IPC::MessageFilter* EglGpuPlatformSupport::GetMessageFilter() {
+  return nullptr;
+}
+
+bool EglGpuPlatformSupport::OnMessageReceived(const IPC::Message& message) {
+  // The browser sends nothing to this end yet.
+  return false;
+}
+
+}  // namespace ui
@@ -0,0 +1,44 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_GPU_PLATFORM_SUPPORT_H_
+#define UI_OZONE_PLATFORM_EGL_GPU_PLATFORM_SUPPORT_H_
+
+#include "base/threading/thread_checker.h"
+#include "ui/gfx/native_widget_types.h"
+#include "ui/ozone/public/gpu_platform_support.h"
+
+namespace ui {
+
+struct EglPresentationFeedback;
+
+// GPU process end of the EGL platform channel. Forwards the presentation
+// feedback of every swap to the browser, where EglGpuPlatformSupportHost
+// hands it to its observers.
+class EglGpuPlatformSupport : public GpuPlatformSupport {
+ public:
+  EglGpuPlatformSupport();
+  ~EglGpuPlatformSupport() override;
+
+  // Called on the thread that swapped. Dropped until the channel is up.
+  void OnFramePresented(gfx::AcceleratedWidget widget,
+                        const EglPresentationFeedback& feedback);
+
+  // GpuPlatformSupport:
+  void OnChannelEstablished(IPC::Sender* sender) override;
+  IPC::MessageFilter* GetMessageFilter() override;
+
+  // IPC::Listener:
+  bool OnMessageReceived(const IPC::Message& message) override;
+
+ private:
+  IPC::Sender* sender_;
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglGpuPlatformSupport);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_GPU_PLATFORM_SUPPORT_H_
@@ -0,0 +1,72 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_gpu_platform_support_host.h"
+
+#include "base/logging.h"
+#include "base/trace_event/trace_event.h"
+#include "ui/ozone/platform/egl/egl_gpu_messages.h"
+#include "ui/ozone/platform/egl/egl_presentation_feedback.h"
+
+namespace ui {
+
+EglGpuPlatformSupportHost::EglGpuPlatformSupportHost() : host_id_(-1) {
+}
+
+EglGpuPlatformSupportHost::~EglGpuPlatformSupportHost() {
+}
+
+void EglGpuPlatformSupportHost::AddObserver(
+    EglPresentationObserver* observer) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  observers_.AddObserver(observer);
+}
+
+void EglGpuPlatformSupportHost::RemoveObserver(
+    EglPresentationObserver* observer) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  observers_.RemoveObserver(observer);
+}
+
+void EglGpuPlatformSupportHost::OnChannelEstablished(
+    int host_id,
+    scoped_refptr<base::SingleThreadTaskRunner> send_runner,
+    const base::Callback<void(IPC::Message*)>& send_callback) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  host_id_ = host_id;
+}
+
+void EglGpuPlatformSupportHost::OnChannelDestroyed(int host_id) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (host_id_ == host_id)
+    host_id_ = -1;
+}
+
+bool EglGpuPlatformSupportHost::OnMessageReceived(
+    const IPC::Message& message) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  bool handled = true;
+  IPC_BEGIN_MESSAGE_MAP(EglGpuPlatformSupportHost, message)
+    IPC_MESSAGE_HANDLER(OzoneHostMsg_EglFramePresented, OnFramePresented)
+    IPC_MESSAGE_UNHANDLED(handled = false)
+  IPC_END_MESSAGE_MAP()
+  return handled;
+}
+
+void EglGpuPlatformSupportHost::OnFramePresented(
+    gfx::AcceleratedWidget widget,
+    base::TimeTicks timestamp,
+    base::TimeDelta interval,
+    uint32_t flags) {
+  TRACE_EVENT_INSTANT1("ozone", "EglGpuPlatformSupportHost::OnFramePresented",
+                       TRACE_EVENT_SCOPE_THREAD, "flags", flags);
+  EglPresentationFeedback feedback;
+  feedback.timestamp = timestamp;
+  feedback.interval = interval;
+  feedback.flags = flags;
+  FOR_EACH_OBSERVER(EglPresentationObserver, observers_,
+                    OnFramePresented(widget, feedback));
+}
+
+}  // namespace ui
@@ -0,0 +1,57 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_GPU_PLATFORM_SUPPORT_HOST_H_
+#define UI_OZONE_PLATFORM_EGL_GPU_PLATFORM_SUPPORT_HOST_H_
+
+#include "base/observer_list.h"
+#include "base/threading/thread_checker.h"
+#include "ui/gfx/native_widget_types.h"
+#include "ui/ozone/public/gpu_platform_support_host.h"
+
+namespace base {
+class TimeDelta;
+class TimeTicks;
+}
+
+namespace ui {
+
+class EglPresentationObserver;
+
+// Browser end of the EGL platform channel. Observers learn when frames of
+// the GPU process actually reached the screen.
+class EglGpuPlatformSupportHost : public GpuPlatformSupportHost {
+ public:
+  EglGpuPlatformSupportHost();
+  ~EglGpuPlatformSupportHost() override;
+
+  void AddObserver(EglPresentationObserver* observer);
+  void RemoveObserver(EglPresentationObserver* observer);
+
+  // GpuPlatformSupportHost:
+  void OnChannelEstablished(
+      int host_id,
+      scoped_refptr<base::SingleThreadTaskRunner> send_runner,
+      const base::Callback<void(IPC::Message*)>& send_callback) override;
+  void OnChannelDestroyed(int host_id) override;
+
+  // IPC::Listener:
+  bool OnMessageReceived(const IPC::Message& message) override;
+
+ private:
+  void OnFramePresented(gfx::AcceleratedWidget widget,
+                        base::TimeTicks timestamp,
+                        base::TimeDelta interval,
+                        uint32_t flags);
+
+  int host_id_;
+  base::ObserverList<EglPresentationObserver> observers_;
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglGpuPlatformSupportHost);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_GPU_PLATFORM_SUPPORT_HOST_H_
@@ -0,0 +1,132 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_latency_tracker.h"
+
+#include "base/metrics/histogram.h"
+#include "base/trace_event/trace_event.h"
+
+namespace ui {
+
+namespace {
+
+base::LazyInstance<EglLatencyTracker>::Leaky g_latency_tracker =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+base::TimeDelta EglLatencyTracker::Histogram::Mean() const {
+  if (!count)
+    return base::TimeDelta();
+  return sum / static_cast<int64>(count);
+}
+
+base::TimeDelta EglLatencyTracker::Histogram::Percentile(int percent) const {
+  uint64_t target = (count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    seen += buckets[i];
+    if (seen >= target && seen)
+      return i == kBucketCount - 1 ? max
+                                   : base::TimeDelta::FromMilliseconds(i + 1);
+  }
+  return max;
+}
+
+// static
+EglLatencyTracker* EglLatencyTracker::GetInstance() {
+  return g_latency_tracker.Pointer();
+}
+
+EglLatencyTracker::EglLatencyTracker() : next_token_(1) {
+  Reset();
+}
+
+EglLatencyTracker::~EglLatencyTracker() {}
+
+void EglLatencyTracker::OnInputEvent(base::TimeDelta time_stamp) {
+  base::TimeTicks input_time = base::TimeTicks() + time_stamp;
+  base::AutoLock lock(lock_);
+  if (oldest_pending_input_.is_null() || input_time < oldest_pending_input_)
+    oldest_pending_input_ = input_time;
+}
+
+uint32_t EglLatencyTracker::OnPresent(base::TimeTicks present_time) {
+  base::AutoLock lock(lock_);
+  if (oldest_pending_input_.is_null())
+    return 0;
+
+  base::TimeDelta latency = present_time - oldest_pending_input_;
+  Record(&input_to_present_, latency);
+  UMA_HISTOGRAM_CUSTOM_TIMES("Ozone.Egl.InputToPresent", latency,
+                             base::TimeDelta::FromMilliseconds(1),
+                             base::TimeDelta::FromSeconds(1), 50);
+  TRACE_COUNTER1("ozone", "Egl.InputToPresentUs", latency.InMicroseconds());
+
+  uint32_t token = next_token_++;
+  if (!next_token_)
+    next_token_ = 1;
+  InFlight& slot = in_flight_[token % kMaxFramesInFlight];
+  slot.token = token;
+  slot.input_time = oldest_pending_input_;
+  oldest_pending_input_ = base::TimeTicks();
+  return token;
+}
+
+void EglLatencyTracker::OnScanout(uint32_t token,
+                                  base::TimeTicks scanout_time) {
+  base::AutoLock lock(lock_);
+  InFlight& slot = in_flight_[token % kMaxFramesInFlight];
+  // The slot was reused if the backend fell far behind; drop the sample.
+  if (!token || slot.token != token)
+    return;
+
+  base::TimeDelta latency = scanout_time - slot.input_time;
+  Record(&input_to_scanout_, latency);
+  UMA_HISTOGRAM_CUSTOM_TIMES("Ozone.Egl.InputToScanout", latency,
+                             base::TimeDelta::FromMilliseconds(1),
+                             base::TimeDelta::FromSeconds(1), 50);
+  TRACE_COUNTER1("ozone", "Egl.InputToScanoutUs", latency.InMicroseconds());
+  slot.token = 0;
+}
+
+void EglLatencyTracker::GetInputToPresent(Histogram* histogram) {
+  base::AutoLock lock(lock_);
+  *histogram = input_to_present_;
+}
+
+void EglLatencyTracker::GetInputToScanout(Histogram* histogram) {
+  base::AutoLock lock(lock_);
+  *histogram = input_to_scanout_;
+}
+
+void EglLatencyTracker::Reset() {
+  base::AutoLock lock(lock_);
+  oldest_pending_input_ = base::TimeTicks();
+  for (int i = 0; i < kMaxFramesInFlight; i++) {
+    in_flight_[i].token = 0;
+    in_flight_[i].input_time = base::TimeTicks();
+  }
+  input_to_present_ = Histogram();
+  input_to_scanout_ = Histogram();
+}
+
+// static
+void EglLatencyTracker::Record(Histogram* histogram, base::TimeDelta latency) {
+  if (latency < base::TimeDelta())
+    latency = base::TimeDelta();
+  if (!histogram->count || latency < histogram->min)
+    histogram->min = latency;
+  if (latency > histogram->max)
+    histogram->max = latency;
+  histogram->sum += latency;
+  histogram->count++;
+
+  int64 bucket = latency.InMilliseconds();
+  if (bucket >= kBucketCount - 1)
+    bucket = kBucketCount - 1;
+  histogram->buckets[bucket]++;
+}
+
+}  // namespace ui
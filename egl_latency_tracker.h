@@ -0,0 +1,80 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_LATENCY_TRACKER_H_
+#define UI_OZONE_PLATFORM_EGL_LATENCY_TRACKER_H_
+
+#include <stdint.h>
+
+#include "base/lazy_instance.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace ui {
+
+// Correlates input events with the frames that first show their effect.
+// eglWindow reports the kernel (evdev) timestamp of every input event; the
+// canvas reports each present that carries damage and, later, the time the
+// frame reached scanout. The oldest input waiting for a frame is charged to
+// that frame, which gives an upper bound on input-to-photon latency.
+class EglLatencyTracker {
+ public:
+  // 1 ms buckets up to kBucketCount - 1 ms; the last bucket is overflow.
+  static const int kBucketCount = 101;
+
+  struct Histogram {
+    uint64_t count;
+    base::TimeDelta min;
+    base::TimeDelta max;
+    base::TimeDelta sum;
+    uint32_t buckets[kBucketCount];
+
+    base::TimeDelta Mean() const;
+    // Upper bound of the bucket holding the |percent|th percentile.
+    base::TimeDelta Percentile(int percent) const;
+  };
+
+  static EglLatencyTracker* GetInstance();
+
+  // |time_stamp| is ui::Event::time_stamp(), i.e. CLOCK_MONOTONIC as set by
+  // the evdev converters.
+  void OnInputEvent(base::TimeDelta time_stamp);
+
+  // Called when a damaged frame is submitted. Returns a token for
+  // OnScanout(), or 0 if no input was waiting for this frame.
+  uint32_t OnPresent(base::TimeTicks present_time);
+  void OnScanout(uint32_t token, base::TimeTicks scanout_time);
+
+  void GetInputToPresent(Histogram* histogram);
+  void GetInputToScanout(Histogram* histogram);
+  void Reset();
+
+ private:
+  friend struct base::DefaultLazyInstanceTraits<EglLatencyTracker>;
+
+  static const int kMaxFramesInFlight = 4;
+
+  struct InFlight {
+    uint32_t token;
+    base::TimeTicks input_time;
+  };
+
+  EglLatencyTracker();
+  ~EglLatencyTracker();
+
+  static void Record(Histogram* histogram, base::TimeDelta latency);
+
+  base::Lock lock_;
+  base::TimeTicks oldest_pending_input_;
+  uint32_t next_token_;
+  InFlight in_flight_[kMaxFramesInFlight];
+  Histogram input_to_present_;
+  Histogram input_to_scanout_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglLatencyTracker);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_LATENCY_TRACKER_H_
@@ -0,0 +1,101 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_native_display_delegate.h"
+
+#include "ui/display/types/display_mode.h"
+#include "ui/display/types/display_snapshot.h"
+#include "ui/ozone/common/display_snapshot_proxy.h"
+#include "ui/ozone/common/gpu/ozone_gpu_message_params.h"
+#include "ui/ozone/platform/egl/egl_surface_factory.h"
+#include "egl_wrapper.h"
+
+namespace ui {
+
+namespace {
+
+DisplayConnectionType GetConnectionType(int type) {
+  switch (type) {
+    case OZONE_EGL_OUTPUT_INTERNAL:
+      return DISPLAY_CONNECTION_TYPE_INTERNAL;
+    case OZONE_EGL_OUTPUT_VGA:
+      return DISPLAY_CONNECTION_TYPE_VGA;
+    case OZONE_EGL_OUTPUT_HDMI:
+      return DISPLAY_CONNECTION_TYPE_HDMI;
+    case OZONE_EGL_OUTPUT_DVI:
+      return DISPLAY_CONNECTION_TYPE_DVI;
+    case OZONE_EGL_OUTPUT_DISPLAYPORT:
+      return DISPLAY_CONNECTION_TYPE_DISPLAYPORT;
+    default:
+      return DISPLAY_CONNECTION_TYPE_UNKNOWN;
+  }
+}
+
+DisplayMode_Params GetModeParams(const ozone_egl_Mode& mode) {
+  DisplayMode_Params params;
+  params.size = gfx::Size(mode.width, mode.height);
+  params.is_interlaced = mode.interlaced != 0;
+  params.refresh_rate = mode.refreshRate;
+  return params;
+}
+
+DisplaySnapshot_Params GetSnapshotParams(const ozone_egl_Output& output) {
+  DisplaySnapshot_Params params;
+  params.display_id = output.id;
+  params.origin = gfx::Point(output.x, output.y);
+  params.physical_size = gfx::Size(output.widthMm, output.heightMm);
+  params.type = GetConnectionType(output.type);
+  params.display_name = output.name;
+  for (int i = 0; i < output.modeCount; i++)
+    params.modes.push_back(GetModeParams(output.modes[i]));
+  if (output.currentMode >= 0 && output.currentMode < output.modeCount) {
+    params.has_current_mode = true;
+    params.current_mode = GetModeParams(output.modes[output.currentMode]);
+  }
+  if (output.nativeMode >= 0 && output.nativeMode < output.modeCount) {
+    params.has_native_mode = true;
+    params.native_mode = GetModeParams(output.modes[output.nativeMode]);
+  }
+  params.string_representation = output.name;
+  return params;
+}
+
+}  // namespace
+
+EglNativeDisplayDelegate::EglNativeDisplayDelegate(
+    SurfaceFactoryEgl* surface_factory)
+    : surface_factory_(surface_factory) {}
+
+EglNativeDisplayDelegate::~EglNativeDisplayDelegate() {}
+
+void EglNativeDisplayDelegate::Initialize() {
+  // Outputs are enumerated through the backend, which comes up with the
+  // window.
+  surface_factory_->CreateSingleWindow();
+}
+
+void EglNativeDisplayDelegate::GetDisplays(
+    const GetDisplaysCallback& callback) {
+  ozone_egl_Output outputs[OZONE_EGL_MAX_OUTPUTS];
+  int count = ozone_egl_getOutputs(outputs, OZONE_EGL_MAX_OUTPUTS);
+
+  displays_.clear();
+  for (int i = 0; i < count; i++) {
+    displays_.push_back(
+        new DisplaySnapshotProxy(GetSnapshotParams(outputs[i])));
+  }
+  callback.Run(displays_.get());
+}
+
+void EglNativeDisplayDelegate::Configure(const DisplaySnapshot& output,
+                                         const DisplayMode* mode,
+                                         const gfx::Point& origin,
+                                         const ConfigureCallback& callback) {
+  const DisplayMode* current = output.current_mode();
+  callback.Run(mode && current && mode->size() == current->size() &&
+               mode->refresh_rate() == current->refresh_rate() &&
+               origin == output.origin());
+}
+
+}  // namespace ui
@@ -0,0 +1,41 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_NATIVE_DISPLAY_DELEGATE_H_
+#define UI_OZONE_PLATFORM_EGL_NATIVE_DISPLAY_DELEGATE_H_
+
+#include "base/memory/scoped_vector.h"
+#include "ui/ozone/common/native_display_delegate_ozone.h"
+
+namespace ui {
+
+class DisplaySnapshot;
+class SurfaceFactoryEgl;
+
+// Reports the outputs the EGL backend found, with their modes, refresh
+// rates and physical size. Mode changes are not supported; Configure()
+// only accepts the mode an output already shows.
+class EglNativeDisplayDelegate : public NativeDisplayDelegateOzone {
+ public:
+  explicit EglNativeDisplayDelegate(SurfaceFactoryEgl* surface_factory);
+  ~EglNativeDisplayDelegate() override;
+
+  // NativeDisplayDelegate:
+  void Initialize() override;
+  void GetDisplays(const GetDisplaysCallback& callback) override;
+  void Configure(const DisplaySnapshot& output,
+                 const DisplayMode* mode,
+                 const gfx::Point& origin,
+                 const ConfigureCallback& callback) override;
+
+ private:
+  SurfaceFactoryEgl* surface_factory_;
+  ScopedVector<DisplaySnapshot> displays_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglNativeDisplayDelegate);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_NATIVE_DISPLAY_DELEGATE_H_
@@ -0,0 +1,73 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <stdint.h>
+
+#include "egl_pixel_pack.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// One pixel at a time; also finishes the rows of the SIMD variants.
+static void ozone_egl_packRgbTail(const char* src, char* dst, int pixels,
+                                  int bgra)
+{
+    int red = bgra ? 2 : 0;
+
+    for (; pixels > 0; pixels--, src += 4, dst += 3)
+    {
+        dst[0] = src[red];
+        dst[1] = src[1];
+        dst[2] = src[2 - red];
+    }
+}
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+void ozone_egl_packRgb(const char* src, char* dst, int pixels, int bgra)
+{
+    // De-interleaves 16 pixels into channel registers and stores three.
+    for (; pixels >= 16; pixels -= 16, src += 64, dst += 48)
+    {
+        uint8x16x4_t in = vld4q_u8((const uint8_t*)src);
+        uint8x16x3_t out;
+
+        out.val[0] = bgra ? in.val[2] : in.val[0];
+        out.val[1] = in.val[1];
+        out.val[2] = bgra ? in.val[0] : in.val[2];
+        vst3q_u8((uint8_t*)dst, out);
+    }
+    ozone_egl_packRgbTail(src, dst, pixels, bgra);
+}
+
+#elif defined(__SSSE3__)
+
+void ozone_egl_packRgb(const char* src, char* dst, int pixels, int bgra)
+{
+    const __m128i shuffle = bgra ?
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                      -1, -1, -1, -1) :
+        _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                      -1, -1, -1, -1);
+
+    // Each store of 4 pixels writes 16 bytes of which 12 are kept, so stop
+    // while the last 4 still fit.
+    for (; pixels >= 6; pixels -= 4, src += 16, dst += 12)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i*)src);
+        _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(in, shuffle));
+    }
+    ozone_egl_packRgbTail(src, dst, pixels, bgra);
+}
+
+#else
+
+void ozone_egl_packRgb(const char* src, char* dst, int pixels, int bgra)
+{
+    ozone_egl_packRgbTail(src, dst, pixels, bgra);
+}
+
+#endif
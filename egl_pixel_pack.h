@@ -0,0 +1,13 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef UI_OZONE_EGL_PIXEL_PACK_H_
+#define UI_OZONE_EGL_PIXEL_PACK_H_
+
+// Packs |pixels| 4-byte pixels of |src| into 3-byte RGB at |dst|, dropping
+// the alpha byte. |bgra| says the source is BGRA rather than RGBA. Uses
+// NEON or SSSE3 where the compiler targets them; all variants produce the
+// same bytes.
+void ozone_egl_packRgb(const char* src, char* dst, int pixels, int bgra);
+
+#endif
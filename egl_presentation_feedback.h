@@ -0,0 +1,38 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_PRESENTATION_FEEDBACK_H_
+#define UI_OZONE_PLATFORM_EGL_PRESENTATION_FEEDBACK_H_
+
+#include <stdint.h>
+
+#include "base/time/time.h"
+#include "ui/gfx/native_widget_types.h"
+
+namespace ui {
+
+// When and how a frame of the GPU process reached the screen.
+struct EglPresentationFeedback {
+  EglPresentationFeedback() : flags(0) {}
+
+  // CLOCK_MONOTONIC time of the flip.
+  base::TimeTicks timestamp;
+  // Refresh interval of the output, zero if unknown.
+  base::TimeDelta interval;
+  // OZONE_EGL_PRESENT_* flags of the backend.
+  uint32_t flags;
+};
+
+class EglPresentationObserver {
+ public:
+  virtual void OnFramePresented(gfx::AcceleratedWidget widget,
+                                const EglPresentationFeedback& feedback) = 0;
+
+ protected:
+  virtual ~EglPresentationObserver() {}
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_PRESENTATION_FEEDBACK_H_
@@ -0,0 +1,171 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_raster_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "third_party/skia/include/core/SkSurface.h"
+
+namespace ui {
+
+namespace {
+
+base::LazyInstance<EglRasterPool>::Leaky g_raster_pool =
+    LAZY_INSTANCE_INITIALIZER;
+
+const size_t kCacheLineSize = 64;
+const size_t kHugePageSize = 2 * 1024 * 1024;
+
+size_t RoundUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+bool IsEnabled(const char* name, bool default_value) {
+  const char* value = getenv(name);
+  if (!value)
+    return default_value;
+  return strcmp(value, "0") != 0;
+}
+
+}  // namespace
+
+// static
+EglRasterPool* EglRasterPool::GetInstance() {
+  return g_raster_pool.Pointer();
+}
+
+EglRasterPool::EglRasterPool()
+    : enabled_(IsEnabled("OZONE_EGL_RASTER_POOL", true)),
+      huge_pages_(IsEnabled("OZONE_EGL_HUGEPAGES", false)),
+      page_size_(sysconf(_SC_PAGESIZE)) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+EglRasterPool::~EglRasterPool() {
+  Trim();
+}
+
+skia::RefPtr<SkSurface> EglRasterPool::CreateSurface(
+    const SkImageInfo& info) {
+  if (!enabled_)
+    return skia::RefPtr<SkSurface>();
+
+  size_t row_bytes = RoundUp(info.minRowBytes(), kCacheLineSize);
+  size_t size = row_bytes * info.height();
+  Buffer buffer;
+  {
+    base::AutoLock lock(lock_);
+    // Smallest idle buffer that fits.
+    size_t best = idle_.size();
+    for (size_t i = 0; i < idle_.size(); i++) {
+      if (idle_[i].size >= size &&
+          (best == idle_.size() || idle_[i].size < idle_[best].size))
+        best = i;
+    }
+    if (best < idle_.size()) {
+      buffer = idle_[best];
+      idle_.erase(idle_.begin() + best);
+      stats_.reused++;
+    } else if (!Map(size, &buffer)) {
+      return skia::RefPtr<SkSurface>();
+    }
+    in_use_.push_back(buffer);
+  }
+
+  SkSurface* surface = SkSurface::NewRasterDirectReleaseProc(
+      info, buffer.pixels, row_bytes, &EglRasterPool::ReleasePixels, this);
+  if (!surface)
+    ReleasePixels(buffer.pixels, this);
+  return skia::AdoptRef(surface);
+}
+
+size_t EglRasterPool::Trim() {
+  base::AutoLock lock(lock_);
+  size_t bytes = 0;
+  for (size_t i = 0; i < idle_.size(); i++) {
+    bytes += idle_[i].size;
+    Unmap(idle_[i]);
+  }
+  idle_.clear();
+  return bytes;
+}
+
+void EglRasterPool::GetStats(Stats* stats) {
+  base::AutoLock lock(lock_);
+  *stats = stats_;
+}
+
+// static
+void EglRasterPool::ReleasePixels(void* pixels, void* context) {
+  EglRasterPool* pool = static_cast<EglRasterPool*>(context);
+  base::AutoLock lock(pool->lock_);
+  for (size_t i = 0; i < pool->in_use_.size(); i++) {
+    if (pool->in_use_[i].pixels != pixels)
+      continue;
+    Buffer buffer = pool->in_use_[i];
+    pool->in_use_.erase(pool->in_use_.begin() + i);
+    if (pool->idle_.size() < kMaxIdleBuffers) {
+      pool->idle_.push_back(buffer);
+    } else {
+      pool->Unmap(buffer);
+    }
+    return;
+  }
+  NOTREACHED() << "Unknown raster buffer";
+}
+
+bool EglRasterPool::Map(size_t size, Buffer* buffer) {
+  // Huge pages need 2 MB aligned, 2 MB sized ranges; map a little more and
+  // cut the ends off.
+  size_t alignment = huge_pages_ ? kHugePageSize : page_size_;
+  size = RoundUp(size, alignment);
+  size_t mapped_size = size + (huge_pages_ ? kHugePageSize : 0);
+  void* mapping = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map " << size / 1024 << " KB raster buffer";
+    return false;
+  }
+
+  uint8_t* pixels = static_cast<uint8_t*>(mapping);
+  if (huge_pages_) {
+    uint8_t* aligned = reinterpret_cast<uint8_t*>(
+        RoundUp(reinterpret_cast<uintptr_t>(pixels), kHugePageSize));
+    size_t head = aligned - pixels;
+    if (head)
+      munmap(pixels, head);
+    if (kHugePageSize - head)
+      munmap(aligned + size, kHugePageSize - head);
+    pixels = aligned;
+#if defined(MADV_HUGEPAGE)
+    if (!madvise(pixels, size, MADV_HUGEPAGE))
+      stats_.huge_bytes += size;
+    else
+      PLOG(WARNING) << "Transparent huge pages unavailable";
+#endif
+  }
+
+  // Fault the buffer in now, with huge pages where the kernel has them.
+  for (size_t offset = 0; offset < size; offset += page_size_)
+    pixels[offset] = 0;
+
+  buffer->pixels = pixels;
+  buffer->size = size;
+  stats_.allocated++;
+  stats_.prefaulted_pages += size / page_size_;
+  stats_.mapped_bytes += size;
+  return true;
+}
+
+void EglRasterPool::Unmap(const Buffer& buffer) {
+  munmap(buffer.pixels, buffer.size);
+  stats_.mapped_bytes -= buffer.size;
+}
+
+}  // namespace ui
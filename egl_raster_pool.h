@@ -0,0 +1,92 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_RASTER_POOL_H_
+#define UI_OZONE_PLATFORM_EGL_RASTER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/lazy_instance.h"
+#include "base/synchronization/lock.h"
+#include "skia/ext/refptr.h"
+#include "third_party/skia/include/core/SkImageInfo.h"
+
+class SkSurface;
+
+namespace ui {
+
+// Pixel memory for the software canvases. Buffers are mapped page aligned
+// with cache-line aligned rows, faulted in when they are mapped rather than
+// on the first raster of the frame, and kept when their surface goes away,
+// so a canvas that is resized or recreated reuses them. With
+// OZONE_EGL_HUGEPAGES=1 they are advised for transparent huge pages, which
+// cuts the TLB misses of rasterising and packing a full-HD canvas.
+// OZONE_EGL_RASTER_POOL=0 disables the pool, for comparison.
+class EglRasterPool {
+ public:
+  struct Stats {
+    // Buffers mapped, and surfaces served from an idle buffer
+    uint64_t allocated;
+    uint64_t reused;
+    // Small pages touched when mapping, i.e. first-touch faults raster no
+    // longer takes
+    uint64_t prefaulted_pages;
+    // Bytes advised for transparent huge pages
+    uint64_t huge_bytes;
+    // Bytes mapped now, in use or idle
+    uint64_t mapped_bytes;
+  };
+
+  static EglRasterPool* GetInstance();
+
+  // A raster surface over a pooled buffer, which returns to the pool when
+  // the surface is destroyed, on whichever thread that happens. Returns
+  // null if the pool is disabled or out of memory; callers then use
+  // SkSurface::NewRaster().
+  skia::RefPtr<SkSurface> CreateSurface(const SkImageInfo& info);
+
+  // Unmaps the idle buffers. Returns the number of bytes freed.
+  size_t Trim();
+
+  void GetStats(Stats* stats);
+
+ private:
+  friend struct base::DefaultLazyInstanceTraits<EglRasterPool>;
+
+  // Idle buffers kept for reuse; a resize usually frees one canvas buffer
+  // and asks for another.
+  static const size_t kMaxIdleBuffers = 2;
+
+  struct Buffer {
+    void* pixels;
+    size_t size;
+  };
+
+  EglRasterPool();
+  ~EglRasterPool();
+
+  // SkSurface release proc; |context| is the pool.
+  static void ReleasePixels(void* pixels, void* context);
+
+  // Called with |lock_| held.
+  bool Map(size_t size, Buffer* buffer);
+  void Unmap(const Buffer& buffer);
+
+  base::Lock lock_;
+  const bool enabled_;
+  const bool huge_pages_;
+  const size_t page_size_;
+  std::vector<Buffer> idle_;
+  std::vector<Buffer> in_use_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglRasterPool);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_RASTER_POOL_H_
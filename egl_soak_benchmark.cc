@@ -0,0 +1,501 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Soak benchmark for the EGL platform. For as long as it runs it destroys
+// and recreates the window, resizes the canvas, moves a cursor, hides and
+// shows the output, starts and stops captures and presents random damage,
+// and samples the process: resident memory, open file descriptors, live GL
+// objects and the time a present takes. Once warmed up, growth past the
+// limits fails the run. Resident memory also moves with heap fragmentation
+// and the GL driver's own mappings, so malloc'ed bytes in use are tracked
+// separately with a much tighter limit.
+//
+// Everything goes through SurfaceFactoryEgl, EglOzoneCanvas and EglCursor
+// the way the software compositor drives them, so the raster pool, the tile
+// pool, the memory pressure trim and suspend are soaked along with the
+// wrapper.
+//
+// Meant for a software EGL, so that it can run for hours on a build
+// machine, e.g. with OZONE_EGL_BACKEND=surfaceless LIBGL_ALWAYS_SOFTWARE=1
+// and --duration=14400.
+
+#include <dirent.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "third_party/skia/include/core/SkBitmap.h"
+#include "third_party/skia/include/core/SkCanvas.h"
+#include "third_party/skia/include/core/SkSurface.h"
+#include "ui/gfx/geometry/point.h"
+#include "ui/gfx/geometry/point_f.h"
+#include "ui/gfx/geometry/rect.h"
+#include "ui/gfx/geometry/size.h"
+#include "ui/ozone/common/bitmap_cursor_factory_ozone.h"
+#include "ui/ozone/platform/egl/egl_cursor.h"
+#include "ui/ozone/platform/egl/egl_surface_factory.h"
+#include "ui/ozone/public/surface_ozone_canvas.h"
+#include "egl_wrapper.h"
+
+namespace {
+
+// GL names are probed upwards until this many in a row are unused.
+const GLuint kGLNameProbeGap = 1024;
+
+struct Options {
+  int duration_s;
+  int sample_s;
+  int warmup_s;
+  int frames_per_resize;
+  int resizes_per_window;
+  long max_rss_growth_kb;
+  long max_heap_growth_kb;
+  int max_fd_growth;
+  int max_gl_growth;
+  int max_latency_drift_percent;
+  unsigned seed;
+};
+
+struct GLObjectCount {
+  int textures;
+  int buffers;
+  int programs;
+  int shaders;
+  int framebuffers;
+  int renderbuffers;
+
+  int Total() const {
+    return textures + buffers + programs + shaders + framebuffers +
+           renderbuffers;
+  }
+};
+
+struct Sample {
+  int elapsed_s;
+  long rss_kb;
+  long heap_kb;
+  int fds;
+  GLObjectCount gl;
+  double present_ms;
+};
+
+bool ParseOption(const char* arg, const char* name, long* value) {
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) || arg[length] != '=')
+    return false;
+  *value = atol(arg + length + 1);
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  options->duration_s = 3600;
+  options->sample_s = 60;
+  options->warmup_s = -1;
+  options->frames_per_resize = 120;
+  options->resizes_per_window = 10;
+  options->max_rss_growth_kb = 32768;
+  options->max_heap_growth_kb = 1024;
+  options->max_fd_growth = 0;
+  options->max_gl_growth = 0;
+  options->max_latency_drift_percent = 50;
+  options->seed = time(NULL);
+
+  for (int i = 1; i < argc; i++) {
+    long value;
+    if (ParseOption(argv[i], "--duration", &value))
+      options->duration_s = value;
+    else if (ParseOption(argv[i], "--sample", &value))
+      options->sample_s = value;
+    else if (ParseOption(argv[i], "--warmup", &value))
+      options->warmup_s = value;
+    else if (ParseOption(argv[i], "--frames-per-resize", &value))
+      options->frames_per_resize = value;
+    else if (ParseOption(argv[i], "--resizes-per-window", &value))
+      options->resizes_per_window = value;
+    else if (ParseOption(argv[i], "--max-rss-growth-kb", &value))
+      options->max_rss_growth_kb = value;
+    else if (ParseOption(argv[i], "--max-heap-growth-kb", &value))
+      options->max_heap_growth_kb = value;
+    else if (ParseOption(argv[i], "--max-fd-growth", &value))
+      options->max_fd_growth = value;
+    else if (ParseOption(argv[i], "--max-gl-growth", &value))
+      options->max_gl_growth = value;
+    else if (ParseOption(argv[i], "--max-latency-drift", &value))
+      options->max_latency_drift_percent = value;
+    else if (ParseOption(argv[i], "--seed", &value))
+      options->seed = value;
+    else
+      return false;
+  }
+  if (options->warmup_s < 0)
+    options->warmup_s = options->sample_s;
+  return options->sample_s > 0 && options->frames_per_resize > 0 &&
+         options->resizes_per_window > 0;
+}
+
+long GetRssKb() {
+  long pages = 0;
+  long resident = 0;
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (!file)
+    return 0;
+  if (fscanf(file, "%ld %ld", &pages, &resident) != 2)
+    resident = 0;
+  fclose(file);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+long GetHeapKb() {
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2();
+  return (info.uordblks + info.hblkhd) / 1024;
+#elif defined(__GLIBC__)
+  struct mallinfo info = mallinfo();
+  return (static_cast<unsigned>(info.uordblks) +
+          static_cast<unsigned>(info.hblkhd)) / 1024;
+#else
+  return 0;
+#endif
+}
+
+int GetFdCount() {
+  DIR* dir = opendir("/proc/self/fd");
+  int count = 0;
+  if (!dir)
+    return 0;
+  while (readdir(dir))
+    count++;
+  closedir(dir);
+  // ".", ".." and the directory itself.
+  return count - 3;
+}
+
+int CountGLObjects(GLboolean (*is_object)(GLuint)) {
+  int count = 0;
+  GLuint gap = 0;
+  for (GLuint name = 1; gap < kGLNameProbeGap; name++) {
+    if (is_object(name)) {
+      count++;
+      gap = 0;
+    } else {
+      gap++;
+    }
+  }
+  return count;
+}
+
+GLboolean IsTexture(GLuint name) { return glIsTexture(name); }
+GLboolean IsBuffer(GLuint name) { return glIsBuffer(name); }
+GLboolean IsProgram(GLuint name) { return glIsProgram(name); }
+GLboolean IsShader(GLuint name) { return glIsShader(name); }
+GLboolean IsFramebuffer(GLuint name) { return glIsFramebuffer(name); }
+GLboolean IsRenderbuffer(GLuint name) { return glIsRenderbuffer(name); }
+
+void GetGLObjectCount(GLObjectCount* count) {
+  memset(count, 0, sizeof(*count));
+  if (!ozone_egl_makecurrent())
+    return;
+  count->textures = CountGLObjects(IsTexture);
+  count->buffers = CountGLObjects(IsBuffer);
+  count->programs = CountGLObjects(IsProgram);
+  count->shaders = CountGLObjects(IsShader);
+  count->framebuffers = CountGLObjects(IsFramebuffer);
+  count->renderbuffers = CountGLObjects(IsRenderbuffer);
+}
+
+uint64_t NowUsec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void OnCaptureFrame(uint64_t* captured_frames,
+                    const SkBitmap& frame,
+                    const gfx::Rect& update,
+                    base::TimeTicks swap_time) {
+  (*captured_frames)++;
+}
+
+// Runs what the canvas and cursor posted: software cursor redraws and the
+// memory pressure notification.
+void RunPendingTasks() {
+  base::RunLoop().RunUntilIdle();
+}
+
+class Soak {
+ public:
+  explicit Soak(const Options& options)
+      : options_(options),
+        screen_width_(0),
+        screen_height_(0),
+        frames_(0),
+        capturing_(false),
+        captured_frames_(0),
+        present_usec_(0),
+        present_count_(0) {
+    srand(options_.seed);
+  }
+
+  int Run() {
+    printf("Soak seed %u, %d s, sampling every %d s after %d s\n",
+           options_.seed, options_.duration_s, options_.sample_s,
+           options_.warmup_s);
+
+    uint64_t start = NowUsec();
+    uint64_t next_sample = start + options_.sample_s * 1000000ull;
+    bool have_baseline = false;
+    Sample baseline;
+    memset(&baseline, 0, sizeof(baseline));
+
+    while (NowUsec() - start < options_.duration_s * 1000000ull) {
+      if (!CreateWindow())
+        return 1;
+      for (int resize = 0; resize < options_.resizes_per_window; resize++) {
+        // Hidden once per window, and resized while hidden, so that the
+        // next frame has to bring the output back.
+        if (resize && resize == options_.resizes_per_window - 1)
+          factory_->Suspend();
+        ResizeCanvas(resize == 0);
+        if (resize == options_.resizes_per_window / 2)
+          StartCapture();
+        for (int frame = 0; frame < options_.frames_per_resize; frame++)
+          PresentRandomDamage();
+
+        if (NowUsec() < next_sample)
+          continue;
+        next_sample += options_.sample_s * 1000000ull;
+
+        Sample sample;
+        TakeSample((NowUsec() - start) / 1000000, &sample);
+        if (sample.elapsed_s < options_.warmup_s)
+          continue;
+        if (!have_baseline) {
+          baseline = sample;
+          have_baseline = true;
+          printf("Baseline taken\n");
+        } else if (!CheckGrowth(baseline, sample)) {
+          DestroyWindow();
+          printf("FAIL after %d frames\n", frames_);
+          return 1;
+        }
+      }
+      DestroyWindow();
+    }
+
+    printf("PASS: %d frames, %llu captured\n", frames_,
+           (unsigned long long)captured_frames_);
+    return 0;
+  }
+
+ private:
+  bool CreateWindow() {
+    // The canvas reads it when it is created.
+    setenv("OZONE_EGL_OPAQUE", rand() & 1 ? "1" : "0", 1);
+    cursor_.reset(new ui::EglCursor);
+    factory_.reset(new ui::SurfaceFactoryEgl);
+    factory_->SetCursor(cursor_.get());
+    if (!factory_->CreateSingleWindow()) {
+      printf("FAIL: CreateSingleWindow\n");
+      return false;
+    }
+    ozone_egl_Output output;
+    if (ozone_egl_getOutputs(&output, 1) && output.modeCount) {
+      int mode = output.currentMode >= 0 ? output.currentMode : 0;
+      screen_width_ = output.modes[mode].width;
+      screen_height_ = output.modes[mode].height;
+    }
+    if (screen_width_ <= 0 || screen_height_ <= 0) {
+      screen_width_ = 1280;
+      screen_height_ = 720;
+    }
+    cursor_->SetBounds(gfx::Rect(screen_width_, screen_height_));
+    CreateCanvas();
+    return true;
+  }
+
+  void DestroyWindow() {
+    StopCapture();
+    canvas_.reset();
+    factory_.reset();
+    cursor_.reset();
+    RunPendingTasks();
+  }
+
+  void CreateCanvas() {
+    canvas_ = factory_->CreateCanvasForWidget(factory_->GetNativeWindow());
+  }
+
+  // The first size of a window is the whole screen, like Chromium's.
+  void ResizeCanvas(bool full_screen) {
+    size_.SetSize(full_screen ? screen_width_
+                              : screen_width_ / 4 +
+                                    rand() % (screen_width_ * 3 / 4),
+                  full_screen ? screen_height_
+                              : screen_height_ / 4 +
+                                    rand() % (screen_height_ * 3 / 4));
+    canvas_->ResizeCanvas(size_);
+
+    SkBitmap bitmap;
+    bitmap.allocN32Pixels(16, 16);
+    bitmap.eraseColor(0xff000000 | rand());
+    ui::PlatformCursor cursor =
+        cursor_factory_.CreateImageCursor(bitmap, gfx::Point());
+    cursor_->SetCursor(cursor);
+    cursor_factory_.UnrefImageCursor(cursor);
+  }
+
+  void StartCapture() {
+    factory_->StartCapture(
+        gfx::Rect(), gfx::Size(screen_width_ / 2, screen_height_ / 2),
+        rand() & 1, base::TimeDelta(),
+        base::Bind(&OnCaptureFrame, &captured_frames_));
+    capturing_ = true;
+  }
+
+  void StopCapture() {
+    if (factory_)
+      factory_->StopCapture();
+    capturing_ = false;
+  }
+
+  void PresentRandomDamage() {
+    skia::RefPtr<SkSurface> surface = canvas_->GetSurface();
+    SkPaint paint;
+    paint.setColor(0xff000000 | rand());
+    gfx::Rect damage;
+    int rects = 1 + rand() % 4;
+    for (int i = 0; i < rects; i++) {
+      int width = 1 + rand() % size_.width();
+      int height = 1 + rand() % size_.height();
+      int x = rand() % (size_.width() - width + 1);
+      int y = rand() % (size_.height() - height + 1);
+      surface->getCanvas()->drawRect(SkRect::MakeXYWH(x, y, width, height),
+                                     paint);
+      damage.Union(gfx::Rect(x, y, width, height));
+    }
+    cursor_->MoveCursorTo(
+        gfx::PointF(rand() % size_.width(), rand() % size_.height()));
+
+    uint64_t start = NowUsec();
+    canvas_->PresentCanvas(damage);
+    present_usec_ += NowUsec() - start;
+    present_count_++;
+    frames_++;
+    RunPendingTasks();
+  }
+
+  // Taken without a canvas, whose tile count depends on its size, and
+  // without a capture, so that both have to give everything back. Memory
+  // pressure then empties the raster pool, which keeps the last canvas
+  // sizes around.
+  void TakeSample(int elapsed_s, Sample* sample) {
+    bool capturing = capturing_;
+    canvas_.reset();
+    StopCapture();
+    // The capture gives its GL objects back at the next swap.
+    ozone_egl_swap();
+    base::MemoryPressureListener::NotifyMemoryPressure(
+        base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL);
+    RunPendingTasks();
+
+    sample->elapsed_s = elapsed_s;
+    sample->rss_kb = GetRssKb();
+    sample->heap_kb = GetHeapKb();
+    sample->fds = GetFdCount();
+    GetGLObjectCount(&sample->gl);
+    sample->present_ms =
+        present_count_ ? present_usec_ / 1000.0 / present_count_ : 0;
+    present_usec_ = 0;
+    present_count_ = 0;
+
+    printf("t=%5d s rss=%ld KB heap=%ld KB fds=%d gl=%d (tex %d buf %d "
+           "prog %d shader %d fb %d rb %d) present=%.2f ms\n",
+           sample->elapsed_s, sample->rss_kb, sample->heap_kb, sample->fds,
+           sample->gl.Total(), sample->gl.textures, sample->gl.buffers,
+           sample->gl.programs, sample->gl.shaders, sample->gl.framebuffers,
+           sample->gl.renderbuffers, sample->present_ms);
+    fflush(stdout);
+
+    CreateCanvas();
+    canvas_->ResizeCanvas(size_);
+    if (capturing)
+      StartCapture();
+  }
+
+  bool CheckGrowth(const Sample& baseline, const Sample& sample) {
+    bool ok = true;
+    if (sample.rss_kb - baseline.rss_kb > options_.max_rss_growth_kb) {
+      printf("RSS grew by %ld KB\n", sample.rss_kb - baseline.rss_kb);
+      ok = false;
+    }
+    if (sample.heap_kb - baseline.heap_kb > options_.max_heap_growth_kb) {
+      printf("Heap grew by %ld KB\n", sample.heap_kb - baseline.heap_kb);
+      ok = false;
+    }
+    if (sample.fds - baseline.fds > options_.max_fd_growth) {
+      printf("%d file descriptors leaked\n", sample.fds - baseline.fds);
+      ok = false;
+    }
+    if (sample.gl.Total() - baseline.gl.Total() > options_.max_gl_growth) {
+      printf("%d GL objects leaked\n",
+             sample.gl.Total() - baseline.gl.Total());
+      ok = false;
+    }
+    if (baseline.present_ms > 0 &&
+        sample.present_ms > baseline.present_ms *
+                                (100 + options_.max_latency_drift_percent) /
+                                100) {
+      printf("Present time drifted from %.2f to %.2f ms\n",
+             baseline.present_ms, sample.present_ms);
+      ok = false;
+    }
+    return ok;
+  }
+
+  const Options options_;
+  ui::BitmapCursorFactoryOzone cursor_factory_;
+  scoped_ptr<ui::EglCursor> cursor_;
+  scoped_ptr<ui::SurfaceFactoryEgl> factory_;
+  scoped_ptr<ui::SurfaceOzoneCanvas> canvas_;
+  int screen_width_;
+  int screen_height_;
+  gfx::Size size_;
+  int frames_;
+  bool capturing_;
+  uint64_t captured_frames_;
+  uint64_t present_usec_;
+  int present_count_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    fprintf(stderr,
+            "Usage: %s [--duration=s] [--sample=s] [--warmup=s] "
+            "[--frames-per-resize=n] [--resizes-per-window=n] "
+            "[--max-rss-growth-kb=n] [--max-heap-growth-kb=n] "
+            "[--max-fd-growth=n] "
+            "[--max-gl-growth=n] [--max-latency-drift=percent] "
+            "[--seed=n]\n",
+            argv[0]);
+    return 2;
+  }
+  // The canvas posts cursor redraws and listens for memory pressure.
+  base::AtExitManager at_exit;
+  base::MessageLoop message_loop;
+  Soak soak(options);
+  return soak.Run();
+}
@@ -5,13 +5,29 @@
 #include "third_party/skia/include/core/SkBitmap.h"
 #include "third_party/skia/include/core/SkCanvas.h"
 #include "third_party/skia/include/core/SkSurface.h"
+#include "third_party/skia/include/gpu/GrContext.h"
+#include "third_party/skia/include/gpu/gl/GrGLInterface.h"
 #include "ui/ozone/public/surface_ozone_egl.h"
 #include "ui/ozone/public/surface_ozone_canvas.h"
 #include "ui/ozone/public/surface_factory_ozone.h"
+#include "ui/gfx/geometry/rect.h"
+#include "ui/gfx/geometry/size.h"
 #include "ui/gfx/skia_util.h"
+#include "ui/gfx/swap_result.h"
 #include "ui/gfx/vsync_provider.h"
+#include "base/bind.h"
 #include "base/logging.h"
+#include "base/memory/weak_ptr.h"
+#include "base/metrics/histogram.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/trace_event/trace_event.h"
 #include "ui/ozone/common/egl_util.h"
+#include "ui/ozone/platform/egl/egl_cursor.h"
+#include "ui/ozone/platform/egl/egl_gpu_platform_support.h"
+#include "ui/ozone/platform/egl/egl_latency_tracker.h"
+#include "ui/ozone/platform/egl/egl_presentation_feedback.h"
+#include "ui/ozone/platform/egl/egl_raster_pool.h"
+#include "ui/ozone/platform/egl/egl_tile_pool.h"
 
 #include "egl_wrapper.h"
 
@@ -19,19 +35,122 @@
  #define GL_BGRA_EXT 0x80E1
 #endif
 
-#include <fcntl.h>    /* For O_RDWR */
-#include <unistd.h>   /* For open(), creat() */
-#include <linux/fb.h>
-#include <sys/ioctl.h>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <vector>
 
 #define OZONE_EGL_WINDOW_WIDTH 1024
 #define OZONE_EGL_WINDOW_HEIGTH 768
 
 namespace ui {
 
+namespace {
+
+// Packing is a plain copy, so a few threads saturate memory bandwidth.
+const int kMaxTileThreads = 3;
+
+// Presents between tile hash reports in the log.
+const int kHashReportInterval = 300;
+
+// Presents between upload throughput reports in the log.
+const int kUploadReportInterval = 300;
+
+// Whether the OZONE_EGL_* switch |name| is set to anything but 0.
+bool IsEnabled(const char* name) {
+  const char* value = getenv(name);
+  return value && strcmp(value, "0") != 0;
+}
+
+// Minor page faults taken by the calling thread so far.
+long GetThreadMinorFaults() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage))
+    return 0;
+  return usage.ru_minflt;
+}
+
+class EglVSyncProvider : public gfx::VSyncProvider {
+ public:
+  EglVSyncProvider() {}
+  ~EglVSyncProvider() override {}
+
+  void GetVSyncParameters(const UpdateVSyncCallback& callback) override {
+    uint64_t timebase, interval;
+    if (!ozone_egl_getVSyncParameters(&timebase, &interval))
+      return;
+    callback.Run(base::TimeTicks::FromInternalValue(timebase),
+                 base::TimeDelta::FromMicroseconds(interval));
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(EglVSyncProvider);
+};
+
+struct EglSwapCompletion {
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner;
+  // Null for synchronous swaps.
+  SurfaceOzoneEGL::SwapCompletionCallback callback;
+  gfx::AcceleratedWidget widget;
+  EglGpuPlatformSupport* gpu_platform_support;
+};
+
+void RunSwapCompletion(scoped_ptr<EglSwapCompletion> completion,
+                       uint64_t usec) {
+  if (!completion->callback.is_null())
+    completion->callback.Run(gfx::SwapResult::SWAP_ACK);
+  if (!completion->gpu_platform_support)
+    return;
+
+  EglPresentationFeedback feedback;
+  feedback.timestamp = base::TimeTicks::FromInternalValue(usec);
+  uint64_t timebase, interval;
+  if (ozone_egl_getVSyncParameters(&timebase, &interval))
+    feedback.interval = base::TimeDelta::FromMicroseconds(interval);
+  feedback.flags = ozone_egl_getPresentFlags();
+  completion->gpu_platform_support->OnFramePresented(completion->widget,
+                                                     feedback);
+}
+
+// Runs on whichever thread the backend reports flips on; hop back to the
+// thread that swapped before telling the GL surface and the browser.
+void OnFlipComplete(void* data, uint64_t usec) {
+  scoped_ptr<EglSwapCompletion> completion(
+      static_cast<EglSwapCompletion*>(data));
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner =
+      completion->task_runner;
+  task_runner->PostTask(FROM_HERE, base::Bind(&RunSwapCompletion,
+                                              base::Passed(&completion), usec));
+}
+
+void OnCanvasScanout(void* data, uint64_t usec) {
+  EglLatencyTracker::GetInstance()->OnScanout(
+      static_cast<uint32_t>(reinterpret_cast<uintptr_t>(data)),
+      base::TimeTicks::FromInternalValue(usec));
+}
+
+// GL entry points for Skia. Before EGL 1.5 eglGetProcAddress() need not
+// know core functions, so those come from the loaded GLES library.
+GrGLFuncPtr GetGLProc(void* context, const char name[]) {
+  GrGLFuncPtr proc = reinterpret_cast<GrGLFuncPtr>(dlsym(RTLD_DEFAULT, name));
+  if (!proc)
+    proc = reinterpret_cast<GrGLFuncPtr>(eglGetProcAddress(name));
+  return proc;
+}
+
+void PackTile(ozone_egl_UserData* user_data,
+              const std::vector<int>* tiles,
+              int index) {
+  ozone_egl_texturePackTile(user_data, (*tiles)[index]);
+}
+
+}  // namespace
+
 class EglOzoneCanvas: public ui::SurfaceOzoneCanvas {
  public:
-  EglOzoneCanvas();
+  EglOzoneCanvas(SurfaceFactoryEgl* factory, EglCursor* cursor);
   ~EglOzoneCanvas() override  ;
   // SurfaceOzoneCanvas overrides:
   void ResizeCanvas(const gfx::Size& viewport_size) override;
@@ -41,58 +160,439 @@ class EglOzoneCanvas: public ui::SurfaceOzoneCanvas {
   void PresentCanvas(const gfx::Rect& damage) override;
   
   scoped_ptr<gfx::VSyncProvider> CreateVSyncProvider() override {
-    return scoped_ptr<gfx::VSyncProvider>();
+    return make_scoped_ptr<gfx::VSyncProvider>(new EglVSyncProvider());
   }
-  skia::RefPtr<SkSurface> GetSurface() override { return surface_; }
+  skia::RefPtr<SkSurface> GetSurface() override;
+
+  // Frees the textures, program and raster surface; they come back with
+  // the next frame. Returns the number of bytes freed. Called by the
+  // factory, which owns the suspend state.
+  size_t Suspend();
+  // Brings back the textures after Suspend(), once the factory has the
+  // EGL surface back.
+  void Resume();
+  // Frees what the next frame can rebuild without losing content.
+  size_t Trim();
 
  private: 
+  // Recomposites the last frame with the software cursor on top, without
+  // uploading the canvas again.
+  void RedrawCursor();
+  // Wraps the canvas texture in a Skia GPU surface, or returns null and
+  // leaves the canvas to the raster path.
+  skia::RefPtr<SkSurface> CreateGpuSurface();
+  void FallBackToRaster();
+  // Drops |surface_|. A GPU surface wraps the canvas texture, so this comes
+  // before the texture goes and runs with the context current.
+  void ClearSurface();
+  // Packs the damaged tiles of the raster surface and draws them. Returns
+  // false if the frame turned out unchanged and should not be swapped.
+  bool UploadCanvas(const gfx::Rect& damage, gfx::Rect* effective_damage);
+  // Union of the tiles that still need an upload.
+  gfx::Rect GetTileDamage() const;
+  void ReportHashStats();
+  void ReportUploadStats();
+
   skia::RefPtr<SkSurface> surface_;
+  // Whether |surface_| lives in an EglRasterPool buffer.
+  bool surface_pooled_;
   ozone_egl_UserData userDate_;
+  SurfaceFactoryEgl* factory_;
+  EglCursor* cursor_;
+  // Set from OZONE_EGL_OPAQUE for devices whose UI never shows anything
+  // behind the browser window.
+  const bool opaque_;
+  // Set from OZONE_EGL_GPU_CANVAS: Skia rasterises on the GPU straight into
+  // the canvas texture, on the wrapper's context, so nothing is uploaded.
+  // Cleared for good if Skia cannot use the context.
+  bool gpu_canvas_;
+  skia::RefPtr<GrContext> gr_context_;
+  // Whether |surface_| renders into the canvas texture.
+  bool surface_gpu_;
+  scoped_ptr<EglTilePool> tile_pool_;
+  int presents_since_hash_report_;
+  // Canvas bytes uploaded, after the tile hash dropped unchanged tiles,
+  // since the last report; the time spent packing (and hashing) damaged
+  // tiles, and the time the draw took to upload and composite them. Page
+  // faults are those of the compositor thread between presents, which
+  // include rasterising the frame.
+  uint64_t upload_bytes_;
+  base::TimeDelta pack_time_;
+  base::TimeDelta upload_time_;
+  long last_minor_faults_;
+  uint64_t frame_faults_;
+  // Set until the first frame on a new surface reported its faults.
+  bool report_first_frame_faults_;
+  int presents_since_upload_report_;
+  base::WeakPtrFactory<EglOzoneCanvas> weak_factory_;
 };
 
-EglOzoneCanvas::EglOzoneCanvas()
+EglOzoneCanvas::EglOzoneCanvas(SurfaceFactoryEgl* factory, EglCursor* cursor)
+    : surface_pooled_(false),
+      factory_(factory),
+      cursor_(cursor),
+      opaque_(IsEnabled("OZONE_EGL_OPAQUE")),
+      gpu_canvas_(IsEnabled("OZONE_EGL_GPU_CANVAS")),
+      surface_gpu_(false),
+      presents_since_hash_report_(0),
+      upload_bytes_(0),
+      last_minor_faults_(GetThreadMinorFaults()),
+      frame_faults_(0),
+      report_first_frame_faults_(false),
+      presents_since_upload_report_(0),
+      weak_factory_(this)
 {
     memset(&userDate_,0,sizeof(userDate_));
+    factory_->AddCanvas(this);
+    if (cursor_) {
+      cursor_->SetRedrawCallback(base::Bind(&EglOzoneCanvas::RedrawCursor,
+                                            weak_factory_.GetWeakPtr()));
+    }
 }
 EglOzoneCanvas::~EglOzoneCanvas()
 {
+    if (cursor_)
+      cursor_->SetRedrawCallback(base::Closure());
+    factory_->RemoveCanvas(this);
+    // Skia deletes its GL objects with the context current, or forgets
+    // them if the context is already gone.
+    if (gr_context_) {
+      if (!ozone_egl_makecurrent())
+        gr_context_->abandonContext();
+      surface_.clear();
+      gr_context_.clear();
+    }
     ozone_egl_textureShutDown (&userDate_);
 }
 
+skia::RefPtr<SkSurface> EglOzoneCanvas::GetSurface()
+{
+    // A GPU canvas draws into its texture, so it needs it back before the
+    // compositor draws rather than at the present.
+    if (factory_->IsSuspended() && userDate_.renderTarget &&
+        !factory_->EnsureResumed())
+      FallBackToRaster();
+
+    // Dropped by Suspend(); the compositor repaints the whole viewport when
+    // the window becomes visible again.
+    if (!surface_ && userDate_.width && userDate_.height) {
+      if (userDate_.renderTarget) {
+        surface_ = CreateGpuSurface();
+        if (!surface_)
+          FallBackToRaster();
+      }
+      surface_gpu_ = surface_.get() != NULL;
+      surface_pooled_ = false;
+      if (!surface_) {
+        SkImageInfo info = SkImageInfo::Make(
+            userDate_.width, userDate_.height, kN32_SkColorType,
+            opaque_ ? kOpaque_SkAlphaType : kPremul_SkAlphaType);
+        surface_ = EglRasterPool::GetInstance()->CreateSurface(info);
+        surface_pooled_ = surface_.get() != NULL;
+        if (!surface_)
+          surface_ = skia::AdoptRef(SkSurface::NewRaster(info));
+        // The pool's prefault is not the first frame's doing.
+        last_minor_faults_ = GetThreadMinorFaults();
+        report_first_frame_faults_ = true;
+      }
+    }
+    if (surface_gpu_) {
+      // Other canvases and the present pass share the context and leave
+      // their own GL state behind.
+      ozone_egl_makecurrent();
+      gr_context_->resetContext();
+    }
+    return surface_;
+}
+
+void EglOzoneCanvas::Resume()
+{
+    // Canvases sized while suspended have had no textures yet.
+    if (userDate_.width && userDate_.height)
+      ozone_egl_textureInit(&userDate_);
+}
+
+skia::RefPtr<SkSurface> EglOzoneCanvas::CreateGpuSurface()
+{
+    if (!gr_context_ && gpu_canvas_) {
+      skia::RefPtr<const GrGLInterface> interface;
+      if (ozone_egl_makecurrent())
+        interface = skia::AdoptRef(GrGLAssembleInterface(NULL, GetGLProc));
+      if (interface) {
+        gr_context_ = skia::AdoptRef(GrContext::Create(
+            kOpenGL_GrBackend,
+            reinterpret_cast<GrBackendContext>(interface.get())));
+      }
+      if (!gr_context_) {
+        LOG(WARNING) << "Skia cannot use the EGL context, rasterising the "
+                        "canvas on the CPU";
+        gpu_canvas_ = false;
+      }
+    }
+    if (!gr_context_ || !ozone_egl_makecurrent())
+      return skia::RefPtr<SkSurface>();
+
+    // Skia knows nothing of the texture or of what the present pass did to
+    // the context.
+    gr_context_->resetContext();
+    GrBackendTextureDesc desc;
+    desc.fFlags = kRenderTarget_GrBackendTextureFlag;
+    desc.fOrigin = kTopLeft_GrSurfaceOrigin;
+    desc.fWidth = userDate_.width;
+    desc.fHeight = userDate_.height;
+    desc.fConfig = kRGBA_8888_GrPixelConfig;
+    desc.fTextureHandle = userDate_.textureId;
+    skia::RefPtr<SkSurface> surface = skia::AdoptRef(
+        SkSurface::NewFromBackendTexture(gr_context_.get(), desc, NULL));
+    if (!surface)
+      LOG(WARNING) << "Cannot render into the canvas texture";
+    return surface;
+}
+
+void EglOzoneCanvas::ClearSurface()
+{
+    if (surface_gpu_)
+      ozone_egl_makecurrent();
+    surface_.clear();
+    surface_gpu_ = false;
+}
+
+void EglOzoneCanvas::FallBackToRaster()
+{
+    // The render target is a single RGBA texture; the raster path wants the
+    // usual tile grid.
+    bool suspended = factory_->IsSuspended();
+    if (!suspended)
+      ozone_egl_textureShutDown(&userDate_);
+    userDate_.renderTarget = 0;
+    if (!suspended)
+      ozone_egl_textureInit(&userDate_);
+}
+
+size_t EglOzoneCanvas::Suspend()
+{
+    // Skia's cached textures and buffers go too; the canvas texture is
+    // counted with the others.
+    if (gr_context_ && ozone_egl_makecurrent()) {
+      if (surface_gpu_)
+        surface_.clear();
+      gr_context_->freeGpuResources();
+    }
+    size_t bytes = ozone_egl_textureRelease(&userDate_);
+    // Pooled buffers are counted when the factory trims the pool.
+    if (surface_ && !surface_pooled_) {
+      SkImageInfo info;
+      size_t row_bytes;
+      if (surface_->peekPixels(&info, &row_bytes))
+        bytes += row_bytes * info.height();
+    }
+    surface_.clear();
+    surface_gpu_ = false;
+    tile_pool_.reset();
+    return bytes;
+}
+
+size_t EglOzoneCanvas::Trim()
+{
+    tile_pool_.reset();
+    size_t bytes = 0;
+    if (gr_context_ && ozone_egl_makecurrent()) {
+      gr_context_->getResourceCacheUsage(NULL, &bytes);
+      gr_context_->freeGpuResources();
+    }
+    return bytes + ozone_egl_textureTrim(&userDate_);
+}
+
+void EglOzoneCanvas::RedrawCursor()
+{
+    if (!userDate_.width || !userDate_.height || factory_->IsSuspended())
+      return;
+    userDate_.data = NULL;
+    ozone_egl_textureDraw(&userDate_);
+    ozone_egl_swap();
+    // Skia may still have drawing to flush for the frame in progress.
+    if (surface_gpu_)
+      gr_context_->resetContext();
+}
+
+gfx::Rect EglOzoneCanvas::GetTileDamage() const
+{
+    gfx::Rect damage;
+    for (int i = 0; i < userDate_.tileCols * userDate_.tileRows; i++) {
+      const ozone_egl_Tile& tile = userDate_.tiles[i];
+      if (tile.state != OZONE_EGL_TILE_CLEAN)
+        damage.Union(gfx::Rect(tile.x, tile.y, tile.width, tile.height));
+    }
+    return damage;
+}
+
+void EglOzoneCanvas::ReportHashStats()
+{
+    // Stats of tiles hashed ahead of the draw are folded in by the draw, so
+    // this reports up to the previous frame.
+    const ozone_egl_TileHashStats& stats = userDate_.hashStats;
+    TRACE_COUNTER2("ozone", "Egl.TileHash", "hash_us", stats.hashUsec,
+                   "saved_kb", stats.bytesSaved / 1024);
+    if (++presents_since_hash_report_ < kHashReportInterval)
+      return;
+    presents_since_hash_report_ = 0;
+    LOG(INFO) << "Tile hash: " << stats.tilesSkipped << "/"
+              << stats.tilesHashed << " damaged tiles unchanged, "
+              << stats.hashUsec / 1000 << " ms spent hashing "
+              << stats.bytesHashed / (1024 * 1024) << " MB, "
+              << stats.bytesSaved / (1024 * 1024)
+              << " MB of uploads avoided";
+}
+
+void EglOzoneCanvas::ReportUploadStats()
+{
+    long minor_faults = GetThreadMinorFaults();
+    uint64_t faults = minor_faults - last_minor_faults_;
+    last_minor_faults_ = minor_faults;
+    frame_faults_ += faults;
+    if (report_first_frame_faults_) {
+      // The first raster into fresh memory takes a fault per page unless
+      // the raster pool faulted it in already.
+      UMA_HISTOGRAM_COUNTS("Ozone.Egl.FirstFrameFaults", faults);
+      LOG(INFO) << "First frame on a new canvas took " << faults
+                << " page faults";
+      report_first_frame_faults_ = false;
+    }
+
+    uint64_t upload_us = upload_time_.InMicroseconds();
+    TRACE_COUNTER2("ozone", "Egl.Upload", "mb_per_s",
+                   upload_us ? upload_bytes_ / upload_us : 0, "faults",
+                   faults);
+    if (++presents_since_upload_report_ < kUploadReportInterval)
+      return;
+
+    EglRasterPool::Stats pool;
+    EglRasterPool::GetInstance()->GetStats(&pool);
+    LOG(INFO) << "Canvas upload: " << upload_bytes_ / (1024 * 1024)
+              << " MB in " << upload_us / 1000 << " ms ("
+              << (upload_us ? upload_bytes_ / upload_us : 0) << " MB/s), "
+              << pack_time_.InMilliseconds() << " ms packing, "
+              << frame_faults_ / presents_since_upload_report_
+              << " page faults per frame; raster pool: " << pool.allocated
+              << " mapped, " << pool.reused << " reused, "
+              << pool.prefaulted_pages << " pages prefaulted, "
+              << pool.huge_bytes / (1024 * 1024) << " MB huge pages";
+    presents_since_upload_report_ = 0;
+    upload_bytes_ = 0;
+    pack_time_ = base::TimeDelta();
+    upload_time_ = base::TimeDelta();
+    frame_faults_ = 0;
+}
+
 void EglOzoneCanvas::ResizeCanvas(const gfx::Size& viewport_size)
 {  
   if(userDate_.width == viewport_size.width() && userDate_.height==viewport_size.height())
   {
       return;
   }
-  else if(userDate_.width != 0 && userDate_.height !=0)
+  ClearSurface();
+  if(userDate_.width != 0 && userDate_.height !=0 &&
+     !factory_->IsSuspended())
   {
       ozone_egl_textureShutDown (&userDate_);
   }
-  surface_ = skia::AdoptRef(SkSurface::NewRaster(
-        SkImageInfo::Make(viewport_size.width(),
-                                   viewport_size.height(),
-                                   kN32_SkColorType,
-                                   kPremul_SkAlphaType)));
   userDate_.width = viewport_size.width();
   userDate_.height = viewport_size.height();
   userDate_.colorType = GL_BGRA_EXT;
-  ozone_egl_textureInit ( &userDate_);
+  userDate_.opaque = opaque_;
+  userDate_.renderTarget = gpu_canvas_;
+  // A suspended canvas gets its textures with the next frame. A GPU
+  // surface wraps the canvas texture, so that comes first.
+  if (!factory_->IsSuspended()) {
+    ozone_egl_textureInit ( &userDate_);
+    GetSurface();
+  }
 }
 
 void EglOzoneCanvas::PresentCanvas(const gfx::Rect& damage)
 { 
+    if (factory_->IsSuspended() && !factory_->EnsureResumed())
+      return;
+
+    gfx::Rect effective_damage = damage;
+    if (surface_gpu_) {
+      // Skia rendered into the canvas texture; the draw only composites it.
+      ozone_egl_makecurrent();
+      surface_->getCanvas()->flush();
+      userDate_.data = NULL;
+      ozone_egl_textureDraw(&userDate_);
+    } else if (!UploadCanvas(damage, &effective_damage)) {
+      return;
+    }
+
+    // Input that arrived before this damaged frame shows up in it.
+    uint32_t token = 0;
+    if (!effective_damage.IsEmpty()) {
+      token = EglLatencyTracker::GetInstance()->OnPresent(
+          base::TimeTicks::Now());
+    }
+    ozone_egl_swapWithCallback(
+        token ? OnCanvasScanout : NULL,
+        reinterpret_cast<void*>(static_cast<uintptr_t>(token)));
+
+    uint32_t switches, skipped;
+    ozone_egl_getMakeCurrentStats(&switches, &skipped);
+    TRACE_COUNTER2("ozone", "Egl.MakeCurrent", "switches", switches,
+                   "skipped", skipped);
+}
+
+bool EglOzoneCanvas::UploadCanvas(const gfx::Rect& damage,
+                                  gfx::Rect* effective_damage)
+{
     SkImageInfo info;
     size_t row_bytes;
     userDate_.data = (char *) surface_->peekPixels(&info, &row_bytes);
+    userDate_.stride = row_bytes;
+    ozone_egl_textureDamage(&userDate_, damage.x(), damage.y(),
+                            damage.width(), damage.height());
+
+    // Copy (and, with OZONE_EGL_TILE_HASH, hash) damaged tiles out of the
+    // canvas in parallel; the draw then only uploads them.
+    base::TimeTicks pack_start = base::TimeTicks::Now();
+    std::vector<int> damaged_tiles;
+    for (int i = 0; i < userDate_.tileCols * userDate_.tileRows; i++) {
+      if (userDate_.tiles[i].state == OZONE_EGL_TILE_DAMAGED)
+        damaged_tiles.push_back(i);
+    }
+    if (damaged_tiles.size() > 1) {
+      if (!tile_pool_)
+        tile_pool_.reset(new EglTilePool(kMaxTileThreads));
+      tile_pool_->ParallelFor(
+          damaged_tiles.size(),
+          base::Bind(&PackTile, &userDate_, &damaged_tiles));
+    } else if (damaged_tiles.size() == 1) {
+      ozone_egl_texturePackTile(&userDate_, damaged_tiles[0]);
+    }
+    pack_time_ += base::TimeTicks::Now() - pack_start;
+
+    // Chromium often reports the whole viewport; keep only the tiles whose
+    // content really changed, and skip the frame if none did.
+    if (userDate_.hashTiles) {
+      *effective_damage = GetTileDamage();
+      ReportHashStats();
+      if (!damaged_tiles.empty() && effective_damage->IsEmpty())
+        return false;
+    }
+    base::TimeTicks upload_start = base::TimeTicks::Now();
+    uint64_t uploaded = userDate_.uploadBytes;
     ozone_egl_textureDraw(&userDate_);
-    ozone_egl_swap();
+    upload_bytes_ += userDate_.uploadBytes - uploaded;
+    upload_time_ += base::TimeTicks::Now() - upload_start;
+    ReportUploadStats();
+    return true;
 }
 
 
 class OzoneEgl : public ui::SurfaceOzoneEGL {
  public:
-  OzoneEgl(gfx::AcceleratedWidget window_id){
+  OzoneEgl(gfx::AcceleratedWidget window_id,
+           EglGpuPlatformSupport* gpu_platform_support)
+      : gpu_platform_support_(gpu_platform_support) {
      native_window_ = window_id;
   }
   ~OzoneEgl() override {
@@ -106,12 +606,13 @@ class OzoneEgl : public ui::SurfaceOzoneEGL {
 
   bool OnSwapBuffers() override
   {
-    return true;
+    // Still report when the frame reached the screen.
+    return Present(SwapCompletionCallback());
   }
 
   bool OnSwapBuffersAsync(const SwapCompletionCallback& callback) override
-  { 
-    return true; 
+  {
+    return Present(callback);
   }
 
   bool ResizeNativeWindow(const gfx::Size& viewport_size) override {
@@ -120,50 +621,56 @@ class OzoneEgl : public ui::SurfaceOzoneEGL {
 
 
   scoped_ptr<gfx::VSyncProvider> CreateVSyncProvider() override {
-    return scoped_ptr<gfx::VSyncProvider>();
+    return make_scoped_ptr<gfx::VSyncProvider>(new EglVSyncProvider());
   }
 
  private:
+  bool Present(const SwapCompletionCallback& callback)
+  {
+    if (callback.is_null() && !gpu_platform_support_)
+      return ozone_egl_present(NULL, NULL) == OZONE_EGL_SUCCESS;
+
+    EglSwapCompletion* completion = new EglSwapCompletion;
+    completion->task_runner = base::ThreadTaskRunnerHandle::Get();
+    completion->callback = callback;
+    completion->widget = native_window_;
+    completion->gpu_platform_support = gpu_platform_support_;
+    if (ozone_egl_present(OnFlipComplete, completion) != OZONE_EGL_SUCCESS) {
+      delete completion;
+      return false;
+    }
+    return true;
+  }
+
   intptr_t native_window_;
+  EglGpuPlatformSupport* gpu_platform_support_;
 };
 
 
 
-SurfaceFactoryEgl::SurfaceFactoryEgl():init_(false)
+SurfaceFactoryEgl::SurfaceFactoryEgl()
+    : init_(false), suspended_(false), cursor_(NULL),
+      gpu_platform_support_(NULL)
 {
 
 }
 
 SurfaceFactoryEgl::~SurfaceFactoryEgl()
 { 
+    ozone_egl_captureStop();
     DestroySingleWindow(); 
 }
   
-EGLint g_width;
-EGLint g_height;
 bool SurfaceFactoryEgl::CreateSingleWindow()
 {
-  struct fb_var_screeninfo fb_var;
-
-  int fb_fd =  open("/dev/fb0", O_RDWR);
-
   if(init_)
   {
      return true;
   }
 
-  if (ioctl(fb_fd, FBIOGET_VSCREENINFO, &fb_var)) {
-        LOG(FATAL) << "failed to get fb var info errno: " << errno;
-        g_width = 640;
-	g_height = 480;
-  } else {
-    g_width = fb_var.xres;
-    g_height = fb_var.yres;
-  }
-
- close(fb_fd);
-
- if(!ozone_egl_setup(0, 0, g_width, g_height))
+ // The backend detects the display geometry itself; EglNativeDisplayDelegate
+ // reports it.
+ if(!ozone_egl_setup(0, 0, 0, 0))
   {
       LOG(FATAL) << "CreateSingleWindow";
       return false;
@@ -177,6 +684,148 @@ void SurfaceFactoryEgl::DestroySingleWindow() {
   init_ = false;
 }
 
+void SurfaceFactoryEgl::Suspend() {
+  // The window hides on the UI thread while the canvases or GL surfaces
+  // may be presenting on theirs. The factory lives as long as the platform.
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner =
+      GetPresentTaskRunner();
+  if (task_runner && !task_runner->BelongsToCurrentThread()) {
+    task_runner->PostTask(FROM_HERE, base::Bind(&SurfaceFactoryEgl::Suspend,
+                                                base::Unretained(this)));
+    return;
+  }
+  if (suspended_ || !init_)
+    return;
+  uint64_t bytes = 0;
+  for (EglOzoneCanvas* canvas : canvases_)
+    bytes += canvas->Suspend();
+  bytes += EglRasterPool::GetInstance()->Trim();
+  bytes += ozone_egl_suspend();
+  suspended_ = true;
+
+  LOG(INFO) << "Suspended EGL output, reclaimed " << bytes / 1024 << " KB";
+  UMA_HISTOGRAM_MEMORY_KB("Ozone.Egl.SuspendReclaimedKB", bytes / 1024);
+}
+
+void SurfaceFactoryEgl::Resume() {
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner =
+      GetPresentTaskRunner();
+  if (task_runner && !task_runner->BelongsToCurrentThread()) {
+    task_runner->PostTask(FROM_HERE, base::Bind(&SurfaceFactoryEgl::Resume,
+                                                base::Unretained(this)));
+    return;
+  }
+  EnsureResumed();
+}
+
+bool SurfaceFactoryEgl::EnsureResumed() {
+  if (!suspended_)
+    return true;
+  if (!ozone_egl_resume())
+    return false;
+  suspended_ = false;
+  // Their surfaces come back with the next frame.
+  for (EglOzoneCanvas* canvas : canvases_)
+    canvas->Resume();
+  return true;
+}
+
+void SurfaceFactoryEgl::SetPresentTaskRunner() {
+  if (!base::ThreadTaskRunnerHandle::IsSet())
+    return;
+  base::AutoLock lock(present_task_runner_lock_);
+  present_task_runner_ = base::ThreadTaskRunnerHandle::Get();
+}
+
+scoped_refptr<base::SingleThreadTaskRunner>
+SurfaceFactoryEgl::GetPresentTaskRunner() {
+  base::AutoLock lock(present_task_runner_lock_);
+  return present_task_runner_;
+}
+
+void SurfaceFactoryEgl::AddCanvas(EglOzoneCanvas* canvas) {
+  canvases_.insert(canvas);
+  SetPresentTaskRunner();
+  // Created lazily: the factory may be built before the thread has a
+  // message loop.
+  if (!memory_pressure_listener_) {
+    memory_pressure_listener_.reset(new base::MemoryPressureListener(
+        base::Bind(&SurfaceFactoryEgl::OnMemoryPressure,
+                   base::Unretained(this))));
+  }
+}
+
+void SurfaceFactoryEgl::RemoveCanvas(EglOzoneCanvas* canvas) {
+  canvases_.erase(canvas);
+}
+
+void SurfaceFactoryEgl::OnMemoryPressure(
+    base::MemoryPressureListener::MemoryPressureLevel level) {
+  // A hidden window already gave everything back.
+  if (suspended_)
+    return;
+  uint64_t bytes = 0;
+  for (EglOzoneCanvas* canvas : canvases_)
+    bytes += canvas->Trim();
+  bytes += EglRasterPool::GetInstance()->Trim();
+  LOG(INFO) << "Trimmed EGL canvases under memory pressure, reclaimed "
+            << bytes / 1024 << " KB";
+  UMA_HISTOGRAM_MEMORY_KB("Ozone.Egl.TrimReclaimedKB", bytes / 1024);
+}
+
+void SurfaceFactoryEgl::StartCapture(const gfx::Rect& region,
+                                     const gfx::Size& size,
+                                     bool damage_only,
+                                     base::TimeDelta min_interval,
+                                     const CaptureCallback& callback) {
+  ozone_egl_CaptureParams params;
+  memset(&params, 0, sizeof(params));
+  params.x = region.x();
+  params.y = region.y();
+  params.width = region.width();
+  params.height = region.height();
+  params.scaledWidth = size.width();
+  params.scaledHeight = size.height();
+  params.damageOnly = damage_only;
+  params.intervalUsec = min_interval.InMicroseconds();
+
+  // Stopping takes the capture lock, which frames are delivered under, so
+  // no OnCaptureFrame() reads the callback while it changes.
+  ozone_egl_captureStop();
+  capture_callback_ = callback;
+  if (!ozone_egl_captureStart(&params, &SurfaceFactoryEgl::OnCaptureFrame,
+                              this)) {
+    LOG(ERROR) << "Invalid capture parameters";
+    capture_callback_.Reset();
+  }
+}
+
+void SurfaceFactoryEgl::StopCapture() {
+  ozone_egl_captureStop();
+  capture_callback_.Reset();
+}
+
+// static
+void SurfaceFactoryEgl::OnCaptureFrame(void* data, const uint8_t* pixels,
+                                       int stride, int x, int y,
+                                       int width, int height, uint64_t usec) {
+  SurfaceFactoryEgl* factory = static_cast<SurfaceFactoryEgl*>(data);
+  // The callback may restart the capture, which replaces the member.
+  CaptureCallback callback = factory->capture_callback_;
+  if (callback.is_null())
+    return;
+
+  // No copy: the bitmap points into the readback buffer.
+  SkBitmap frame;
+  frame.installPixels(SkImageInfo::Make(width, height, kRGBA_8888_SkColorType,
+                                        kPremul_SkAlphaType),
+                      const_cast<uint8_t*>(pixels), stride);
+  TRACE_EVENT1("ozone", "SurfaceFactoryEgl::OnCaptureFrame", "bytes",
+               stride * height);
+  callback.Run(frame, gfx::Rect(x, y, width, height),
+               base::TimeTicks::FromInternalValue(usec));
+}
+
 intptr_t SurfaceFactoryEgl::GetNativeDisplay() {
   return (intptr_t)ozone_egl_getNativedisp();
 }
@@ -194,8 +843,9 @@ intptr_t SurfaceFactoryEgl::GetNativeWindow(){
 scoped_ptr<ui::SurfaceOzoneEGL>
 SurfaceFactoryEgl::CreateEGLSurfaceForWidget(
     gfx::AcceleratedWidget widget) {
+  SetPresentTaskRunner();
   return make_scoped_ptr<ui::SurfaceOzoneEGL>(
-      new OzoneEgl(widget));
+      new OzoneEgl(widget, gpu_platform_support_));
 }
 
 bool SurfaceFactoryEgl::LoadEGLGLES2Bindings(
@@ -212,7 +862,8 @@ const int32* SurfaceFactoryEgl::GetEGLSurfaceProperties(
 
 scoped_ptr<ui::SurfaceOzoneCanvas> SurfaceFactoryEgl::CreateCanvasForWidget(
       gfx::AcceleratedWidget widget){
-  return make_scoped_ptr<SurfaceOzoneCanvas>(new EglOzoneCanvas());
+  return make_scoped_ptr<SurfaceOzoneCanvas>(
+      new EglOzoneCanvas(this, cursor_));
 }
 
 }  // namespace ui
@@ -5,17 +5,33 @@
 #ifndef UI_OZONE_PLATFORM_SURFACE_FACTORY_H_
 #define UI_OZONE_PLATFORM_SURFACE_FACTORY_H_
 
+#include <set>
+
+#include "base/callback.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
 #include "ui/ozone/public/surface_factory_ozone.h"
 #include "ui/ozone/platform/egl/egl_window.h"
 
 
+class SkBitmap;
+
 namespace gfx {
+class Rect;
+class Size;
 class SurfaceOzone;
 }
 
 namespace ui {
 
+class EglCursor;
+class EglGpuPlatformSupport;
+class EglOzoneCanvas;
+
 class SurfaceFactoryEgl : public ui::SurfaceFactoryOzone {
  public:
   SurfaceFactoryEgl();
@@ -39,8 +55,74 @@ class SurfaceFactoryEgl : public ui::SurfaceFactoryOzone {
       gfx::AcceleratedWidget widget) override;
   intptr_t GetNativeWindow();
 
+  // Canvases composite the software cursor of |cursor|.
+  void SetCursor(EglCursor* cursor) { cursor_ = cursor; }
+
+  // GL surfaces created afterwards send presentation feedback through
+  // |gpu_platform_support|.
+  void SetGpuPlatformSupport(EglGpuPlatformSupport* gpu_platform_support) {
+    gpu_platform_support_ = gpu_platform_support;
+  }
+
+  // Releases the canvas textures, program and raster surfaces and the EGL
+  // window surface while nothing is shown. Only sizes and the program
+  // binary are kept; the next frame after Resume() recreates the rest.
+  // Both may be called from any thread and run on the thread that
+  // presents.
+  void Suspend();
+  void Resume();
+
+  // On the thread that presents. EnsureResumed() brings the output back
+  // for a frame drawn while suspended and fails if the EGL surface cannot
+  // be recreated.
+  bool IsSuspended() const { return suspended_; }
+  bool EnsureResumed();
+
+  // |frame| covers |update| of the scaled capture and wraps the GL mapping
+  // where there is one, so it is only valid during the call; copy or
+  // encode it before returning.
+  typedef base::Callback<void(const SkBitmap& frame,
+                              const gfx::Rect& update,
+                              base::TimeTicks swap_time)> CaptureCallback;
+
+  // Reads back canvas frames after they are presented, without stalling
+  // the swap. |region| is in window pixels (empty for the whole window) and
+  // is scaled to |size| on the GPU (empty keeps it). With |damage_only|
+  // only what changed since the last captured frame is read back. At most
+  // one frame per |min_interval| is captured. |callback| runs on the
+  // thread that presents.
+  void StartCapture(const gfx::Rect& region,
+                    const gfx::Size& size,
+                    bool damage_only,
+                    base::TimeDelta min_interval,
+                    const CaptureCallback& callback);
+  void StopCapture();
+
+  // Called by EglOzoneCanvas.
+  void AddCanvas(EglOzoneCanvas* canvas);
+  void RemoveCanvas(EglOzoneCanvas* canvas);
+
  private:
+    void OnMemoryPressure(
+        base::MemoryPressureListener::MemoryPressureLevel level);
+    // Remembers the current thread as the one that presents.
+    void SetPresentTaskRunner();
+    scoped_refptr<base::SingleThreadTaskRunner> GetPresentTaskRunner();
+    static void OnCaptureFrame(void* data, const uint8_t* pixels, int stride,
+                               int x, int y, int width, int height,
+                               uint64_t usec);
+
     bool init_;
+    bool suspended_;
+    EglCursor* cursor_;
+    EglGpuPlatformSupport* gpu_platform_support_;
+    std::set<EglOzoneCanvas*> canvases_;
+    scoped_ptr<base::MemoryPressureListener> memory_pressure_listener_;
+    // Read by OnCaptureFrame() on the presenting thread with the wrapper's
+    // capture lock held; only written while the capture is stopped.
+    CaptureCallback capture_callback_;
+    base::Lock present_task_runner_lock_;
+    scoped_refptr<base::SingleThreadTaskRunner> present_task_runner_;
 };
 
 }  // namespace ui
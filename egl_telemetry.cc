@@ -0,0 +1,177 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "egl_backend.h"
+#include "egl_telemetry.h"
+#include "base/logging.h"
+
+// Resident memory is read from procfs at most this often.
+#define OZONE_EGL_TELEMETRY_RSS_USEC 1000000
+
+static ozone_egl_TelemetrySegment* g_Segment;
+static pthread_once_t g_SegmentOnce = PTHREAD_ONCE_INIT;
+static char g_SegmentName[32];
+
+// Summed over the frame from the drawing threads
+static uint64_t g_UploadBytes;
+static uint64_t g_DrawUsec;
+
+// Owned by the writer, i.e. used with the wrapper lock held
+static uint64_t g_LastFrameUsec;
+static uint64_t g_LastRssUsec;
+static uint32_t g_RssKb;
+
+static void ozone_egl_telemetryUnlink()
+{
+    shm_unlink(g_SegmentName);
+}
+
+static void ozone_egl_telemetryCreate()
+{
+    const char* env = getenv("OZONE_EGL_TELEMETRY");
+    ozone_egl_TelemetrySegment* segment;
+    int fd;
+
+    if (env && !strcmp(env, "0"))
+        return;
+
+    snprintf(g_SegmentName, sizeof(g_SegmentName), "%s%d",
+             OZONE_EGL_TELEMETRY_PREFIX, (int)getpid());
+    // Whatever has our pid in its name was left behind by a process that
+    // crashed; a fresh segment never inherits its contents or its owner.
+    shm_unlink(g_SegmentName);
+    fd = shm_open(g_SegmentName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        PLOG(WARNING) << "No telemetry segment " << g_SegmentName;
+        return;
+    }
+    if (ftruncate(fd, sizeof(*segment)))
+    {
+        PLOG(WARNING) << "No telemetry segment " << g_SegmentName;
+        close(fd);
+        shm_unlink(g_SegmentName);
+        return;
+    }
+    segment = static_cast<ozone_egl_TelemetrySegment*>(
+        mmap(NULL, sizeof(*segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    if (segment == MAP_FAILED)
+    {
+        PLOG(WARNING) << "No telemetry segment " << g_SegmentName;
+        shm_unlink(g_SegmentName);
+        return;
+    }
+
+    // The segment is zero filled; readers check the magic last.
+    segment->version = OZONE_EGL_TELEMETRY_VERSION;
+    segment->recordSize = sizeof(ozone_egl_TelemetryRecord);
+    segment->recordCount = OZONE_EGL_TELEMETRY_RECORDS;
+    segment->pid = getpid();
+    segment->startTicks = ozone_egl_telemetryStartTicks(segment->pid);
+    segment->startUsec = ozone_egl_nowUsec();
+    __atomic_store_n(&segment->magic, OZONE_EGL_TELEMETRY_MAGIC,
+                     __ATOMIC_RELEASE);
+    // Crashed processes leave their segment behind; the CLI removes those.
+    atexit(ozone_egl_telemetryUnlink);
+    g_Segment = segment;
+}
+
+static ozone_egl_TelemetrySegment* ozone_egl_telemetrySegment()
+{
+    pthread_once(&g_SegmentOnce, ozone_egl_telemetryCreate);
+    return g_Segment;
+}
+
+static uint32_t ozone_egl_telemetryRssKb()
+{
+    long pages = 0;
+    long resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+
+    if (!file)
+        return 0;
+    if (fscanf(file, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(file);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void ozone_egl_telemetryUpload(uint64_t bytes)
+{
+    if (ozone_egl_telemetrySegment())
+        __atomic_fetch_add(&g_UploadBytes, bytes, __ATOMIC_RELAXED);
+}
+
+void ozone_egl_telemetryDraw(uint64_t usec)
+{
+    if (ozone_egl_telemetrySegment())
+        __atomic_fetch_add(&g_DrawUsec, usec, __ATOMIC_RELAXED);
+}
+
+void ozone_egl_telemetryInfo(const char* backend, int width, int height,
+                             int transform, uint64_t refresh_interval_usec,
+                             uint32_t state)
+{
+    ozone_egl_TelemetrySegment* segment = ozone_egl_telemetrySegment();
+    ozone_egl_TelemetryInfo* info;
+    uint32_t sequence;
+
+    if (!segment)
+        return;
+
+    info = &segment->info;
+    sequence = info->sequence;
+    __atomic_store_n(&info->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset(info->backend, 0, sizeof(info->backend));
+    if (backend)
+        strncpy(info->backend, backend, sizeof(info->backend) - 1);
+    info->width = width;
+    info->height = height;
+    info->transform = transform;
+    info->refreshIntervalUsec = refresh_interval_usec;
+    info->state = state;
+    __atomic_store_n(&info->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void ozone_egl_telemetryFrame(uint64_t usec, uint64_t swap_usec,
+                              uint32_t make_current_switches)
+{
+    ozone_egl_TelemetrySegment* segment = ozone_egl_telemetrySegment();
+    ozone_egl_TelemetryRecord* record;
+    uint64_t frame;
+
+    if (!segment)
+        return;
+
+    if (!g_LastRssUsec || usec - g_LastRssUsec >= OZONE_EGL_TELEMETRY_RSS_USEC)
+    {
+        g_RssKb = ozone_egl_telemetryRssKb();
+        g_LastRssUsec = usec;
+    }
+
+    frame = segment->head;
+    record = &segment->records[frame % OZONE_EGL_TELEMETRY_RECORDS];
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->usec = usec;
+    record->frameUsec = g_LastFrameUsec ? usec - g_LastFrameUsec : 0;
+    record->drawUsec = __atomic_exchange_n(&g_DrawUsec, 0, __ATOMIC_RELAXED);
+    record->swapUsec = swap_usec;
+    record->uploadBytes =
+        __atomic_exchange_n(&g_UploadBytes, 0, __ATOMIC_RELAXED);
+    record->makeCurrentSwitches = make_current_switches;
+    record->rssKb = g_RssKb;
+    __atomic_store_n(&record->sequence, frame + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&segment->head, frame + 1, __ATOMIC_RELEASE);
+    g_LastFrameUsec = usec;
+}
@@ -0,0 +1,124 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef UI_OZONE_EGL_TELEMETRY_H_
+#define UI_OZONE_EGL_TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Live frame statistics in a POSIX shared memory segment, always on unless
+// OZONE_EGL_TELEMETRY=0, for ozone_egl_telemetry (egl_telemetry_cli.cc) to
+// attach to on a running device. Each process that presents publishes its
+// own segment, named OZONE_EGL_TELEMETRY_PREFIX followed by its pid and
+// readable only by its user.
+//
+// The wrapper is the only writer, under its lock. Frames go into a ring
+// that overwrites the oldest record and never waits for readers; a reader
+// copies a record and keeps it if its sequence number was the same before
+// and after the copy.
+#define OZONE_EGL_TELEMETRY_PREFIX "/ozone-egl."
+#define OZONE_EGL_TELEMETRY_MAGIC 0x4f5a5445
+#define OZONE_EGL_TELEMETRY_VERSION 2
+// A power of two; at 60 Hz about 17 seconds of frames
+#define OZONE_EGL_TELEMETRY_RECORDS 1024
+
+// ozone_egl_TelemetryInfo::state
+#define OZONE_EGL_TELEMETRY_SUSPENDED    0x1
+#define OZONE_EGL_TELEMETRY_FRONT_BUFFER 0x2
+#define OZONE_EGL_TELEMETRY_HW_CURSOR    0x4
+
+typedef struct
+{
+   // Index + 1 of the frame held, 0 while the record is being written
+   uint64_t sequence;
+   // CLOCK_MONOTONIC time of the present
+   uint64_t usec;
+   // Since the previous present
+   uint32_t frameUsec;
+   // Canvas upload and draw, and the swap plus the backend's present,
+   // which is where the wrapper waits for the display
+   uint32_t drawUsec;
+   uint32_t swapUsec;
+   uint32_t uploadBytes;
+   // eglMakeCurrent calls the frame made
+   uint32_t makeCurrentSwitches;
+   // Resident memory of the process, sampled about once a second
+   uint32_t rssKb;
+} ozone_egl_TelemetryRecord;
+
+// What the wrapper drives, rewritten when that changes.
+typedef struct
+{
+   // Odd while being written
+   uint32_t sequence;
+   // OZONE_EGL_TELEMETRY_*
+   uint32_t state;
+   // Empty while no backend is up
+   char backend[16];
+   int32_t width;
+   int32_t height;
+   // OZONE_EGL_TRANSFORM_*
+   int32_t transform;
+   uint32_t refreshIntervalUsec;
+} ozone_egl_TelemetryInfo;
+
+typedef struct
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t recordSize;
+   uint32_t recordCount;
+   int32_t pid;
+   // Low bits of ozone_egl_telemetryStartTicks(pid), which tell a segment
+   // left behind by a crash from one of a new process with the same pid
+   uint32_t startTicks;
+   uint64_t startUsec;
+   ozone_egl_TelemetryInfo info;
+   // Frames published so far; frame n is in records[n % recordCount]
+   uint64_t head;
+   ozone_egl_TelemetryRecord records[OZONE_EGL_TELEMETRY_RECORDS];
+} ozone_egl_TelemetrySegment;
+
+// When |pid| started, in clock ticks after boot, or 0 if it is gone.
+static inline uint32_t ozone_egl_telemetryStartTicks(int pid)
+{
+   char path[32];
+   char stat[512];
+   const char* field;
+   size_t length;
+   int i;
+   FILE* file;
+
+   snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+   file = fopen(path, "r");
+   if (!file)
+      return 0;
+   length = fread(stat, 1, sizeof(stat) - 1, file);
+   fclose(file);
+   stat[length] = '\0';
+
+   // The command name may hold spaces; the start time is field 22.
+   field = strrchr(stat, ')');
+   for (i = 2; i < 22 && field; i++)
+      field = strchr(field + 1, ' ');
+   return field ? (uint32_t)strtoull(field + 1, NULL, 10) : 0;
+}
+
+// Called by the wrapper. The first call creates the segment; they do
+// nothing if it is disabled or could not be created.
+
+// Adds to the current frame; any thread.
+void ozone_egl_telemetryUpload(uint64_t bytes);
+void ozone_egl_telemetryDraw(uint64_t usec);
+
+// With the wrapper lock held. |backend| is NULL once torn down.
+void ozone_egl_telemetryInfo(const char* backend, int width, int height,
+                             int transform, uint64_t refresh_interval_usec,
+                             uint32_t state);
+void ozone_egl_telemetryFrame(uint64_t usec, uint64_t swap_usec,
+                              uint32_t make_current_switches);
+
+#endif
@@ -0,0 +1,341 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Attaches to the telemetry segment a running browser or GPU process
+// publishes (see egl_telemetry.h) and prints frame rate, percentiles of the
+// frame, draw and swap times, upload bandwidth, resident memory and the
+// backend state, once per --interval. Needs nothing from the process but
+// its segment, which only its user (or root) can read, so it can be pointed
+// at a unit in the field:
+//
+//   ozone_egl_telemetry            attach to the only presenting process
+//   ozone_egl_telemetry --list     list presenting processes
+//   ozone_egl_telemetry --pid=1234 --interval=5 --count=12
+//
+// The first report covers the frames still in the ring, up to the last
+// OZONE_EGL_TELEMETRY_RECORDS. Segments left behind by processes that
+// crashed are removed on the way.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "egl_telemetry.h"
+
+namespace {
+
+// Where shm_open() puts segments on Linux.
+const char kShmDirectory[] = "/dev/shm";
+
+struct Options {
+  int pid;
+  int interval_s;
+  int count;
+  bool list;
+};
+
+bool ParseOption(const char* arg, const char* name, long* value) {
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) || arg[length] != '=')
+    return false;
+  *value = atol(arg + length + 1);
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  options->pid = 0;
+  options->interval_s = 1;
+  options->count = 0;
+  options->list = false;
+
+  for (int i = 1; i < argc; i++) {
+    long value;
+    if (ParseOption(argv[i], "--pid", &value))
+      options->pid = value;
+    else if (ParseOption(argv[i], "--interval", &value))
+      options->interval_s = value;
+    else if (ParseOption(argv[i], "--count", &value))
+      options->count = value;
+    else if (!strcmp(argv[i], "--list"))
+      options->list = true;
+    else
+      return false;
+  }
+  return options->interval_s > 0 && options->count >= 0;
+}
+
+bool IsRunning(int pid) {
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+void GetSegmentName(int pid, char* name, size_t size) {
+  snprintf(name, size, "%s%d", OZONE_EGL_TELEMETRY_PREFIX, pid);
+}
+
+// Removes the segment of a process that crashed. Fails quietly for those of
+// other users, which only they or root may remove.
+void Reap(int pid) {
+  char name[32];
+  GetSegmentName(pid, name, sizeof(name));
+  shm_unlink(name);
+}
+
+// False once the process exited, even if its pid was reused since.
+bool IsPublishing(const ozone_egl_TelemetrySegment* segment) {
+  uint32_t start_ticks = ozone_egl_telemetryStartTicks(segment->pid);
+  return start_ticks && start_ticks == segment->startTicks;
+}
+
+const ozone_egl_TelemetrySegment* Attach(int pid) {
+  char name[32];
+  GetSegmentName(pid, name, sizeof(name));
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open %s: %s\n", name, strerror(errno));
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < (off_t)sizeof(ozone_egl_TelemetrySegment)) {
+    fprintf(stderr, "%s is not a telemetry segment\n", name);
+    close(fd);
+    return NULL;
+  }
+  void* mapping = mmap(NULL, sizeof(ozone_egl_TelemetrySegment), PROT_READ,
+                       MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s: %s\n", name, strerror(errno));
+    return NULL;
+  }
+
+  const ozone_egl_TelemetrySegment* segment =
+      static_cast<const ozone_egl_TelemetrySegment*>(mapping);
+  if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) !=
+          OZONE_EGL_TELEMETRY_MAGIC ||
+      segment->version != OZONE_EGL_TELEMETRY_VERSION ||
+      segment->recordSize != sizeof(ozone_egl_TelemetryRecord) ||
+      segment->recordCount != OZONE_EGL_TELEMETRY_RECORDS) {
+    fprintf(stderr, "%s has an unknown layout\n", name);
+    munmap(mapping, sizeof(ozone_egl_TelemetrySegment));
+    return NULL;
+  }
+  if (!IsPublishing(segment)) {
+    fprintf(stderr, "%s was left behind by a process that exited\n", name);
+    munmap(mapping, sizeof(ozone_egl_TelemetrySegment));
+    Reap(pid);
+    return NULL;
+  }
+  return segment;
+}
+
+// The segments of the live processes that publish, by pid.
+std::vector<const ozone_egl_TelemetrySegment*> FindProcesses() {
+  std::vector<int> pids;
+  std::vector<const ozone_egl_TelemetrySegment*> segments;
+  const char* prefix = OZONE_EGL_TELEMETRY_PREFIX + 1;
+  size_t prefix_length = strlen(prefix);
+  DIR* dir = opendir(kShmDirectory);
+  if (!dir)
+    return segments;
+  while (struct dirent* entry = readdir(dir)) {
+    if (strncmp(entry->d_name, prefix, prefix_length))
+      continue;
+    int pid = atoi(entry->d_name + prefix_length);
+    if (pid <= 0)
+      continue;
+    if (IsRunning(pid))
+      pids.push_back(pid);
+    else
+      Reap(pid);
+  }
+  closedir(dir);
+  std::sort(pids.begin(), pids.end());
+  for (size_t i = 0; i < pids.size(); i++) {
+    const ozone_egl_TelemetrySegment* segment = Attach(pids[i]);
+    if (segment)
+      segments.push_back(segment);
+  }
+  return segments;
+}
+
+// Copies a record the writer may be overwriting; false if it did.
+bool ReadRecord(const ozone_egl_TelemetrySegment* segment, uint64_t frame,
+                ozone_egl_TelemetryRecord* record) {
+  const ozone_egl_TelemetryRecord* source =
+      &segment->records[frame % OZONE_EGL_TELEMETRY_RECORDS];
+  uint64_t sequence = __atomic_load_n(&source->sequence, __ATOMIC_ACQUIRE);
+  if (sequence != frame + 1)
+    return false;
+  memcpy(record, source, sizeof(*record));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&source->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+bool ReadInfo(const ozone_egl_TelemetrySegment* segment,
+              ozone_egl_TelemetryInfo* info) {
+  for (int attempt = 0; attempt < 100; attempt++) {
+    uint32_t sequence =
+        __atomic_load_n(&segment->info.sequence, __ATOMIC_ACQUIRE);
+    if (sequence & 1)
+      continue;
+    memcpy(info, &segment->info, sizeof(*info));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&segment->info.sequence, __ATOMIC_RELAXED) ==
+        sequence) {
+      info->backend[sizeof(info->backend) - 1] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+// Nearest-rank percentile of sorted |values|, in microseconds, as ms.
+double Percentile(const std::vector<uint32_t>& values, int percent) {
+  size_t rank = (values.size() * percent + 99) / 100;
+  return values[rank ? rank - 1 : 0] / 1000.0;
+}
+
+void PrintPercentiles(const char* name, std::vector<uint32_t>* values) {
+  std::sort(values->begin(), values->end());
+  printf("  %-5s ms p50 %6.2f p95 %6.2f p99 %6.2f max %6.2f\n", name,
+         Percentile(*values, 50), Percentile(*values, 95),
+         Percentile(*values, 99), Percentile(*values, 100));
+}
+
+void PrintInfo(const ozone_egl_TelemetrySegment* segment) {
+  ozone_egl_TelemetryInfo info;
+  printf("[%d] ", segment->pid);
+  if (!ReadInfo(segment, &info)) {
+    printf("busy\n");
+    return;
+  }
+  if (!info.backend[0]) {
+    printf("no backend\n");
+    return;
+  }
+  printf("%s %dx%d", info.backend, info.width, info.height);
+  if (info.refreshIntervalUsec)
+    printf(" @%.1f Hz", 1e6 / info.refreshIntervalUsec);
+  if (info.transform)
+    printf(" transform %d", info.transform);
+  if (info.state & OZONE_EGL_TELEMETRY_SUSPENDED)
+    printf(" suspended");
+  if (info.state & OZONE_EGL_TELEMETRY_FRONT_BUFFER)
+    printf(" front-buffer");
+  if (info.state & OZONE_EGL_TELEMETRY_HW_CURSOR)
+    printf(" hw-cursor");
+  printf("\n");
+}
+
+// Reports the frames from |*next| up to the head and moves |*next| there.
+void Report(const ozone_egl_TelemetrySegment* segment, uint64_t* next) {
+  uint64_t head = __atomic_load_n(&segment->head, __ATOMIC_ACQUIRE);
+  uint64_t lost = 0;
+  if (head - *next > OZONE_EGL_TELEMETRY_RECORDS) {
+    lost = head - OZONE_EGL_TELEMETRY_RECORDS - *next;
+    *next = head - OZONE_EGL_TELEMETRY_RECORDS;
+  }
+
+  std::vector<uint32_t> frame, draw, swap;
+  uint64_t upload_bytes = 0;
+  uint64_t first_usec = 0, last_usec = 0;
+  uint32_t rss_kb = 0, switches = 0;
+  for (uint64_t i = *next; i < head; i++) {
+    ozone_egl_TelemetryRecord record;
+    if (!ReadRecord(segment, i, &record)) {
+      lost++;
+      continue;
+    }
+    if (!first_usec)
+      first_usec = record.usec;
+    last_usec = record.usec;
+    // The first frame after a gap in presenting would skew the rate.
+    if (record.frameUsec)
+      frame.push_back(record.frameUsec);
+    draw.push_back(record.drawUsec);
+    swap.push_back(record.swapUsec);
+    upload_bytes += record.uploadBytes;
+    switches += record.makeCurrentSwitches;
+    rss_kb = record.rssKb;
+  }
+  *next = head;
+
+  PrintInfo(segment);
+  if (swap.empty()) {
+    printf("  no frames\n");
+    return;
+  }
+  double span_s = (last_usec - first_usec) / 1e6;
+  printf("  %zu frames", swap.size());
+  if (span_s > 0.0)
+    printf(", %.1f fps, upload %.1f MB/s", (swap.size() - 1) / span_s,
+           upload_bytes / span_s / (1024 * 1024));
+  printf(", rss %u MB, %.1f makecurrent/frame", rss_kb / 1024,
+         (double)switches / swap.size());
+  if (lost)
+    printf(", %llu lost", (unsigned long long)lost);
+  printf("\n");
+  if (!frame.empty())
+    PrintPercentiles("frame", &frame);
+  PrintPercentiles("draw", &draw);
+  PrintPercentiles("swap", &swap);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    fprintf(stderr,
+            "Usage: %s [--list] [--pid=n] [--interval=s] [--count=n]\n",
+            argv[0]);
+    return 2;
+  }
+
+  const ozone_egl_TelemetrySegment* segment = NULL;
+  if (options.list || !options.pid) {
+    std::vector<const ozone_egl_TelemetrySegment*> segments = FindProcesses();
+    if (options.list || segments.size() != 1) {
+      if (segments.empty())
+        fprintf(stderr, "No process publishes telemetry\n");
+      for (size_t i = 0; i < segments.size(); i++)
+        PrintInfo(segments[i]);
+      if (!options.list && segments.size() > 1)
+        fprintf(stderr, "Pick one with --pid\n");
+      return options.list && !segments.empty() ? 0 : 1;
+    }
+    segment = segments[0];
+    options.pid = segment->pid;
+  } else {
+    segment = Attach(options.pid);
+    if (!segment)
+      return 1;
+  }
+
+  uint64_t head = __atomic_load_n(&segment->head, __ATOMIC_ACQUIRE);
+  uint64_t next = head > OZONE_EGL_TELEMETRY_RECORDS
+                      ? head - OZONE_EGL_TELEMETRY_RECORDS
+                      : 0;
+  for (int i = 0; !options.count || i < options.count; i++) {
+    if (i)
+      sleep(options.interval_s);
+    Report(segment, &next);
+    fflush(stdout);
+    if (!IsPublishing(segment)) {
+      printf("[%d] exited\n", options.pid);
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include <string.h>
+
+#include "egl_tile_hash.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Two 64-bit lanes per 16 bytes, accumulated as in XXH3: each lane adds
+// lo32 * hi32 of (data ^ key) and the other lane's raw data. The key
+// advances every block so that moving content sideways changes the hash,
+// and each row ends with a multiplicative scramble.
+#define OZONE_EGL_HASH_PRIME32 0x9E3779B1u
+
+static const uint64_t kKey[2] = { 0xbe4ba423396cfeb8ull,
+                                  0x1cad21f72c81017cull };
+static const uint64_t kKeyStep[2] = { 0xdb979083e96dd4deull,
+                                      0x7a88d5e1a4c1b4f3ull };
+
+static inline uint64_t ozone_egl_hashMix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Remaining 4-byte words of a row.
+static inline void ozone_egl_hashTail(uint64_t* acc, uint64_t* key,
+                                      const char* p, int bytes)
+{
+    uint32_t word;
+
+    while (bytes >= 4)
+    {
+        memcpy(&word, p, 4);
+        acc[0] += (uint64_t)(word ^ (uint32_t)key[0]) * (key[0] >> 32);
+        key[0] += kKeyStep[0];
+        p += 4;
+        bytes -= 4;
+    }
+}
+
+static inline void ozone_egl_hashScramble(uint64_t* acc)
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] ^= kKey[i];
+        acc[i] *= OZONE_EGL_HASH_PRIME32;
+    }
+}
+
+#if defined(__SSE2__)
+
+static void ozone_egl_hashRow(uint64_t* acc, uint64_t* key,
+                              const char* p, int bytes)
+{
+    __m128i vacc = _mm_loadu_si128((const __m128i*)acc);
+    __m128i vkey = _mm_loadu_si128((const __m128i*)key);
+    const __m128i vstep = _mm_loadu_si128((const __m128i*)kKeyStep);
+
+    for (; bytes >= 16; p += 16, bytes -= 16)
+    {
+        __m128i data = _mm_loadu_si128((const __m128i*)p);
+        __m128i data_key = _mm_xor_si128(data, vkey);
+        __m128i data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        vacc = _mm_add_epi64(vacc, _mm_mul_epu32(data_key, data_key_hi));
+        vacc = _mm_add_epi64(vacc, _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+        vkey = _mm_add_epi64(vkey, vstep);
+    }
+    _mm_storeu_si128((__m128i*)acc, vacc);
+    _mm_storeu_si128((__m128i*)key, vkey);
+    ozone_egl_hashTail(acc, key, p, bytes);
+}
+
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+static void ozone_egl_hashRow(uint64_t* acc, uint64_t* key,
+                              const char* p, int bytes)
+{
+    uint64x2_t vacc = vld1q_u64(acc);
+    uint64x2_t vkey = vld1q_u64(key);
+    const uint64x2_t vstep = vld1q_u64(kKeyStep);
+
+    for (; bytes >= 16; p += 16, bytes -= 16)
+    {
+        uint64x2_t data = vreinterpretq_u64_u8(vld1q_u8((const uint8_t*)p));
+        uint64x2_t data_key = veorq_u64(data, vkey);
+        uint32x2_t data_key_lo = vmovn_u64(data_key);
+        uint32x2_t data_key_hi = vshrn_n_u64(data_key, 32);
+        vacc = vmlal_u32(vacc, data_key_lo, data_key_hi);
+        vacc = vaddq_u64(vacc, vextq_u64(data, data, 1));
+        vkey = vaddq_u64(vkey, vstep);
+    }
+    vst1q_u64(acc, vacc);
+    vst1q_u64(key, vkey);
+    ozone_egl_hashTail(acc, key, p, bytes);
+}
+
+#else
+
+static void ozone_egl_hashRow(uint64_t* acc, uint64_t* key,
+                              const char* p, int bytes)
+{
+    uint64_t data[2];
+    uint64_t data_key;
+    int i;
+
+    for (; bytes >= 16; p += 16, bytes -= 16)
+    {
+        memcpy(data, p, 16);
+        for (i = 0; i < 2; i++)
+        {
+            data_key = data[i] ^ key[i];
+            acc[i] += (data_key & 0xffffffffu) * (data_key >> 32);
+            acc[i] += data[i ^ 1];
+            key[i] += kKeyStep[i];
+        }
+    }
+    ozone_egl_hashTail(acc, key, p, bytes);
+}
+
+#endif
+
+uint64_t ozone_egl_hashPixels(const char* pixels, int row_bytes, int rows,
+                              int stride)
+{
+    uint64_t acc[2] = { (uint64_t)row_bytes, (uint64_t)rows };
+    uint64_t key[2] = { kKey[0], kKey[1] };
+    int row;
+
+    for (row = 0; row < rows; row++)
+    {
+        ozone_egl_hashRow(acc, key, pixels + (long)row * stride, row_bytes);
+        ozone_egl_hashScramble(acc);
+    }
+    return ozone_egl_hashMix(acc[0] ^ ozone_egl_hashMix(acc[1]));
+}
@@ -0,0 +1,16 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef UI_OZONE_EGL_TILE_HASH_H_
+#define UI_OZONE_EGL_TILE_HASH_H_
+
+#include <stdint.h>
+
+// Hashes |rows| rows of |row_bytes| bytes, |stride| bytes apart, with SSE2
+// or NEON where the compiler targets them. All variants produce the same
+// value. The hash detects unchanged canvas tiles and is not meant to
+// resist crafted collisions.
+uint64_t ozone_egl_hashPixels(const char* pixels, int row_bytes, int rows,
+                              int stride);
+
+#endif
@@ -0,0 +1,82 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ui/ozone/platform/egl/egl_tile_pool.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/sys_info.h"
+
+namespace ui {
+
+EglTilePool::EglTilePool(int max_threads)
+    : work_available_(&lock_),
+      work_done_(&lock_),
+      next_index_(0),
+      count_(0),
+      outstanding_(0),
+      quit_(false) {
+  int num_threads =
+      std::min(max_threads, base::SysInfo::NumberOfProcessors() - 1);
+  for (int i = 0; i < num_threads; i++) {
+    base::PlatformThreadHandle handle;
+    if (!base::PlatformThread::Create(0, this, &handle)) {
+      LOG(ERROR) << "Failed to start tile thread";
+      break;
+    }
+    threads_.push_back(handle);
+  }
+}
+
+EglTilePool::~EglTilePool() {
+  {
+    base::AutoLock lock(lock_);
+    quit_ = true;
+    work_available_.Broadcast();
+  }
+  for (size_t i = 0; i < threads_.size(); i++)
+    base::PlatformThread::Join(threads_[i]);
+}
+
+void EglTilePool::ParallelFor(int count, const Job& job) {
+  base::AutoLock lock(lock_);
+  DCHECK_EQ(0, outstanding_);
+  job_ = job;
+  next_index_ = 0;
+  count_ = count;
+  outstanding_ = count;
+  if (count > 1)
+    work_available_.Broadcast();
+
+  RunJobs();
+  while (outstanding_)
+    work_done_.Wait();
+  job_.Reset();
+}
+
+void EglTilePool::ThreadMain() {
+  base::PlatformThread::SetName("EglTileWorker");
+  base::AutoLock lock(lock_);
+  while (!quit_) {
+    if (next_index_ < count_)
+      RunJobs();
+    else
+      work_available_.Wait();
+  }
+}
+
+void EglTilePool::RunJobs() {
+  while (next_index_ < count_) {
+    int index = next_index_++;
+    {
+      base::AutoUnlock unlock(lock_);
+      job_.Run(index);
+    }
+    if (!--outstanding_)
+      work_done_.Signal();
+  }
+}
+
+}  // namespace ui
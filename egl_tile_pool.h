@@ -0,0 +1,54 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UI_OZONE_PLATFORM_EGL_TILE_POOL_H_
+#define UI_OZONE_PLATFORM_EGL_TILE_POOL_H_
+
+#include <vector>
+
+#include "base/callback.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+
+namespace ui {
+
+// A few long-lived threads that prepare canvas tiles for upload. The
+// presenting thread hands out one job per tile and works on them too, so a
+// frame with a single damaged tile costs no thread hop at all.
+class EglTilePool : public base::PlatformThread::Delegate {
+ public:
+  typedef base::Callback<void(int)> Job;
+
+  // Uses one thread less than there are cores, at most |max_threads|.
+  explicit EglTilePool(int max_threads);
+  ~EglTilePool() override;
+
+  // Runs |job| for 0 .. |count| - 1 and returns once all of them finished.
+  void ParallelFor(int count, const Job& job);
+
+  // base::PlatformThread::Delegate:
+  void ThreadMain() override;
+
+ private:
+  // Runs queued jobs until none are left. Called with |lock_| held.
+  void RunJobs();
+
+  base::Lock lock_;
+  base::ConditionVariable work_available_;
+  base::ConditionVariable work_done_;
+  std::vector<base::PlatformThreadHandle> threads_;
+
+  Job job_;
+  int next_index_;
+  int count_;
+  int outstanding_;
+  bool quit_;
+
+  DISALLOW_COPY_AND_ASSIGN(EglTilePool);
+};
+
+}  // namespace ui
+
+#endif  // UI_OZONE_PLATFORM_EGL_TILE_POOL_H_
@@ -0,0 +1,144 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Draws flat YUV frames through the video program and reads the colour back.
+// Runs against Mesa's surfaceless platform, or whatever backend the probe
+// finds without it.
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "egl_wrapper.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kWidth = 64;
+const int kHeight = 48;
+// Bytes of padding after each row of the strided frames.
+const int kPadding = 24;
+// Rounding of mediump arithmetic and 8-bit textures.
+const int kTolerance = 3;
+
+class EglVideoTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    setenv("OZONE_EGL_BACKEND", "surfaceless", 1);
+    ASSERT_EQ(OZONE_EGL_SUCCESS, ozone_egl_setup(0, 0, 0, 0));
+    ozone_egl_Output output;
+    ASSERT_EQ(1, ozone_egl_getOutputs(&output, 1));
+    screen_width_ = output.modes[0].width;
+    screen_height_ = output.modes[0].height;
+    memset(&video_, 0, sizeof(video_));
+    video_.width = kWidth;
+    video_.height = kHeight;
+  }
+
+  void TearDown() override {
+    ozone_egl_videoShutDown(&video_);
+    ozone_egl_destroy();
+    unsetenv("OZONE_EGL_BACKEND");
+  }
+
+  // Fills |plane| with |value|, or with |value| and |value2| alternating
+  // for an interleaved plane, and leaves the padding at 0.
+  void FillPlane(std::vector<uint8_t>* plane, int width, int height,
+                 int stride, uint8_t value, int value2) {
+    plane->assign(stride * height, 0);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        if (value2 < 0) {
+          (*plane)[y * stride + x] = value;
+        } else {
+          (*plane)[y * stride + 2 * x] = value;
+          (*plane)[y * stride + 2 * x + 1] = value2;
+        }
+      }
+    }
+  }
+
+  // Draws the video over the whole screen and returns the centre pixel.
+  void DrawAndRead(uint8_t rgba[4]) {
+    ozone_egl_videoDraw(&video_, 0, 0, screen_width_, screen_height_);
+    glReadPixels(screen_width_ / 2, screen_height_ / 2, 1, 1, GL_RGBA,
+                 GL_UNSIGNED_BYTE, rgba);
+    EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), glGetError());
+  }
+
+  void ExpectColor(const uint8_t rgba[4], int r, int g, int b) {
+    EXPECT_NEAR(r, rgba[0], kTolerance);
+    EXPECT_NEAR(g, rgba[1], kTolerance);
+    EXPECT_NEAR(b, rgba[2], kTolerance);
+  }
+
+  int screen_width_;
+  int screen_height_;
+  ozone_egl_VideoData video_;
+};
+
+TEST_F(EglVideoTest, I420StudioRangeBT601) {
+  video_.format = OZONE_EGL_VIDEO_I420;
+  video_.colorSpace = OZONE_EGL_VIDEO_BT601;
+  ASSERT_EQ(OZONE_EGL_SUCCESS, ozone_egl_videoInit(&video_));
+
+  // Studio swing red.
+  std::vector<uint8_t> y, u, v;
+  FillPlane(&y, kWidth, kHeight, kWidth, 81, -1);
+  FillPlane(&u, kWidth / 2, kHeight / 2, kWidth / 2, 90, -1);
+  FillPlane(&v, kWidth / 2, kHeight / 2, kWidth / 2, 240, -1);
+  video_.planes[0] = &y[0];
+  video_.planes[1] = &u[0];
+  video_.planes[2] = &v[0];
+
+  uint8_t rgba[4];
+  DrawAndRead(rgba);
+  ExpectColor(rgba, 254, 0, 0);
+}
+
+TEST_F(EglVideoTest, StridedNV12FullRangeBT709) {
+  video_.format = OZONE_EGL_VIDEO_NV12;
+  video_.colorSpace = OZONE_EGL_VIDEO_BT709;
+  video_.fullRange = 1;
+  ASSERT_EQ(OZONE_EGL_SUCCESS, ozone_egl_videoInit(&video_));
+
+  // The padding would tint the picture if rows were not packed.
+  std::vector<uint8_t> y, uv;
+  FillPlane(&y, kWidth, kHeight, kWidth + kPadding, 128, -1);
+  FillPlane(&uv, kWidth / 2, kHeight / 2, kWidth + kPadding, 64, 192);
+  video_.planes[0] = &y[0];
+  video_.planes[1] = &uv[0];
+  video_.strides[0] = kWidth + kPadding;
+  video_.strides[1] = kWidth + kPadding;
+
+  uint8_t rgba[4];
+  DrawAndRead(rgba);
+  ExpectColor(rgba, 229, 110, 9);
+}
+
+TEST_F(EglVideoTest, FailedImportKeepsPlanes) {
+  video_.format = OZONE_EGL_VIDEO_I420;
+  video_.colorSpace = OZONE_EGL_VIDEO_BT601;
+  video_.fullRange = 1;
+  ASSERT_EQ(OZONE_EGL_SUCCESS, ozone_egl_videoInit(&video_));
+
+  std::vector<uint8_t> y, u, v;
+  FillPlane(&y, kWidth, kHeight, kWidth, 200, -1);
+  FillPlane(&u, kWidth / 2, kHeight / 2, kWidth / 2, 128, -1);
+  FillPlane(&v, kWidth / 2, kHeight / 2, kWidth / 2, 128, -1);
+  video_.planes[0] = &y[0];
+  video_.planes[1] = &u[0];
+  video_.planes[2] = &v[0];
+  uint8_t rgba[4];
+  DrawAndRead(rgba);
+
+  // Not an image, whether or not the extension is there.
+  EXPECT_EQ(OZONE_EGL_FAILURE,
+            ozone_egl_videoImportImage(&video_, EGL_NO_IMAGE_KHR));
+  video_.planes[0] = NULL;
+  DrawAndRead(rgba);
+  ExpectColor(rgba, 200, 200, 200);
+}
+
+}  // namespace
@@ -8,23 +8,54 @@
 #include "ui/events/platform/platform_event_source.h"
 #include "ui/gfx/display.h"
 #include "ui/ozone/common/gpu/ozone_gpu_messages.h"
+#include "ui/ozone/platform/egl/egl_cursor.h"
+#include "ui/ozone/platform/egl/egl_gpu_platform_support_host.h"
+#include "ui/ozone/platform/egl/egl_latency_tracker.h"
 #include "ui/platform_window/platform_window_delegate.h"
+#include "egl_wrapper.h"
 
 namespace ui {
 
+namespace {
+
+// Touchscreens are mounted with the panel and report panel positions; the
+// screen is the panel under the display transform.
+void TransformTouchEvent(TouchEvent* event) {
+  if (ozone_egl_getTransform() == OZONE_EGL_TRANSFORM_NORMAL)
+    return;
+  float x = event->location_f().x();
+  float y = event->location_f().y();
+  ozone_egl_panelToScreen(&x, &y);
+  // The window covers the screen from its origin.
+  event->set_location(gfx::PointF(x, y));
+  event->set_root_location(gfx::PointF(x, y));
+}
+
+}  // namespace
+
  eglWindow::eglWindow(PlatformWindowDelegate* delegate,
          SurfaceFactoryEgl* surface_factory,
          EventFactoryEvdev* event_factory,
+         EglCursor* cursor,
+         EglGpuPlatformSupportHost* gpu_platform_support_host,
          const gfx::Rect& bounds)
      : delegate_(delegate),
        event_factory_(event_factory),
+       cursor_(cursor),
+       gpu_platform_support_host_(gpu_platform_support_host),
        bounds_(bounds),
-       surface_factory_(surface_factory) {
+       surface_factory_(surface_factory),
+       coalescer_(base::Bind(&PlatformWindowDelegate::DispatchEvent,
+                             base::Unretained(delegate))),
+       has_presentation_feedback_(false) {
    surface_factory_->CreateSingleWindow();
    window_id_=surface_factory_->GetNativeWindow();
+   cursor_->SetBounds(bounds_);
+   gpu_platform_support_host_->AddObserver(this);
  }
  
  eglWindow::~eglWindow() {
+   gpu_platform_support_host_->RemoveObserver(this);
    ui::PlatformEventSource::GetInstance()->RemovePlatformEventDispatcher(this);
  }
 
@@ -39,13 +70,17 @@ namespace ui {
  
  void eglWindow::SetBounds(const gfx::Rect& bounds) {
    bounds_ = bounds;
+   cursor_->SetBounds(bounds);
    delegate_->OnBoundsChanged(bounds);
  }
  
  void eglWindow::Show() {
+   surface_factory_->Resume();
  }
  
  void eglWindow::Hide() {
+   // Nothing of ours is on screen; give back the GPU and raster memory.
+   surface_factory_->Suspend();
  }
  
  void eglWindow::Close() {
@@ -64,12 +99,15 @@ namespace ui {
  }
  
  void eglWindow::Minimize() {
+   surface_factory_->Suspend();
  }
  
  void eglWindow::Restore() {
+   surface_factory_->Resume();
  }
  
  void eglWindow::SetCursor(PlatformCursor cursor) {
+   cursor_->SetCursor(cursor);
  }
  
  void eglWindow::MoveCursorTo(const gfx::Point& location) {
@@ -77,6 +115,7 @@ namespace ui {
  }
  
  void eglWindow::ConfineCursorToBounds(const gfx::Rect& bounds) {
+   cursor_->ConfineCursorToBounds(bounds);
  }
  
 bool eglWindow::CanDispatchEvent(const PlatformEvent& ne) {
@@ -85,9 +124,23 @@ bool eglWindow::CanDispatchEvent(const PlatformEvent& ne) {
 
 uint32_t eglWindow::DispatchEvent(const PlatformEvent& native_event) {
   DCHECK(native_event);
- // Event* event = static_cast<Event*>(native_event);
- // if (event->IsTouchEvent())
-//    ScaleTouchEvent(static_cast<TouchEvent*>(event), bounds_.size());
+  Event* event = static_cast<Event*>(native_event);
+  if (event->IsTouchEvent())
+    TransformTouchEvent(static_cast<TouchEvent*>(event));
+
+  EglLatencyTracker::GetInstance()->OnInputEvent(
+      static_cast<Event*>(native_event)->time_stamp());
+
+  // High-rate pointers deliver several moves per frame; only the last one
+  // per pointer is dispatched, at the next frame boundary.
+  uint64_t timebase, interval;
+  if (!has_presentation_feedback_ &&
+      ozone_egl_getVSyncParameters(&timebase, &interval)) {
+    coalescer_.SetFrameTiming(base::TimeTicks::FromInternalValue(timebase),
+                              base::TimeDelta::FromMicroseconds(interval));
+  }
+  if (coalescer_.OnEvent(*static_cast<Event*>(native_event)))
+    return POST_DISPATCH_STOP_PROPAGATION;
 
   DispatchEventFromNativeUiEvent(
       native_event, base::Bind(&PlatformWindowDelegate::DispatchEvent,
@@ -95,5 +148,13 @@ uint32_t eglWindow::DispatchEvent(const PlatformEvent& native_event) {
 
   return POST_DISPATCH_STOP_PROPAGATION;
 }
+
+void eglWindow::OnFramePresented(gfx::AcceleratedWidget widget,
+                                 const EglPresentationFeedback& feedback) {
+  if (widget != window_id_ || feedback.interval.is_zero())
+    return;
+  has_presentation_feedback_ = true;
+  coalescer_.SetFrameTiming(feedback.timestamp, feedback.interval);
+}
  
 }
@@ -5,17 +5,25 @@
 #include "ui/events/platform/platform_event_dispatcher.h"
 #include "ui/platform_window/platform_window.h"
 #include "ui/platform_window/platform_window_delegate.h"
+#include "ui/ozone/platform/egl/egl_event_coalescer.h"
+#include "ui/ozone/platform/egl/egl_presentation_feedback.h"
 #include "ui/ozone/platform/egl/egl_surface_factory.h"
 
 namespace ui {
+class EglCursor;
+class EglGpuPlatformSupportHost;
 class SurfaceFactoryEgl;
 class EventFactoryEvdev;
 
-class eglWindow : public PlatformWindow, public PlatformEventDispatcher {
+class eglWindow : public PlatformWindow,
+                  public PlatformEventDispatcher,
+                  public EglPresentationObserver {
  public:
   eglWindow(PlatformWindowDelegate* delegate,
           SurfaceFactoryEgl* surface_factory,
           EventFactoryEvdev* event_factory,
+          EglCursor* cursor,
+          EglGpuPlatformSupportHost* gpu_platform_support_host,
           const gfx::Rect& bounds);
   ~eglWindow() override;
 
@@ -45,14 +53,29 @@ class eglWindow : public PlatformWindow, public PlatformEventDispatcher {
 
   PlatformImeController* GetPlatformImeController() override { return nullptr; }
 
+  // EglPresentationObserver:
+  void OnFramePresented(gfx::AcceleratedWidget widget,
+                        const EglPresentationFeedback& feedback) override;
+
+  // Moves merged into the event currently being dispatched, oldest first.
+  const std::vector<EglEventCoalescer::Sample>& GetCoalescedSamples() const {
+    return coalescer_.historical_samples();
+  }
+
  private:
   PlatformWindowDelegate* delegate_;
   //LibeglplatformShimLoader* eglplatform_shim_;
   EventFactoryEvdev* event_factory_;
+  EglCursor* cursor_;
+  EglGpuPlatformSupportHost* gpu_platform_support_host_;
   gfx::Rect bounds_;
   //ShimNativeWindowId window_id_;
   SurfaceFactoryEgl* surface_factory_;
   intptr_t window_id_;
+  EglEventCoalescer coalescer_;
+  // Set once the GPU process reported a flip; its timing then replaces
+  // that of the wrapper in this process, which does not present.
+  bool has_presentation_feedback_;
 
 
   DISALLOW_COPY_AND_ASSIGN(eglWindow);
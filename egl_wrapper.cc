@@ -1,113 +1,335 @@
 // Copyright 2014 The Chromium Authors. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <sys/mman.h>
-#include <linux/fb.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 
+#include <ios>
+
+#include "egl_backend.h"
+#include "egl_capture.h"
+#include "egl_gl_trace.h"
+#include "egl_pixel_pack.h"
+#include "egl_telemetry.h"
+#include "egl_tile_hash.h"
 #include "egl_wrapper.h"
 #include "base/logging.h"
 
-#if defined(EGL_API_BRCM)
-#include "bcm_host.h"
-#endif
+#include <GLES2/gl2ext.h>
 
-typedef NativeDisplayType NativeDisplay;
-typedef intptr_t            NativeWindow;
-typedef void *            NativePixmap;
+#define OZONE_EGL_BENCHMARK_FRAMES 60
+// Canvas texture tile edge, clamped to GL_MAX_TEXTURE_SIZE. Small enough
+// that a typical damage rect only re-uploads a few tiles.
+#define OZONE_EGL_DEFAULT_TILE_SIZE 512
+// Time the GPU gets to draw a tile row into the front buffer before the
+// scanout reaches it.
+#define OZONE_EGL_FRONT_BUFFER_LEAD_USEC 2000
 
-typedef struct fbdev_window
+typedef struct
+{
+    // Tightly packed copy of the image, kept for backend switches and for
+    // the software quad.
+    uint8_t* pixels;
+    int width;
+    int height;
+    int hot_x;
+    int hot_y;
+    int x;
+    int y;
+    int hardware;
+    int dirty;
+    GLuint textureId;
+    // Canvas rectangle the software cursor was last blended over, which a
+    // front buffer keeps showing until the tiles under it are redrawn
+    int drawnX;
+    int drawnY;
+    int drawnWidth;
+    int drawnHeight;
+} ozone_egl_Cursor;
+
+// Everything the wrapper knows about the display it drives. The GPU main
+// thread, the compositor and helper threads all come through the entry
+// points below, which hold |lock| while they touch it. The lock is
+// recursive because entry points call each other, e.g. setup benchmarking
+// with swaps.
+typedef struct
 {
-    unsigned short width;
-    unsigned short height;
-} fbdev_window;
+    pthread_mutex_t lock;
+
+    OzoneEglBackend* backend;
+
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+    EGLConfig config;
+    int suspended;
+
+    // Bumped whenever the context or surface goes away, which invalidates
+    // the binding every thread remembers.
+    uint32_t generation;
+
+    // eglMakeCurrent calls made and skipped since the last swap, and the
+    // totals of the frame before
+    uint32_t frameSwitches;
+    uint32_t frameSkipped;
+    uint32_t lastFrameSwitches;
+    uint32_t lastFrameSkipped;
+
+    // Frame period of the output we draw on and the time of the last
+    // present, for backends without flip events.
+    uint64_t refreshIntervalUsec;
+    uint64_t lastPresentUsec;
+    // Time the last swap took, for the telemetry of the present after it
+    uint64_t swapUsec;
+
+    // Program binary of the canvas program, kept across
+    // ozone_egl_textureRelease() where GL_OES_get_program_binary is
+    // available.
+    void* programBinary;
+    GLsizei programBinarySize;
+    GLenum programBinaryFormat;
+
+    NativeDisplayType nativeDisplay;
+    NativeWindowType nativeWindow;
+
+    // Size of the window surface
+    int windowWidth;
+    int windowHeight;
+
+    // Display transform, its size in panel pixels, and the part the
+    // backend does not apply at scanout, which the present pass applies
+    int transform;
+    int panelWidth;
+    int panelHeight;
+    int presentTransform;
+
+    // Set when OZONE_EGL_FRONT_BUFFER got a single buffered surface: draws
+    // land in the buffer being scanned out and presents only flush. The
+    // window then keeps what |frontBufferOwner| drew, and a canvas only
+    // redraws its changed tiles while it is the owner.
+    int frontBuffer;
+    const ozone_egl_UserData* frontBufferOwner;
+
+    ozone_egl_Cursor cursor;
+} ozone_egl_State;
+
+static ozone_egl_State g_State;
+static pthread_once_t g_StateOnce = PTHREAD_ONCE_INIT;
+
+// What this thread last made current through the wrapper.
+typedef struct
+{
+    EGLContext context;
+    EGLSurface surface;
+    uint32_t generation;
+} ozone_egl_ThreadBinding;
 
+static __thread ozone_egl_ThreadBinding t_Binding;
 
-//rgba8888
-/*
-static EGLint g_configAttribs[] = {
-    EGL_RED_SIZE, 8,
-    EGL_GREEN_SIZE, 8,
-    EGL_BLUE_SIZE, 8,
-    EGL_ALPHA_SIZE, 8,
-    EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-    EGL_NONE,
-};
-  */
-static EGLint g_configAttribs[] = {
-    EGL_RED_SIZE, 5,
-    EGL_GREEN_SIZE, 6,
-    EGL_BLUE_SIZE, 5,
-    EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-    EGL_NONE,
+static void ozone_egl_initState()
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&g_State.lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    // Thread bindings start at generation 0 and never match.
+    g_State.generation = 1;
+}
+
+class ozone_egl_StateLock
+{
+public:
+    ozone_egl_StateLock()
+    {
+        pthread_once(&g_StateOnce, ozone_egl_initState);
+        pthread_mutex_lock(&g_State.lock);
+    }
+    ~ozone_egl_StateLock()
+    {
+        pthread_mutex_unlock(&g_State.lock);
+    }
 };
 
-static EGLDisplay g_EglDisplay = NULL;
-static EGLContext g_EglContext = NULL;
-static EGLSurface g_EglSurface = NULL;
+// Binds |context| and |surface| on the calling thread unless the wrapper
+// already did so, neither was destroyed since, and nobody else (Chromium's
+// GL bindings, Skia) made something else current in between. Call with the
+// lock held.
+static int ozone_egl_bindLocked(EGLSurface surface, EGLContext context)
+{
+    if (t_Binding.generation == g_State.generation &&
+        t_Binding.context == context && t_Binding.surface == surface &&
+        eglGetCurrentContext() == context &&
+        eglGetCurrentSurface(EGL_DRAW) == surface)
+    {
+        g_State.frameSkipped++;
+        return OZONE_EGL_SUCCESS;
+    }
 
-static NativeDisplayType g_NativeDisplay= NULL;
-static NativeWindowType g_NativeWindow;
+    if (!OZONE_GL(eglMakeCurrent)(g_State.display, surface, surface, context))
+    {
+        LOG(ERROR) << "eglMakeCurrent failed: 0x" << std::hex << eglGetError();
+        t_Binding.generation = 0;
+        return OZONE_EGL_FAILURE;
+    }
+    t_Binding.context = context;
+    t_Binding.surface = surface;
+    t_Binding.generation = g_State.generation;
+    g_State.frameSwitches++;
+    return OZONE_EGL_SUCCESS;
+}
 
-static int g_WindowWidth=0;
-static int g_WindowHeight=0;
 
+NativeWindowType ozone_egl_GetNativeWin(){
+  ozone_egl_StateLock lock;
+  return g_State.nativeWindow;
+}
 
-NativeDisplay ozone_egl_nativeCreateDisplay(void)
+// Tells ozone_egl_telemetry what the wrapper drives. Call with the lock
+// held.
+static void ozone_egl_publishTelemetryInfo()
 {
-#if defined(EGL_API_FB)
-    return (NativeDisplay)fbGetDisplayByIndex(0);
-#else
-    return EGL_DEFAULT_DISPLAY;
-#endif
+    uint32_t state = 0;
+
+    if (g_State.suspended)
+        state |= OZONE_EGL_TELEMETRY_SUSPENDED;
+    if (g_State.frontBuffer)
+        state |= OZONE_EGL_TELEMETRY_FRONT_BUFFER;
+    if (g_State.cursor.hardware)
+        state |= OZONE_EGL_TELEMETRY_HW_CURSOR;
+    ozone_egl_telemetryInfo(g_State.backend ? g_State.backend->GetName() : NULL,
+                            g_State.windowWidth, g_State.windowHeight,
+                            g_State.transform, g_State.refreshIntervalUsec,
+                            state);
 }
 
-void ozone_egl_nativeDestroyDisplay(NativeDisplay display)
+// Call with the lock held.
+static void ozone_egl_teardown()
 {
-    return;
+    if (g_State.display)
+    {
+        if (g_State.context &&
+            ozone_egl_bindLocked(g_State.surface, g_State.context))
+            ozone_egl_captureReset(g_State.display);
+        ozone_egl_bindLocked(EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+        if (g_State.context)
+        {
+            eglDestroyContext(g_State.display, g_State.context);
+        }
+
+        if (g_State.surface)
+        {
+            g_State.backend->DestroySurface(g_State.display, g_State.surface);
+        }
+
+        eglTerminate(g_State.display);
+    }
+    g_State.context = NULL;
+    g_State.surface = NULL;
+    g_State.display = NULL;
+    g_State.generation++;
+    g_State.config = NULL;
+    g_State.suspended = 0;
+    g_State.refreshIntervalUsec = 0;
+    g_State.lastPresentUsec = 0;
+
+    free(g_State.programBinary);
+    g_State.programBinary = NULL;
+    g_State.programBinarySize = 0;
+
+    if (g_State.backend)
+    {
+        g_State.backend->DestroyNativeWindow();
+        g_State.backend->Shutdown();
+        delete g_State.backend;
+        g_State.backend = NULL;
+    }
+    g_State.nativeWindow = 0;
+    g_State.nativeDisplay = NULL;
+    g_State.frontBuffer = 0;
+    g_State.frontBufferOwner = NULL;
+
+    // The texture died with the context.
+    g_State.cursor.textureId = 0;
+    g_State.cursor.hardware = 0;
+    g_State.cursor.dirty = 1;
+    g_State.cursor.drawnWidth = 0;
+    ozone_egl_publishTelemetryInfo();
 }
 
-NativeWindowType ozone_egl_GetNativeWin(){
-  return g_NativeWindow;
+static int ozone_egl_transformSwapsAxes(int transform)
+{
+    return transform & OZONE_EGL_TRANSFORM_ROT_90;
 }
 
-NativeWindow ozone_egl_nativeCreateWindow(const char *title, int width, int height, EGLint visualId)
+static int ozone_egl_parseTransform()
 {
-    fbdev_window *fbwin =(fbdev_window *) malloc( sizeof(fbdev_window));
-    if (NULL == fbwin)
+    const char* rotation = getenv("OZONE_EGL_ROTATION");
+    const char* flip = getenv("OZONE_EGL_FLIP");
+    int transform = OZONE_EGL_TRANSFORM_NORMAL;
+
+    if (rotation)
     {
-        return 0;
+        int degrees = atoi(rotation);
+        if (degrees % 90)
+            LOG(WARNING) << "Ignoring OZONE_EGL_ROTATION=" << rotation;
+        else
+            transform = ((degrees / 90) % 4 + 4) % 4;
     }
-
-    fbwin->width  = width;
-    fbwin->height = height;
-    return (NativeWindow) fbwin;
+    // The flip comes before the rotation. Mirroring top to bottom is
+    // mirroring left to right and half a turn.
+    if (flip && (flip[0] == 'h' || flip[0] == 'H'))
+        transform |= OZONE_EGL_TRANSFORM_FLIP_H;
+    else if (flip && (flip[0] == 'v' || flip[0] == 'V'))
+        transform = OZONE_EGL_TRANSFORM_FLIP_H | (transform ^ OZONE_EGL_TRANSFORM_ROT_180);
+    return transform;
 }
 
-void ozone_egl_nativeDestroyWindow(NativeWindow window)
+// Creates the window surface, single buffered if OZONE_EGL_FRONT_BUFFER=1
+// asks for it and both the backend and EGL can do it. Call with the lock
+// held and the context created.
+static EGLSurface ozone_egl_createSurface()
 {
-    if(window !=0 )
+    const char* front = getenv("OZONE_EGL_FRONT_BUFFER");
+    EGLSurface surface;
+    EGLint renderBuffer = EGL_BACK_BUFFER;
+
+    g_State.frontBuffer = 0;
+    g_State.frontBufferOwner = NULL;
+    if (front && strcmp(front, "0"))
     {
-       free((fbdev_window*) window);
+        surface = g_State.backend->CreateFrontBufferSurface(
+            g_State.display, g_State.config, g_State.nativeWindow);
+        if (surface != EGL_NO_SURFACE)
+        {
+            // EGL may ignore EGL_RENDER_BUFFER; only the context tells which
+            // buffer it really draws to.
+            if (ozone_egl_bindLocked(surface, g_State.context) &&
+                eglQueryContext(g_State.display, g_State.context,
+                                EGL_RENDER_BUFFER, &renderBuffer) &&
+                renderBuffer == EGL_SINGLE_BUFFER)
+            {
+                g_State.frontBuffer = 1;
+                return surface;
+            }
+            ozone_egl_bindLocked(EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroySurface(g_State.display, surface);
+            g_State.generation++;
+        }
+        LOG(WARNING) << "Front buffer rendering is unavailable on "
+                     << g_State.backend->GetName() << ", double buffering";
     }
+    return g_State.backend->CreateSurface(g_State.display, g_State.config,
+                                          g_State.nativeWindow);
 }
 
-EGLint ozone_egl_setup(EGLint x, EGLint y, EGLint width, EGLint height )
+static EGLint ozone_egl_setupBackend(OzoneEglBackend* backend)
 {
-    EGLConfig configs[10];
-    EGLint matchingConfigs;
-    EGLint err;
-
-#if defined(EGL_API_BRCM)
-    bcm_host_init();
-#endif
+    EGLConfig config;
 
     EGLint ctxAttribs[] =
     {
@@ -115,111 +337,227 @@ EGLint ozone_egl_setup(EGLint x, EGLint y, EGLint width, EGLint height )
         EGL_NONE
     };
 
+    g_State.backend = backend;
+    if (!backend->Initialize(&g_State.panelWidth, &g_State.panelHeight))
+    {
+        LOG(ERROR) << "Failed to open the native display";
+        return OZONE_EGL_FAILURE;
+    }
+
+    g_State.transform = ozone_egl_parseTransform();
+    g_State.presentTransform = g_State.transform;
+    g_State.windowWidth = g_State.panelWidth;
+    g_State.windowHeight = g_State.panelHeight;
+    if (backend->SetTransform(g_State.transform))
+    {
+        g_State.presentTransform = OZONE_EGL_TRANSFORM_NORMAL;
+        if (ozone_egl_transformSwapsAxes(g_State.transform))
+        {
+            g_State.windowWidth = g_State.panelHeight;
+            g_State.windowHeight = g_State.panelWidth;
+        }
+    }
+
     eglBindAPI(EGL_OPENGL_ES_API);
 
-    g_NativeDisplay = (NativeDisplayType)ozone_egl_nativeCreateDisplay();
-#if defined(EGL_API_FB)
-    fbGetDisplayGeometry(g_NativeDisplay,&g_WindowWidth,&g_WindowHeight);
-#elif defined(EGL_API_BRCM)
-    uint32_t w = 1280;
-	uint32_t h = 720;
-    if (graphics_get_display_size(0, &w, &h) >= 0) {
-        g_WindowWidth = w;
-        g_WindowHeight = h;
-        LOG(INFO) << "Detected display size: " << w << "x" << h;
-    } else
-        LOG(ERROR) << "Failed to detect display size, using default: " << w << "x" << h;
-#endif
-
-    g_EglDisplay = eglGetDisplay(g_NativeDisplay);
-    if (g_EglDisplay == EGL_NO_DISPLAY)
+    g_State.nativeDisplay = backend->GetNativeDisplay();
+    g_State.display = backend->GetDisplay();
+    if (g_State.display == EGL_NO_DISPLAY)
     {
         LOG(ERROR) << "eglGetDisplay returned EGL_NO_DISPLAY";
         return OZONE_EGL_FAILURE;
     }
 
     EGLint major, minor;
-    if (!eglInitialize(g_EglDisplay, &major, &minor))
+    if (!eglInitialize(g_State.display, &major, &minor))
     {
     	LOG(ERROR) << "eglInitialize failed.";
+        g_State.display = NULL;
         return OZONE_EGL_FAILURE;
     }
     LOG(INFO) << "EGL impl. version: " << major << "." << minor;
 
-    if (!eglChooseConfig(g_EglDisplay, g_configAttribs, &configs[0],
-                         sizeof(configs)/sizeof(configs[0]), &matchingConfigs))
+    if (!backend->ChooseConfig(g_State.display, &config))
     {
-    	LOG(ERROR) << "eglChooseConfig failed.";
         return OZONE_EGL_FAILURE;
     }
 
-    if (matchingConfigs < 1)
+    g_State.context = eglCreateContext(g_State.display, config, NULL, ctxAttribs);
+    if (g_State.context == EGL_NO_CONTEXT)
     {
-    	LOG(ERROR) << "No matching configs found";
+    	LOG(ERROR) << "Failed to get EGL Context";
         return OZONE_EGL_FAILURE;
     }
 
-    g_EglContext = eglCreateContext(g_EglDisplay, configs[0], NULL, ctxAttribs);
-    if (g_EglContext == EGL_NO_CONTEXT)
+    g_State.nativeWindow = backend->CreateNativeWindow(g_State.windowWidth, g_State.windowHeight);
+
+    g_State.config = config;
+    g_State.surface = ozone_egl_createSurface();
+    if (g_State.surface == EGL_NO_SURFACE)
     {
-    	LOG(ERROR) << "Failed to get EGL Context";
+        LOG(ERROR) << "g_State.surface == EGL_NO_SURFACE eglGeterror = " << eglGetError();
         return OZONE_EGL_FAILURE;
     }
 
-#if defined(EGL_API_FB)
-    g_NativeWindow = fbCreateWindow(g_NativeDisplay, 0, 0, g_WindowWidth, g_WindowHeight);
-#elif defined(EGL_API_BRCM)
-    static EGL_DISPMANX_WINDOW_T dispManWindow;
-    DISPMANX_ELEMENT_HANDLE_T dispmanElement;
-    DISPMANX_DISPLAY_HANDLE_T dispmanDisplay;
-    DISPMANX_UPDATE_HANDLE_T dispmanUpdate;
-    VC_RECT_T dst_rect;
-    VC_RECT_T src_rect;
-
-    dst_rect.x = 0;
-    dst_rect.y = 0;
-    dst_rect.width = g_WindowWidth;
-    dst_rect.height = g_WindowHeight;
-
-    src_rect.x = 0;
-    src_rect.y = 0;
-    src_rect.width = g_WindowWidth << 16;
-    src_rect.height = g_WindowHeight << 16;
+    if (!ozone_egl_bindLocked(g_State.surface, g_State.context))
+        return OZONE_EGL_FAILURE;
 
-    dispmanDisplay = vc_dispmanx_display_open(0);
-    dispmanUpdate = vc_dispmanx_update_start(0);
+    return OZONE_EGL_SUCCESS;
+}
 
-    dispmanElement = vc_dispmanx_element_add(dispmanUpdate, dispmanDisplay, 0, &dst_rect, 0, &src_rect, DISPMANX_PROTECTION_NONE, 0, 0, DISPMANX_NO_ROTATE);
+static void ozone_egl_updateRefreshInterval()
+{
+    ozone_egl_Output output;
+    float rate = 0.0f;
 
-    dispManWindow.element = dispmanElement;
-    dispManWindow.width = g_WindowWidth;
-    dispManWindow.height = g_WindowHeight;
-    vc_dispmanx_update_submit_sync(dispmanUpdate);
+    if (ozone_egl_getOutputs(&output, 1) && output.currentMode >= 0)
+        rate = output.modes[output.currentMode].refreshRate;
+    g_State.refreshIntervalUsec = rate > 0.0f ? (uint64_t)(1e6f / rate + 0.5f) : 0;
+}
 
-    g_NativeWindow = static_cast<NativeWindowType>(&dispManWindow);
-#endif
+static EGLint ozone_egl_tryBackend(const ozone_egl_BackendEntry* entry)
+{
+    OzoneEglBackend* backend = entry->create();
 
-    g_EglSurface = eglCreateWindowSurface(g_EglDisplay, configs[0], g_NativeWindow, NULL);
-    if (g_EglSurface == NULL)
+    if (!backend->Probe())
     {
-        LOG(ERROR) << "g_EglSurface == EGL_NO_SURFACE eglGeterror = " << eglGetError();
+        delete backend;
         return OZONE_EGL_FAILURE;
     }
 
-    eglMakeCurrent(g_EglDisplay, g_EglSurface, g_EglSurface, g_EglContext);
-    if (EGL_SUCCESS != (err = eglGetError()))
+    if (!ozone_egl_setupBackend(backend))
     {
-        LOG(ERROR) << "Failed eglMakeCurrent. eglGetError = 0x%x\n" << err;
+        LOG(INFO) << "EGL backend " << entry->name << " is not usable";
+        ozone_egl_teardown();
         return OZONE_EGL_FAILURE;
     }
 
+    ozone_egl_updateRefreshInterval();
+    LOG(INFO) << "Using EGL backend " << entry->name << " ("
+              << g_State.windowWidth << "x" << g_State.windowHeight << ")";
+    if (g_State.transform != OZONE_EGL_TRANSFORM_NORMAL)
+        LOG(INFO) << "Display transform " << g_State.transform << " applied "
+                  << (g_State.presentTransform ? "in the present pass" : "at scanout");
+    if (g_State.refreshIntervalUsec)
+        LOG(INFO) << "Refresh interval " << g_State.refreshIntervalUsec << " us";
+    if (g_State.frontBuffer)
+        LOG(INFO) << "Rendering to the front buffer";
+    ozone_egl_publishTelemetryInfo();
     return OZONE_EGL_SUCCESS;
 }
 
+// Average cost of a full-screen clear and present on the current backend.
+static uint64_t ozone_egl_benchmarkCurrent()
+{
+    uint64_t start;
+    int i;
+
+    glViewport(0, 0, g_State.windowWidth, g_State.windowHeight);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ozone_egl_swap();
+
+    start = ozone_egl_nowUsec();
+    for (i = 0; i < OZONE_EGL_BENCHMARK_FRAMES; i++)
+    {
+        glClearColor((i & 1) ? 1.0f : 0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        ozone_egl_swap();
+    }
+    glFinish();
+    return (ozone_egl_nowUsec() - start) / OZONE_EGL_BENCHMARK_FRAMES;
+}
+
+// Brings up every usable display backend in turn, keeps the fastest one and
+// caches its name so the next start skips the benchmark. Headless backends
+// do no scanout, so they would always win; they are only a fallback.
+static EGLint ozone_egl_benchmarkBackends()
+{
+    const ozone_egl_BackendEntry* entries;
+    const ozone_egl_BackendEntry* best = NULL;
+    uint64_t best_usec = 0;
+    size_t count, i;
+
+    entries = ozone_egl_getBackends(&count);
+    for (i = 0; i < count; i++)
+    {
+        uint64_t usec;
+
+        if (!entries[i].display || !ozone_egl_tryBackend(&entries[i]))
+            continue;
+        usec = ozone_egl_benchmarkCurrent();
+        LOG(INFO) << "EGL backend " << entries[i].name << ": " << usec
+                  << " us/frame";
+        ozone_egl_destroy();
+
+        if (!best || usec < best_usec)
+        {
+            best = &entries[i];
+            best_usec = usec;
+        }
+    }
+
+    if (!best)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (!entries[i].display && ozone_egl_tryBackend(&entries[i]))
+                return OZONE_EGL_SUCCESS;
+        }
+        LOG(ERROR) << "No usable EGL backend";
+        return OZONE_EGL_FAILURE;
+    }
+
+    ozone_egl_cachePreferredBackend(best->name);
+    return ozone_egl_tryBackend(best);
+}
+
+EGLint ozone_egl_setup(EGLint x, EGLint y, EGLint width, EGLint height )
+{
+    const ozone_egl_BackendEntry* entries;
+    const char* preferred;
+    const char* benchmark;
+    size_t count, i;
+    ozone_egl_StateLock lock;
+
+    preferred = ozone_egl_getPreferredBackend();
+    benchmark = getenv("OZONE_EGL_BACKEND_BENCHMARK");
+    if (!preferred && benchmark && strcmp(benchmark, "0"))
+        return ozone_egl_benchmarkBackends();
+
+    entries = ozone_egl_getBackends(&count);
+    if (preferred)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (!strcmp(entries[i].name, preferred) &&
+                ozone_egl_tryBackend(&entries[i]))
+                return OZONE_EGL_SUCCESS;
+        }
+        LOG(WARNING) << "Preferred EGL backend " << preferred
+                     << " is unavailable, probing";
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (preferred && !strcmp(entries[i].name, preferred))
+            continue;
+        if (ozone_egl_tryBackend(&entries[i]))
+            return OZONE_EGL_SUCCESS;
+    }
+
+    LOG(ERROR) << "No usable EGL backend";
+    return OZONE_EGL_FAILURE;
+}
+
 int ozone_egl_destroy()
 {
 
     int s32Loop = 0;
+    ozone_egl_StateLock lock;
+
+    if (!g_State.display)
+        return OZONE_EGL_SUCCESS;
+    ozone_egl_makecurrent();
 
     /** clean double buffer  **/
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -230,57 +568,478 @@ int ozone_egl_destroy()
         ozone_egl_swap();
     }
 
-    eglMakeCurrent(g_EglDisplay, NULL, NULL, NULL);
+    ozone_egl_teardown();
+
+    return OZONE_EGL_SUCCESS;
+}
+
+int ozone_egl_swap()
+{
+    return ozone_egl_swapWithCallback(NULL, NULL);
+}
+
+int ozone_egl_swapWithCallback(ozone_egl_FlipCallback callback, void* data)
+{
+    uint64_t start;
+    ozone_egl_StateLock lock;
+
+    if (g_State.suspended || !g_State.surface)
+        return OZONE_EGL_FAILURE;
+
+    if (ozone_egl_bindLocked(g_State.surface, g_State.context))
+        ozone_egl_captureFrame(g_State.display, g_State.windowWidth,
+                               g_State.windowHeight);
+
+    // A single buffered surface has nothing to swap; the draws only need to
+    // reach the GPU.
+    start = ozone_egl_nowUsec();
+    if (g_State.frontBuffer)
+        OZONE_GL(glFlush)();
+    else
+        OZONE_GL(eglSwapBuffers)(g_State.display, g_State.surface);
+    g_State.swapUsec = ozone_egl_nowUsec() - start;
+    OZONE_GL_TRACE_END_FRAME();
+
+    g_State.lastFrameSwitches = g_State.frameSwitches;
+    g_State.lastFrameSkipped = g_State.frameSkipped;
+    g_State.frameSwitches = 0;
+    g_State.frameSkipped = 0;
+
+    return ozone_egl_present(callback, data);
+}
+
+int ozone_egl_present(ozone_egl_FlipCallback callback, void* data)
+{
+    int presented;
+    ozone_egl_StateLock lock;
+
+    g_State.lastPresentUsec = ozone_egl_nowUsec();
+    presented = g_State.backend && g_State.backend->Present(callback, data);
+
+    // GL surfaces of the GPU process swap outside the wrapper; their
+    // frames only count the backend's present.
+    ozone_egl_telemetryFrame(g_State.lastPresentUsec,
+                             g_State.swapUsec + ozone_egl_nowUsec() -
+                                 g_State.lastPresentUsec,
+                             g_State.lastFrameSwitches);
+    g_State.swapUsec = 0;
+    return presented ? OZONE_EGL_SUCCESS : OZONE_EGL_FAILURE;
+}
+
+uint64_t ozone_egl_suspend()
+{
+    EGLint buffer_size = 32;
+    ozone_egl_StateLock lock;
+
+    if (g_State.suspended || !g_State.surface)
+        return 0;
+
+    // The context and its objects stay; only the window buffers go.
+    eglGetConfigAttrib(g_State.display, g_State.config, EGL_BUFFER_SIZE, &buffer_size);
+    ozone_egl_bindLocked(EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    g_State.backend->DestroySurface(g_State.display, g_State.surface);
+    g_State.surface = NULL;
+    g_State.generation++;
+    g_State.suspended = 1;
+    ozone_egl_publishTelemetryInfo();
+
+    // Front and back buffer, or just the one being scanned out.
+    return (g_State.frontBuffer ? 1ull : 2ull) * g_State.windowWidth * g_State.windowHeight * (buffer_size / 8);
+}
+
+int ozone_egl_resume()
+{
+    ozone_egl_StateLock lock;
+
+    if (!g_State.suspended)
+        return OZONE_EGL_SUCCESS;
+
+    g_State.surface = ozone_egl_createSurface();
+    if (g_State.surface == EGL_NO_SURFACE)
+    {
+        LOG(ERROR) << "Failed to recreate the EGL surface: " << eglGetError();
+        g_State.surface = NULL;
+        return OZONE_EGL_FAILURE;
+    }
+    g_State.suspended = 0;
+    // Backends may take the cursor plane down with the scanout.
+    if (g_State.cursor.hardware)
+    {
+        g_State.backend->SetCursor(g_State.cursor.pixels, g_State.cursor.width,
+                                   g_State.cursor.height);
+        g_State.backend->MoveCursor(g_State.cursor.x - g_State.cursor.hot_x,
+                                    g_State.cursor.y - g_State.cursor.hot_y);
+    }
+    ozone_egl_publishTelemetryInfo();
+    ozone_egl_makecurrent();
+    return OZONE_EGL_SUCCESS;
+}
+
+int ozone_egl_getVSyncParameters(uint64_t* timebase, uint64_t* interval)
+{
+    ozone_egl_StateLock lock;
+
+    if (g_State.backend && g_State.backend->GetVSyncParameters(timebase, interval))
+        return OZONE_EGL_SUCCESS;
+
+    // Without flip events, assume swaps complete in phase with the output's
+    // refresh.
+    if (!g_State.refreshIntervalUsec || !g_State.lastPresentUsec)
+        return OZONE_EGL_FAILURE;
+    *timebase = g_State.lastPresentUsec;
+    *interval = g_State.refreshIntervalUsec;
+    return OZONE_EGL_SUCCESS;
+}
+
+// Size of the screen Chromium draws, in pixels. Call with the lock held.
+static void ozone_egl_screenSize(int* width, int* height)
+{
+    int swap = ozone_egl_transformSwapsAxes(g_State.presentTransform);
+
+    *width = swap ? g_State.windowHeight : g_State.windowWidth;
+    *height = swap ? g_State.windowWidth : g_State.windowHeight;
+}
 
-    if (g_EglContext)
+// Maps clip-space positions of the screen onto the window surface, in place.
+// Call with the lock held.
+static void ozone_egl_transformVertices(GLfloat* vertices, int count, int stride)
+{
+    int i;
+
+    if (g_State.presentTransform == OZONE_EGL_TRANSFORM_NORMAL)
+        return;
+
+    for (i = 0; i < count; i++, vertices += stride)
     {
-        eglDestroyContext(g_EglDisplay, g_EglContext);
+        GLfloat x = vertices[0];
+        GLfloat y = vertices[1];
+
+        if (g_State.presentTransform & OZONE_EGL_TRANSFORM_FLIP_H)
+            x = -x;
+        switch (g_State.presentTransform & OZONE_EGL_TRANSFORM_ROTATION_MASK)
+        {
+        case OZONE_EGL_TRANSFORM_ROT_90:
+            vertices[0] = y;
+            vertices[1] = -x;
+            break;
+        case OZONE_EGL_TRANSFORM_ROT_180:
+            vertices[0] = -x;
+            vertices[1] = -y;
+            break;
+        case OZONE_EGL_TRANSFORM_ROT_270:
+            vertices[0] = -y;
+            vertices[1] = x;
+            break;
+        default:
+            vertices[0] = x;
+            vertices[1] = y;
+            break;
+        }
     }
+}
 
-    if (g_EglSurface)
+// Maps a rectangle in screen pixels to window pixels. Call with the lock
+// held.
+static void ozone_egl_transformRect(int* x, int* y, int* width, int* height)
+{
+    int screen_width, screen_height;
+    int rx = *x;
+    int ry = *y;
+
+    ozone_egl_screenSize(&screen_width, &screen_height);
+    if (g_State.presentTransform & OZONE_EGL_TRANSFORM_FLIP_H)
+        rx = screen_width - rx - *width;
+    switch (g_State.presentTransform & OZONE_EGL_TRANSFORM_ROTATION_MASK)
+    {
+    case OZONE_EGL_TRANSFORM_ROT_90:
+        *x = screen_height - ry - *height;
+        *y = rx;
+        break;
+    case OZONE_EGL_TRANSFORM_ROT_180:
+        *x = screen_width - rx - *width;
+        *y = screen_height - ry - *height;
+        break;
+    case OZONE_EGL_TRANSFORM_ROT_270:
+        *x = ry;
+        *y = screen_width - rx - *width;
+        break;
+    default:
+        *x = rx;
+        *y = ry;
+        break;
+    }
+    if (ozone_egl_transformSwapsAxes(g_State.presentTransform))
     {
-        eglDestroySurface(g_EglDisplay, g_EglSurface);
+        int swap = *width;
+        *width = *height;
+        *height = swap;
     }
+}
 
-    eglTerminate(g_EglDisplay);
+int ozone_egl_getOutputs(ozone_egl_Output* outputs, int max_outputs)
+{
+    int count, i;
+    ozone_egl_StateLock lock;
 
-    //ozone_egl_nativeDestroyWindow(g_NativeWindow);
-    ozone_egl_nativeDestroyDisplay(g_NativeDisplay);
+    if (!g_State.backend || max_outputs < 1)
+        return 0;
+    count = g_State.backend->GetOutputs(outputs, max_outputs);
+    if (count > 0)
+    {
+        // The transform only applies to the output the wrapper draws on.
+        if (ozone_egl_transformSwapsAxes(g_State.transform))
+        {
+            int swap = outputs->widthMm;
+            outputs->widthMm = outputs->heightMm;
+            outputs->heightMm = swap;
+            for (i = 0; i < outputs->modeCount; i++)
+            {
+                swap = outputs->modes[i].width;
+                outputs->modes[i].width = outputs->modes[i].height;
+                outputs->modes[i].height = swap;
+            }
+        }
+        return count;
+    }
 
-    return OZONE_EGL_SUCCESS;
+    memset(outputs, 0, sizeof(*outputs));
+    snprintf(outputs->name, sizeof(outputs->name), "%s", g_State.backend->GetName());
+    outputs->modeCount = 1;
+    ozone_egl_screenSize(&outputs->modes[0].width, &outputs->modes[0].height);
+    return 1;
 }
 
-int ozone_egl_swap()
+int ozone_egl_getTransform()
 {
-    eglSwapBuffers(g_EglDisplay, g_EglSurface);
+    ozone_egl_StateLock lock;
+    return g_State.transform;
+}
 
-    return OZONE_EGL_SUCCESS;
+void ozone_egl_panelToScreen(float* x, float* y)
+{
+    ozone_egl_StateLock lock;
+    float px = *x;
+    float py = *y;
+    float screen_width = ozone_egl_transformSwapsAxes(g_State.transform)
+        ? g_State.panelHeight : g_State.panelWidth;
+
+    // Undoes the rotation, then the flip.
+    switch (g_State.transform & OZONE_EGL_TRANSFORM_ROTATION_MASK)
+    {
+    case OZONE_EGL_TRANSFORM_ROT_90:
+        *x = py;
+        *y = g_State.panelWidth - px;
+        break;
+    case OZONE_EGL_TRANSFORM_ROT_180:
+        *x = g_State.panelWidth - px;
+        *y = g_State.panelHeight - py;
+        break;
+    case OZONE_EGL_TRANSFORM_ROT_270:
+        *x = g_State.panelHeight - py;
+        *y = px;
+        break;
+    }
+    if (g_State.transform & OZONE_EGL_TRANSFORM_FLIP_H)
+        *x = screen_width - *x;
+}
+
+int ozone_egl_getPresentFlags()
+{
+    ozone_egl_StateLock lock;
+    if (!g_State.backend)
+        return 0;
+    // Front buffer draws show up wherever the scanout happens to be.
+    if (g_State.frontBuffer)
+        return g_State.backend->GetPresentFlags() & ~OZONE_EGL_PRESENT_VSYNC;
+    return g_State.backend->GetPresentFlags();
+}
+
+int ozone_egl_isFrontBuffer()
+{
+    ozone_egl_StateLock lock;
+    return g_State.frontBuffer;
+}
+
+const char* ozone_egl_getBackendName()
+{
+    ozone_egl_StateLock lock;
+    return g_State.backend ? g_State.backend->GetName() : NULL;
+}
+
+int ozone_egl_cursorSetImage(const void* pixels, int width, int height,
+                             int stride, int hot_x, int hot_y)
+{
+    int y;
+    ozone_egl_StateLock lock;
+
+    free(g_State.cursor.pixels);
+    g_State.cursor.pixels = NULL;
+    g_State.cursor.width = 0;
+    g_State.cursor.height = 0;
+    g_State.cursor.dirty = 1;
+
+    if (pixels && width > 0 && height > 0)
+    {
+        g_State.cursor.pixels = (uint8_t*)malloc(width * height * 4);
+        if (!g_State.cursor.pixels)
+            return OZONE_EGL_FAILURE;
+        for (y = 0; y < height; y++)
+            memcpy(g_State.cursor.pixels + y * width * 4,
+                   (const uint8_t*)pixels + y * stride, width * 4);
+        g_State.cursor.width = width;
+        g_State.cursor.height = height;
+        g_State.cursor.hot_x = hot_x;
+        g_State.cursor.hot_y = hot_y;
+    }
+
+    // Cursor planes are positioned and drawn in panel orientation; with a
+    // transform the cursor goes through the present pass like the canvas.
+    g_State.cursor.hardware = g_State.backend &&
+        g_State.transform == OZONE_EGL_TRANSFORM_NORMAL &&
+        g_State.backend->SetCursor(g_State.cursor.pixels, g_State.cursor.width, g_State.cursor.height);
+    ozone_egl_publishTelemetryInfo();
+    if (g_State.cursor.hardware)
+    {
+        g_State.backend->MoveCursor(g_State.cursor.x - g_State.cursor.hot_x,
+                              g_State.cursor.y - g_State.cursor.hot_y);
+        return OZONE_EGL_SUCCESS;
+    }
+    return OZONE_EGL_FAILURE;
+}
+
+int ozone_egl_cursorMove(int x, int y)
+{
+    ozone_egl_StateLock lock;
+
+    g_State.cursor.x = x;
+    g_State.cursor.y = y;
+
+    if (g_State.cursor.hardware)
+        return g_State.backend->MoveCursor(x - g_State.cursor.hot_x, y - g_State.cursor.hot_y)
+            ? OZONE_EGL_SUCCESS : OZONE_EGL_FAILURE;
+    // A hidden software cursor needs no redraw.
+    return g_State.cursor.pixels ? OZONE_EGL_FAILURE : OZONE_EGL_SUCCESS;
+}
+
+static GLfloat ozone_egl_canvasExtent(const ozone_egl_UserData* userData);
+
+// Blends the software cursor over the frame as a single small quad, using
+// the content program. Call with the lock held.
+static void ozone_egl_cursorDraw(ozone_egl_UserData* userData)
+{
+    GLfloat left, top, right, bottom, extent;
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+
+    g_State.cursor.drawnWidth = 0;
+    if (g_State.cursor.hardware || !g_State.cursor.pixels ||
+        !userData->width || !userData->height)
+        return;
+
+    if (!g_State.cursor.textureId)
+    {
+        OZONE_GL(glGenTextures)(1, &g_State.cursor.textureId);
+        OZONE_GL(glBindTexture)(GL_TEXTURE_2D, g_State.cursor.textureId);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        g_State.cursor.dirty = 1;
+    }
+    else
+    {
+        OZONE_GL(glBindTexture)(GL_TEXTURE_2D, g_State.cursor.textureId);
+    }
+    OZONE_GL_STATE("texture", g_State.cursor.textureId);
+
+    if (g_State.cursor.dirty)
+    {
+        OZONE_GL(glTexImage2D)(GL_TEXTURE_2D, 0, userData->colorType,
+                               g_State.cursor.width, g_State.cursor.height, 0,
+                               userData->colorType, GL_UNSIGNED_BYTE,
+                               g_State.cursor.pixels);
+        OZONE_GL_UPLOAD_BYTES(g_State.cursor.width * g_State.cursor.height * 4);
+        ozone_egl_telemetryUpload(g_State.cursor.width * g_State.cursor.height * 4);
+        g_State.cursor.dirty = 0;
+    }
+
+    // Same mapping as the content quad in ozone_egl_textureDraw().
+    extent = ozone_egl_canvasExtent(userData);
+    left = -extent + 2 * extent * (g_State.cursor.x - g_State.cursor.hot_x) / userData->width;
+    right = left + 2 * extent * g_State.cursor.width / userData->width;
+    top = extent - 2 * extent * (g_State.cursor.y - g_State.cursor.hot_y) / userData->height;
+    bottom = top - 2 * extent * g_State.cursor.height / userData->height;
+
+    GLfloat vVertices[] = { left,  top,    0.0f, 0.0f, 0.0f,
+                            left,  bottom, 0.0f, 0.0f, 1.0f,
+                            right, bottom, 0.0f, 1.0f, 1.0f,
+                            right, top,    0.0f, 1.0f, 0.0f };
+    ozone_egl_transformVertices(vVertices, 4, 5);
+
+    OZONE_GL(glVertexAttribPointer)(userData->positionLoc, 3, GL_FLOAT,
+                                    GL_FALSE, 5 * sizeof(GLfloat), vVertices);
+    OZONE_GL(glVertexAttribPointer)(userData->texCoordLoc, 2, GL_FLOAT,
+                                    GL_FALSE, 5 * sizeof(GLfloat), &vVertices[3]);
+
+    OZONE_GL(glEnable)(GL_BLEND);
+    OZONE_GL(glBlendFunc)(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    OZONE_GL(glDrawElements)(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
+    OZONE_GL(glDisable)(GL_BLEND);
+
+    g_State.cursor.drawnX = g_State.cursor.x - g_State.cursor.hot_x;
+    g_State.cursor.drawnY = g_State.cursor.y - g_State.cursor.hot_y;
+    g_State.cursor.drawnWidth = g_State.cursor.width;
+    g_State.cursor.drawnHeight = g_State.cursor.height;
 }
 
 NativeDisplayType ozone_egl_getNativedisp()
 {
-    return g_NativeDisplay;
+    ozone_egl_StateLock lock;
+    return g_State.nativeDisplay;
 }
 
-EGLint * ozone_egl_getConfigAttribs()
+const EGLint * ozone_egl_getConfigAttribs()
 {
-    return g_configAttribs;
+    ozone_egl_StateLock lock;
+    return g_State.backend ? g_State.backend->GetConfigAttribs()
+                     : ozone_egl_getDefaultConfigAttribs();
 }
 
 EGLDisplay ozone_egl_getdisp()
 {
-    return g_EglDisplay;
+    ozone_egl_StateLock lock;
+    return g_State.display;
 }
 
 EGLSurface ozone_egl_getsurface()
 {
-    return g_EglSurface;
+    ozone_egl_StateLock lock;
+    return g_State.surface;
+}
+
+
+int ozone_egl_makecurrent()
+{
+    ozone_egl_StateLock lock;
+
+    if (!g_State.context)
+        return OZONE_EGL_FAILURE;
+    return ozone_egl_bindLocked(g_State.surface, g_State.context);
 }
 
+void ozone_egl_releasecurrent()
+{
+    ozone_egl_StateLock lock;
+
+    if (g_State.display)
+        ozone_egl_bindLocked(EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
 
-void ozone_egl_makecurrent()
+void ozone_egl_getMakeCurrentStats(uint32_t* switches, uint32_t* skipped)
 {
-    eglMakeCurrent(g_EglDisplay, g_EglSurface, g_EglSurface, g_EglContext);
+    ozone_egl_StateLock lock;
+
+    *switches = g_State.lastFrameSwitches;
+    *skipped = g_State.lastFrameSkipped;
 }
 
 GLuint ozone_egl_loadShader ( GLenum type, const char *shaderSrc )
@@ -350,7 +1109,11 @@ GLuint ozone_egl_loadProgram ( const char *vertShaderSrc, const char *fragShader
    programObject = glCreateProgram ( );
    
    if ( programObject == 0 )
+   {
+      glDeleteShader( vertexShader );
+      glDeleteShader( fragmentShader );
       return 0;
+   }
 
    glAttachShader ( programObject, vertexShader );
    glAttachShader ( programObject, fragmentShader );
@@ -378,6 +1141,8 @@ GLuint ozone_egl_loadProgram ( const char *vertShaderSrc, const char *fragShader
       }
 
       glDeleteProgram ( programObject );
+      glDeleteShader ( vertexShader );
+      glDeleteShader ( fragmentShader );
       return 0;
    }
 
@@ -390,6 +1155,385 @@ GLuint ozone_egl_loadProgram ( const char *vertShaderSrc, const char *fragShader
 
 
 
+// Re-creates the canvas program from the binary cached on release, which
+// skips the shader compiler when resuming.
+static GLuint ozone_egl_loadCachedProgram(const char* vertShaderSrc,
+                                          const char* fragShaderSrc)
+{
+    PFNGLPROGRAMBINARYOESPROC programBinary;
+    GLuint program;
+    GLint linked = 0;
+    ozone_egl_StateLock lock;
+
+    if (g_State.programBinary)
+    {
+        programBinary = (PFNGLPROGRAMBINARYOESPROC)
+            eglGetProcAddress("glProgramBinaryOES");
+        program = OZONE_GL(glCreateProgram)();
+        if (programBinary && program)
+        {
+            programBinary(program, g_State.programBinaryFormat, g_State.programBinary,
+                          g_State.programBinarySize);
+            OZONE_GL(glGetProgramiv)(program, GL_LINK_STATUS, &linked);
+        }
+        if (linked)
+            return program;
+
+        // Drivers may reject their own binaries, e.g. after an update.
+        OZONE_GL(glDeleteProgram)(program);
+        free(g_State.programBinary);
+        g_State.programBinary = NULL;
+        g_State.programBinarySize = 0;
+    }
+    return ozone_egl_loadProgram(vertShaderSrc, fragShaderSrc);
+}
+
+static void ozone_egl_cacheProgramBinary(GLuint program)
+{
+    PFNGLGETPROGRAMBINARYOESPROC getProgramBinary;
+    const char* extensions;
+    GLint length = 0;
+    ozone_egl_StateLock lock;
+
+    if (g_State.programBinary || !program)
+        return;
+    extensions = (const char*)OZONE_GL(glGetString)(GL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "GL_OES_get_program_binary"))
+        return;
+    getProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)
+        eglGetProcAddress("glGetProgramBinaryOES");
+    OZONE_GL(glGetProgramiv)(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (!getProgramBinary || length <= 0)
+        return;
+
+    g_State.programBinary = malloc(length);
+    getProgramBinary(program, length, &g_State.programBinarySize,
+                     &g_State.programBinaryFormat, g_State.programBinary);
+    if (g_State.programBinarySize <= 0)
+    {
+        free(g_State.programBinary);
+        g_State.programBinary = NULL;
+        g_State.programBinarySize = 0;
+    }
+}
+
+// Bytes per pixel of |data|.
+static int ozone_egl_bytesPerPixel(const ozone_egl_UserData* userData)
+{
+    return userData->colorType == GL_RGB ? 3 : 4;
+}
+
+// Opaque canvases drop the alpha channel when packing and upload GL_RGB.
+static int ozone_egl_dropsAlpha(const ozone_egl_UserData* userData)
+{
+    return userData->opaque && userData->colorType != GL_RGB;
+}
+
+// Render targets need a colour-renderable format, which only GL_RGBA is on
+// every GLES2 driver.
+static GLenum ozone_egl_uploadFormat(const ozone_egl_UserData* userData)
+{
+    if (userData->renderTarget)
+        return GL_RGBA;
+    return userData->opaque ? GL_RGB : userData->colorType;
+}
+
+static int ozone_egl_uploadBytesPerPixel(const ozone_egl_UserData* userData)
+{
+    if (userData->renderTarget)
+        return 4;
+    return userData->opaque ? 3 : ozone_egl_bytesPerPixel(userData);
+}
+
+// Half the extent of the canvas quad in clip space. Translucent canvases
+// are inset and keep a cleared border.
+static GLfloat ozone_egl_canvasExtent(const ozone_egl_UserData* userData)
+{
+    return userData->opaque ? 1.0f : 0.96f;
+}
+
+static GLint ozone_egl_tileSize()
+{
+    GLint max_size = 0;
+    GLint size = OZONE_EGL_DEFAULT_TILE_SIZE;
+    const char* env = getenv("OZONE_EGL_TILE_SIZE");
+
+    if (env && atoi(env) > 0)
+        size = atoi(env);
+    OZONE_GL(glGetIntegerv)(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (max_size > 0 && size > max_size)
+        size = max_size;
+    return size;
+}
+
+// Tiles can be uploaded straight out of |data| only if their rows are
+// contiguous there and in the upload format.
+static int ozone_egl_tilesNeedPacking(const ozone_egl_UserData* userData)
+{
+    int row_bytes = userData->width * ozone_egl_bytesPerPixel(userData);
+    return userData->tileCols > 1 || ozone_egl_dropsAlpha(userData) ||
+           (userData->stride && userData->stride != row_bytes);
+}
+
+static const char* ozone_egl_tilePixels(const ozone_egl_UserData* userData,
+                                        const ozone_egl_Tile* tile)
+{
+    int bpp = ozone_egl_bytesPerPixel(userData);
+    int stride = userData->stride ? userData->stride : userData->width * bpp;
+
+    return userData->data + tile->texY * stride + tile->texX * bpp;
+}
+
+// Allocates the packed copy of |tile| on its first pack. On failure the
+// tile stays damaged for the next draw to retry, and forgets its hash so
+// that the retry does not take it for unchanged.
+static int ozone_egl_allocPacked(ozone_egl_Tile* tile, int size)
+{
+    if (!tile->packed)
+        tile->packed = (char*)malloc(size);
+    if (!tile->packed)
+    {
+        LOG(ERROR) << "Out of memory packing a " << tile->texWidth << "x"
+                   << tile->texHeight << " tile";
+        tile->hashValid = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void ozone_egl_texturePackTile(ozone_egl_UserData* userData, int index)
+{
+    ozone_egl_Tile* tile = &userData->tiles[index];
+    int bpp = ozone_egl_bytesPerPixel(userData);
+    int stride = userData->stride ? userData->stride : userData->width * bpp;
+    int row_bytes = tile->texWidth * bpp;
+    int packed_row_bytes = tile->texWidth * ozone_egl_uploadBytesPerPixel(userData);
+    const char* src;
+    int row;
+
+    if (tile->state != OZONE_EGL_TILE_DAMAGED || !userData->data)
+        return;
+
+    if (userData->hashTiles)
+    {
+        uint64_t start = ozone_egl_nowUsec();
+        uint64_t hash = ozone_egl_hashPixels(ozone_egl_tilePixels(userData, tile),
+                                             row_bytes, tile->texHeight, stride);
+
+        tile->hashUsec = ozone_egl_nowUsec() - start;
+        tile->hashTaken = 1;
+        tile->hashUnchanged = tile->hashValid && tile->hash == hash;
+        if (tile->hashUnchanged)
+        {
+            tile->state = OZONE_EGL_TILE_CLEAN;
+            return;
+        }
+        tile->hash = hash;
+        tile->hashValid = 1;
+    }
+
+    if (ozone_egl_dropsAlpha(userData))
+    {
+        // BGRA or RGBA to RGB
+        if (!ozone_egl_allocPacked(tile, packed_row_bytes * tile->texHeight))
+            return;
+        src = ozone_egl_tilePixels(userData, tile);
+        for (row = 0; row < tile->texHeight; row++)
+            ozone_egl_packRgb(src + row * stride,
+                              tile->packed + row * packed_row_bytes,
+                              tile->texWidth, userData->colorType != GL_RGBA);
+    }
+    else if (ozone_egl_tilesNeedPacking(userData))
+    {
+        if (!ozone_egl_allocPacked(tile, row_bytes * tile->texHeight))
+            return;
+        src = ozone_egl_tilePixels(userData, tile);
+        for (row = 0; row < tile->texHeight; row++)
+            memcpy(tile->packed + row * row_bytes, src + row * stride, row_bytes);
+    }
+    tile->state = OZONE_EGL_TILE_PACKED;
+}
+
+// Sets |first| and |last|, inclusive (column, row) pairs, to the tiles a
+// canvas rectangle touches. Returns 0 if it touches none.
+static int ozone_egl_tileRange(const ozone_egl_UserData* userData,
+                               int x, int y, int width, int height,
+                               int first[2], int last[2])
+{
+    int right = x + width;
+    int bottom = y + height;
+
+    if (!userData->tiles)
+        return 0;
+
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (right > userData->width)
+        right = userData->width;
+    if (bottom > userData->height)
+        bottom = userData->height;
+    if (x >= right || y >= bottom)
+        return 0;
+
+    // All tiles but the last row and column have the first tile's size.
+    first[0] = x / userData->tiles[0].width;
+    first[1] = y / userData->tiles[0].height;
+    last[0] = (right - 1) / userData->tiles[0].width;
+    last[1] = (bottom - 1) / userData->tiles[0].height;
+    return 1;
+}
+
+void ozone_egl_textureDamage(ozone_egl_UserData* userData,
+                             int x, int y, int width, int height)
+{
+    int first[2], last[2];
+    int col, row;
+
+    // Neighbouring textures hold the pixels next to the rectangle as their
+    // border.
+    if (!ozone_egl_tileRange(userData, x - 1, y - 1, width + 2, height + 2,
+                             first, last))
+        return;
+
+    for (row = first[1]; row <= last[1]; row++)
+    {
+        for (col = first[0]; col <= last[0]; col++)
+        {
+            userData->tiles[row * userData->tileCols + col].state =
+                OZONE_EGL_TILE_DAMAGED;
+        }
+    }
+}
+
+// Marks the tiles under a canvas rectangle for the next front buffer draw.
+static void ozone_egl_textureStale(ozone_egl_UserData* userData,
+                                   int x, int y, int width, int height)
+{
+    int first[2], last[2];
+    int col, row;
+
+    if (!ozone_egl_tileRange(userData, x, y, width, height, first, last))
+        return;
+
+    for (row = first[1]; row <= last[1]; row++)
+    {
+        for (col = first[0]; col <= last[0]; col++)
+            userData->tiles[row * userData->tileCols + col].stale = 1;
+    }
+}
+
+// First tile row to draw into the front buffer: the first one the scanout
+// has not reached with OZONE_EGL_FRONT_BUFFER_LEAD_USEC to spare. Rows are
+// then drawn ahead of the beam, and the rows it is crossing or has just
+// passed come last, to show up whole on the next refresh. Without scanout
+// timing, or when the canvas rows do not run down the panel, rows are
+// drawn top to bottom. Call with the lock held.
+static int ozone_egl_frontBufferStartRow(const ozone_egl_UserData* userData)
+{
+    uint64_t timebase, interval, phase;
+    GLfloat extent, beam, canvasY;
+    int row;
+
+    if (g_State.transform != OZONE_EGL_TRANSFORM_NORMAL ||
+        !g_State.backend->GetVSyncParameters(&timebase, &interval) ||
+        !interval)
+        return 0;
+
+    phase = (ozone_egl_nowUsec() % interval + interval - timebase % interval +
+             OZONE_EGL_FRONT_BUFFER_LEAD_USEC) % interval;
+    // Vertical blanking is short enough to leave out.
+    beam = (GLfloat)phase / interval * g_State.windowHeight;
+    extent = ozone_egl_canvasExtent(userData);
+    canvasY = (beam - (1.0f - extent) / 2 * g_State.windowHeight) *
+              userData->height / (extent * g_State.windowHeight);
+    if (canvasY <= 0.0f)
+        return 0;
+    row = ((int)canvasY + userData->tiles[0].height - 1) / userData->tiles[0].height;
+    return row < userData->tileRows ? row : 0;
+}
+
+// Returns non-zero if the tile changed on screen.
+static int ozone_egl_uploadTile(ozone_egl_UserData* userData,
+                                ozone_egl_Tile* tile)
+{
+    const char* pixels;
+
+    if (tile->state == OZONE_EGL_TILE_DAMAGED)
+    {
+        ozone_egl_texturePackTile(userData, tile - userData->tiles);
+        // Unchanged, or still damaged without memory to pack it
+        if (tile->state != OZONE_EGL_TILE_PACKED)
+            return 0;
+    }
+
+    pixels = ozone_egl_tilesNeedPacking(userData) ?
+        tile->packed : ozone_egl_tilePixels(userData, tile);
+    OZONE_GL(glBindTexture)(GL_TEXTURE_2D, tile->textureId);
+    OZONE_GL(glTexSubImage2D)(GL_TEXTURE_2D, 0, 0, 0, tile->texWidth,
+                              tile->texHeight, ozone_egl_uploadFormat(userData),
+                              GL_UNSIGNED_BYTE, pixels);
+    OZONE_GL_UPLOAD_BYTES(tile->texWidth * tile->texHeight *
+                          ozone_egl_uploadBytesPerPixel(userData));
+    ozone_egl_telemetryUpload(tile->texWidth * tile->texHeight *
+                              ozone_egl_uploadBytesPerPixel(userData));
+    userData->uploadBytes += tile->texWidth * tile->texHeight *
+                             ozone_egl_uploadBytesPerPixel(userData);
+    tile->state = OZONE_EGL_TILE_CLEAN;
+    return 1;
+}
+
+// Reports a canvas rectangle to the capture in window pixels, through the
+// quad mapping of ozone_egl_textureDraw(). Call with the lock held.
+static void ozone_egl_captureCanvasDamage(const ozone_egl_UserData* userData,
+                                          int x, int y, int width, int height)
+{
+    GLfloat extent = ozone_egl_canvasExtent(userData);
+    int screen_width, screen_height;
+    ozone_egl_screenSize(&screen_width, &screen_height);
+    float scale_x = extent * screen_width / userData->width;
+    float scale_y = extent * screen_height / userData->height;
+    float left = (1.0f - extent) / 2 * screen_width + x * scale_x;
+    float top = (1.0f - extent) / 2 * screen_height + y * scale_y;
+    int damage_x = (int)left;
+    int damage_y = (int)top;
+    // Linear filtering reaches one pixel beyond the quad.
+    int damage_width = (int)(left + width * scale_x) - damage_x + 3;
+    int damage_height = (int)(top + height * scale_y) - damage_y + 3;
+
+    damage_x -= 1;
+    damage_y -= 1;
+    ozone_egl_transformRect(&damage_x, &damage_y, &damage_width, &damage_height);
+    ozone_egl_captureDamage(damage_x, damage_y, damage_width, damage_height);
+}
+
+// Folds the hashes taken since the last draw into the totals.
+static void ozone_egl_collectHashStats(ozone_egl_UserData* userData)
+{
+    ozone_egl_TileHashStats* stats = &userData->hashStats;
+    int i;
+
+    for (i = 0; i < userData->tileCols * userData->tileRows; i++)
+    {
+        ozone_egl_Tile* tile = &userData->tiles[i];
+        uint64_t bytes = (uint64_t)tile->texWidth * tile->texHeight *
+                         ozone_egl_uploadBytesPerPixel(userData);
+
+        if (!tile->hashTaken)
+            continue;
+        stats->tilesHashed++;
+        stats->bytesHashed += bytes;
+        stats->hashUsec += tile->hashUsec;
+        if (tile->hashUnchanged)
+        {
+            stats->tilesSkipped++;
+            stats->bytesSaved += bytes;
+        }
+        tile->hashTaken = 0;
+    }
+}
+
 int ozone_egl_textureInit (ozone_egl_UserData * userData )
 {
    GLbyte vShaderStr[] =  
@@ -410,88 +1554,700 @@ int ozone_egl_textureInit (ozone_egl_UserData * userData )
       "{                                                   \n"
       "  gl_FragColor = texture2D( s_texture, v_texCoord );\n"
       "}                                                   \n";
+   const char* hash;
+   GLint tileSize;
+   int i;
       
+   if ( !ozone_egl_makecurrent() )
+      return GL_FALSE;
 
    // Load the shaders and get a linked program object
-   userData->programObject = ozone_egl_loadProgram ( (const char *)vShaderStr, (const char*)fShaderStr );
+   userData->programObject = ozone_egl_loadCachedProgram ( (const char *)vShaderStr, (const char*)fShaderStr );
 
    // Get the attribute locations
-   userData->positionLoc = glGetAttribLocation ( userData->programObject, "a_position" );
-   userData->texCoordLoc = glGetAttribLocation ( userData->programObject, "a_texCoord" );
+   userData->positionLoc = OZONE_GL(glGetAttribLocation) ( userData->programObject, "a_position" );
+   userData->texCoordLoc = OZONE_GL(glGetAttribLocation) ( userData->programObject, "a_texCoord" );
    
    // Get the sampler location
-   userData->samplerLoc = glGetUniformLocation ( userData->programObject, "s_texture" );
-   
-   // Load the texture
-   glGenTextures ( 1, &(userData->textureId) );
-   glBindTexture ( GL_TEXTURE_2D, userData->textureId );
-   
-   printf("-----glTexImage2D %d %d %d\n",userData->colorType, userData->width,userData->height);
-   glTexImage2D ( GL_TEXTURE_2D, 0, userData->colorType, userData->width, userData->height, 0, userData->colorType, GL_UNSIGNED_BYTE, NULL );
+   userData->samplerLoc = OZONE_GL(glGetUniformLocation) ( userData->programObject, "s_texture" );
    
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+   // Split the canvas into textures the GPU can hold. A render target has
+   // to be a single texture.
+   tileSize = ozone_egl_tileSize();
+   if (userData->renderTarget)
+   {
+      GLint max_size = 0;
 
-   glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
+      OZONE_GL(glGetIntegerv) ( GL_MAX_TEXTURE_SIZE, &max_size );
+      if (userData->width <= max_size && userData->height <= max_size)
+         tileSize = userData->width > userData->height ? userData->width : userData->height;
+      else
+         userData->renderTarget = 0;
+   }
+   userData->tileCols = (userData->width + tileSize - 1) / tileSize;
+   userData->tileRows = (userData->height + tileSize - 1) / tileSize;
+   userData->tiles = (ozone_egl_Tile*)calloc(
+       userData->tileCols * userData->tileRows, sizeof(ozone_egl_Tile));
+   if (!userData->tiles)
+   {
+      LOG(ERROR) << "Out of memory for " << userData->tileCols << "x"
+                 << userData->tileRows << " canvas tiles";
+      userData->tileCols = 0;
+      userData->tileRows = 0;
+      OZONE_GL(glDeleteProgram) ( userData->programObject );
+      userData->programObject = 0;
+      return GL_FALSE;
+   }
+   VLOG(1) << "Canvas " << userData->width << "x" << userData->height
+           << " in " << userData->tileCols << "x" << userData->tileRows
+           << " tiles";
+   for (i = 0; i < userData->tileCols * userData->tileRows; i++)
+   {
+      ozone_egl_Tile* tile = &userData->tiles[i];
+
+      tile->x = (i % userData->tileCols) * tileSize;
+      tile->y = (i / userData->tileCols) * tileSize;
+      tile->width = userData->width - tile->x < tileSize ? userData->width - tile->x : tileSize;
+      tile->height = userData->height - tile->y < tileSize ? userData->height - tile->y : tileSize;
+      tile->texX = tile->x > 0 ? tile->x - 1 : 0;
+      tile->texY = tile->y > 0 ? tile->y - 1 : 0;
+      tile->texWidth = (tile->x + tile->width < userData->width ? tile->x + tile->width + 1 : userData->width) - tile->texX;
+      tile->texHeight = (tile->y + tile->height < userData->height ? tile->y + tile->height + 1 : userData->height) - tile->texY;
+
+      // Load the texture
+      OZONE_GL(glGenTextures) ( 1, &tile->textureId );
+      OZONE_GL(glBindTexture) ( GL_TEXTURE_2D, tile->textureId );
+      OZONE_GL(glTexImage2D) ( GL_TEXTURE_2D, 0, ozone_egl_uploadFormat(userData), tile->texWidth, tile->texHeight, 0, ozone_egl_uploadFormat(userData), GL_UNSIGNED_BYTE, NULL );
+
+      OZONE_GL(glTexParameteri) ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+      OZONE_GL(glTexParameteri) ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+      OZONE_GL(glTexParameteri) ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+      OZONE_GL(glTexParameteri) ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+   }
+   userData->textureId = userData->tiles[0].textureId;
+   hash = getenv("OZONE_EGL_TILE_HASH");
+   userData->hashTiles = hash && strcmp(hash, "0");
+   memset(&userData->hashStats, 0, sizeof(userData->hashStats));
+   userData->uploadBytes = 0;
+   ozone_egl_textureDamage(userData, 0, 0, userData->width, userData->height);
+
+   OZONE_GL(glClearColor) ( 0.0f, 0.0f, 0.0f, 0.0f );
    return GL_TRUE;
 }
 
 
+// Puts back the GL state the present pass relies on after a renderer
+// such as Skia drew into the canvas render target on the same context.
+static void ozone_egl_resetRenderState(const ozone_egl_UserData* userData)
+{
+    GLint attribs = 0;
+    GLint i;
+
+    OZONE_GL(glBindFramebuffer)(GL_FRAMEBUFFER, 0);
+    OZONE_GL(glBindBuffer)(GL_ARRAY_BUFFER, 0);
+    OZONE_GL(glBindBuffer)(GL_ELEMENT_ARRAY_BUFFER, 0);
+    OZONE_GL(glDisable)(GL_SCISSOR_TEST);
+    OZONE_GL(glDisable)(GL_STENCIL_TEST);
+    OZONE_GL(glDisable)(GL_DEPTH_TEST);
+    OZONE_GL(glDisable)(GL_CULL_FACE);
+    OZONE_GL(glColorMask)(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    OZONE_GL(glClearColor)(0.0f, 0.0f, 0.0f, 0.0f);
+    OZONE_GL(glPixelStorei)(GL_UNPACK_ALIGNMENT, 4);
+    // Arrays left enabled would be fetched from client memory.
+    OZONE_GL(glGetIntegerv)(GL_MAX_VERTEX_ATTRIBS, &attribs);
+    for (i = 0; i < attribs; i++)
+        OZONE_GL(glDisableVertexAttribArray)(i);
+
+    OZONE_GL(glActiveTexture)(GL_TEXTURE0);
+    OZONE_GL(glBindTexture)(GL_TEXTURE_2D, userData->tiles[0].textureId);
+    OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
 void ozone_egl_textureDraw ( ozone_egl_UserData *userData)
 {
-                         
-   GLfloat vVertices[] = { -0.96f,  0.96f, 0.0f,  // Position 0
-                            0.0f,  0.0f,        // TexCoord 0 
-                           -0.96f, -0.96f, 0.0f,  // Position 1
-                            0.0f,  1.0f,        // TexCoord 1
-                            0.96f, -0.96f, 0.0f,  // Position 2
-                            1.0f,  1.0f,        // TexCoord 2
-                            0.96f,  0.96f, 0.0f,  // Position 3
-                            1.0f,  0.0f         // TexCoord 3
-                         };                    
-                 
    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+   int left = userData->width, top = userData->height, right = 0, bottom = 0;
+   int i, startRow, full;
+   uint64_t start = ozone_egl_nowUsec();
    
-   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, userData->width, userData->height, userData->colorType, GL_UNSIGNED_BYTE, userData->data); 
+   // Nothing to draw if ozone_egl_textureInit() failed
+   if ( !userData->tiles || !ozone_egl_makecurrent() )
+      return;
+
+   // Upload the damaged tiles. A NULL data pointer redraws the last upload,
+   // e.g. for cursor motion.
+   if (userData->data)
+   {
+      // RGB rows of odd tile widths are not 4-byte aligned
+      if (userData->opaque)
+         OZONE_GL(glPixelStorei) ( GL_UNPACK_ALIGNMENT, 1 );
+      for (i = 0; i < userData->tileCols * userData->tileRows; i++)
+      {
+         ozone_egl_Tile* tile = &userData->tiles[i];
+
+         if (tile->state == OZONE_EGL_TILE_CLEAN ||
+             !ozone_egl_uploadTile(userData, tile))
+            continue;
+         tile->stale = 1;
+         if (tile->x < left)
+            left = tile->x;
+         if (tile->y < top)
+            top = tile->y;
+         if (tile->x + tile->width > right)
+            right = tile->x + tile->width;
+         if (tile->y + tile->height > bottom)
+            bottom = tile->y + tile->height;
+      }
+      if (userData->opaque)
+         OZONE_GL(glPixelStorei) ( GL_UNPACK_ALIGNMENT, 4 );
+   }
+   else
+   {
+      // The software cursor may have moved anywhere
+      left = 0;
+      top = 0;
+      right = userData->width;
+      bottom = userData->height;
+   }
+   if (userData->hashTiles)
+      ozone_egl_collectHashStats(userData);
+
+   // Keep the window size and cursor steady until the frame is drawn
+   ozone_egl_StateLock lock;
+   if (left < right && top < bottom)
+      ozone_egl_captureCanvasDamage(userData, left, top, right - left, bottom - top);
+   if (userData->renderTarget)
+      ozone_egl_resetRenderState ( userData );
       
    // Set the viewport
-   glViewport ( 0, 0, g_WindowWidth, g_WindowHeight );
+   OZONE_GL_STATE("viewport", ((uint64_t)g_State.windowWidth << 32) | g_State.windowHeight);
+   OZONE_GL(glViewport) ( 0, 0, g_State.windowWidth, g_State.windowHeight );
    
-   // Clear the color buffer
-   glClear ( GL_COLOR_BUFFER_BIT );
+   // A front buffer still shows the last draw; redraw the changed tiles and
+   // those the software cursor leaves or enters, unless something else drew
+   // over the window since.
+   full = !g_State.frontBuffer || g_State.frontBufferOwner != userData ||
+          userData->renderTarget;
+   startRow = 0;
+   if (!full)
+   {
+      if (g_State.cursor.drawnWidth)
+         ozone_egl_textureStale ( userData, g_State.cursor.drawnX - 1,
+                                  g_State.cursor.drawnY - 1,
+                                  g_State.cursor.drawnWidth + 2,
+                                  g_State.cursor.drawnHeight + 2 );
+      if (g_State.cursor.pixels && !g_State.cursor.hardware)
+         ozone_egl_textureStale ( userData,
+                                  g_State.cursor.x - g_State.cursor.hot_x - 1,
+                                  g_State.cursor.y - g_State.cursor.hot_y - 1,
+                                  g_State.cursor.width + 2,
+                                  g_State.cursor.height + 2 );
+      startRow = ozone_egl_frontBufferStartRow ( userData );
+   }
 
-   // Use the program object
-   glUseProgram ( userData->programObject );
+   // Clear the border around the inset quad. An opaque canvas covers every
+   // pixel, and nothing behind it needs blending.
+   if (!userData->opaque && full)
+      OZONE_GL(glClear) ( GL_COLOR_BUFFER_BIT );
+   OZONE_GL(glDisable) ( GL_BLEND );
 
-   // Load the vertex position
-   glVertexAttribPointer ( userData->positionLoc, 3, GL_FLOAT, 
-                           GL_FALSE, 5 * sizeof(GLfloat), vVertices );
-   // Load the texture coordinate
-   glVertexAttribPointer ( userData->texCoordLoc, 2, GL_FLOAT,
-                           GL_FALSE, 5 * sizeof(GLfloat), &vVertices[3] );
+   // Use the program object
+   OZONE_GL_STATE("program", userData->programObject);
+   OZONE_GL(glUseProgram) ( userData->programObject );
 
-   glEnableVertexAttribArray ( userData->positionLoc );
-   glEnableVertexAttribArray ( userData->texCoordLoc );
+   OZONE_GL(glEnableVertexAttribArray) ( userData->positionLoc );
+   OZONE_GL(glEnableVertexAttribArray) ( userData->texCoordLoc );
 
-   // Bind the texture
-   glActiveTexture ( GL_TEXTURE0 );
-   glBindTexture ( GL_TEXTURE_2D, userData->textureId );
+   OZONE_GL(glActiveTexture) ( GL_TEXTURE0 );
 
    // Set the sampler texture unit to 0
-   glUniform1i ( userData->samplerLoc, 0 );
+   OZONE_GL(glUniform1i) ( userData->samplerLoc, 0 );
 
-   glDrawElements ( GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices );
+   // One quad per tile, together covering the canvas rectangle
+   for (i = 0; i < userData->tileCols * userData->tileRows; i++)
+   {
+      int row = (startRow + i / userData->tileCols) % userData->tileRows;
+      ozone_egl_Tile* tile =
+         &userData->tiles[row * userData->tileCols + i % userData->tileCols];
+
+      // Send the rows ahead of the beam off before those behind it
+      if (startRow && i == (userData->tileRows - startRow) * userData->tileCols)
+         OZONE_GL(glFlush) ( );
+      if (!full && !tile->stale)
+         continue;
+      tile->stale = 0;
+
+      GLfloat extent = ozone_egl_canvasExtent(userData);
+      GLfloat left = -extent + 2 * extent * tile->x / userData->width;
+      GLfloat right = -extent + 2 * extent * (tile->x + tile->width) / userData->width;
+      GLfloat top = extent - 2 * extent * tile->y / userData->height;
+      GLfloat bottom = extent - 2 * extent * (tile->y + tile->height) / userData->height;
+      // The tile inside its bordered texture
+      GLfloat s0 = (GLfloat)(tile->x - tile->texX) / tile->texWidth;
+      GLfloat s1 = (GLfloat)(tile->x + tile->width - tile->texX) / tile->texWidth;
+      GLfloat t0 = (GLfloat)(tile->y - tile->texY) / tile->texHeight;
+      GLfloat t1 = (GLfloat)(tile->y + tile->height - tile->texY) / tile->texHeight;
+      GLfloat vVertices[] = { left,  top,    0.0f,  // Position 0
+                              s0,    t0,            // TexCoord 0 
+                              left,  bottom, 0.0f,  // Position 1
+                              s0,    t1,            // TexCoord 1
+                              right, bottom, 0.0f,  // Position 2
+                              s1,    t1,            // TexCoord 2
+                              right, top,    0.0f,  // Position 3
+                              s1,    t0             // TexCoord 3
+                            };
+      ozone_egl_transformVertices ( vVertices, 4, 5 );
+
+      // Load the vertex position
+      OZONE_GL(glVertexAttribPointer) ( userData->positionLoc, 3, GL_FLOAT, 
+                              GL_FALSE, 5 * sizeof(GLfloat), vVertices );
+      // Load the texture coordinate
+      OZONE_GL(glVertexAttribPointer) ( userData->texCoordLoc, 2, GL_FLOAT,
+                              GL_FALSE, 5 * sizeof(GLfloat), &vVertices[3] );
+
+      // Bind the texture
+      OZONE_GL_STATE("texture", tile->textureId);
+      OZONE_GL(glBindTexture) ( GL_TEXTURE_2D, tile->textureId );
+
+      OZONE_GL(glDrawElements) ( GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices );
+   }
+   if (g_State.frontBuffer)
+      g_State.frontBufferOwner = userData;
 
+   ozone_egl_cursorDraw(userData);
+   OZONE_GL_CHECK_ERROR();
+   ozone_egl_telemetryDraw(ozone_egl_nowUsec() - start);
 }
 
 
 void ozone_egl_textureShutDown ( ozone_egl_UserData *userData )
 {
-   // Delete texture object
-   glDeleteTextures ( 1, &(userData->textureId) );
+   int i;
+   // The objects died with the context if it is gone
+   int current = ozone_egl_makecurrent();
+
+   // Delete texture objects
+   for (i = 0; userData->tiles && i < userData->tileCols * userData->tileRows; i++)
+   {
+      if (current)
+         OZONE_GL(glDeleteTextures) ( 1, &(userData->tiles[i].textureId) );
+      free(userData->tiles[i].packed);
+   }
+   free(userData->tiles);
+   userData->tiles = NULL;
+   userData->tileCols = 0;
+   userData->tileRows = 0;
+   userData->textureId = 0;
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   if (current)
+      OZONE_GL(glDeleteProgram) ( userData->programObject );
+   userData->programObject = 0;
+
+   // A canvas set up again at the same address starts with a full draw
+   ozone_egl_StateLock lock;
+   if (g_State.frontBufferOwner == userData)
+      g_State.frontBufferOwner = NULL;
+}
+
+uint64_t ozone_egl_textureTrim(ozone_egl_UserData* userData)
+{
+    uint64_t bytes = 0;
+    int i;
+
+    for (i = 0; userData->tiles && i < userData->tileCols * userData->tileRows; i++)
+    {
+        ozone_egl_Tile* tile = &userData->tiles[i];
+
+        if (!tile->packed)
+            continue;
+        bytes += (uint64_t)tile->texWidth * tile->texHeight *
+                 ozone_egl_uploadBytesPerPixel(userData);
+        free(tile->packed);
+        tile->packed = NULL;
+    }
+    return bytes;
+}
+
+uint64_t ozone_egl_textureRelease(ozone_egl_UserData* userData)
+{
+    uint64_t bytes;
+
+    if (!userData->tiles)
+        return 0;
+
+    bytes = ozone_egl_textureTrim(userData) +
+            (uint64_t)userData->width * userData->height *
+            ozone_egl_uploadBytesPerPixel(userData);
+    if (ozone_egl_makecurrent())
+        ozone_egl_cacheProgramBinary(userData->programObject);
+    ozone_egl_textureShutDown(userData);
+    return bytes;
+}
+
+static const char kVideoVertexShader[] =
+    "attribute vec4 a_position;   \n"
+    "attribute vec2 a_texCoord;   \n"
+    "varying vec2 v_texCoord;     \n"
+    "void main()                  \n"
+    "{                            \n"
+    "   gl_Position = a_position; \n"
+    "   v_texCoord = a_texCoord;  \n"
+    "}                            \n";
+
+// Chroma is sampled at half resolution with linear filtering; the matrix
+// and offset pick the colour space and range.
+static const char kVideoI420FragmentShader[] =
+    "precision mediump float;                              \n"
+    "varying vec2 v_texCoord;                              \n"
+    "uniform sampler2D s_y;                                \n"
+    "uniform sampler2D s_u;                                \n"
+    "uniform sampler2D s_v;                                \n"
+    "uniform mat3 u_yuvToRgb;                              \n"
+    "uniform vec3 u_offset;                                \n"
+    "void main()                                           \n"
+    "{                                                     \n"
+    "  vec3 yuv = vec3(texture2D(s_y, v_texCoord).r,       \n"
+    "                  texture2D(s_u, v_texCoord).r,       \n"
+    "                  texture2D(s_v, v_texCoord).r);      \n"
+    "  gl_FragColor = vec4(u_yuvToRgb * (yuv - u_offset), 1.0);\n"
+    "}                                                     \n";
+
+// The interleaved UV plane is uploaded as GL_LUMINANCE_ALPHA.
+static const char kVideoNV12FragmentShader[] =
+    "precision mediump float;                              \n"
+    "varying vec2 v_texCoord;                              \n"
+    "uniform sampler2D s_y;                                \n"
+    "uniform sampler2D s_uv;                               \n"
+    "uniform mat3 u_yuvToRgb;                              \n"
+    "uniform vec3 u_offset;                                \n"
+    "void main()                                           \n"
+    "{                                                     \n"
+    "  vec3 yuv = vec3(texture2D(s_y, v_texCoord).r,       \n"
+    "                  texture2D(s_uv, v_texCoord).ra);    \n"
+    "  gl_FragColor = vec4(u_yuvToRgb * (yuv - u_offset), 1.0);\n"
+    "}                                                     \n";
+
+static const char kVideoExternalFragmentShader[] =
+    "#extension GL_OES_EGL_image_external : require        \n"
+    "precision mediump float;                              \n"
+    "varying vec2 v_texCoord;                              \n"
+    "uniform samplerExternalOES s_texture;                 \n"
+    "void main()                                           \n"
+    "{                                                     \n"
+    "  gl_FragColor = texture2D(s_texture, v_texCoord);    \n"
+    "}                                                     \n";
+
+// Column-major YUV to RGB matrices: the columns scale Y, Cb and Cr.
+static const GLfloat kBT601Full[9] = {
+    1.0f,      1.0f,       1.0f,
+    0.0f,     -0.344136f,  1.772f,
+    1.402f,   -0.714136f,  0.0f,
+};
+static const GLfloat kBT601Limited[9] = {
+    1.164384f, 1.164384f,  1.164384f,
+    0.0f,     -0.391762f,  2.017232f,
+    1.596027f,-0.812968f,  0.0f,
+};
+static const GLfloat kBT709Full[9] = {
+    1.0f,      1.0f,       1.0f,
+    0.0f,     -0.187324f,  1.8556f,
+    1.5748f,  -0.468124f,  0.0f,
+};
+static const GLfloat kBT709Limited[9] = {
+    1.164384f, 1.164384f,  1.164384f,
+    0.0f,     -0.213249f,  2.112402f,
+    1.792741f,-0.532909f,  0.0f,
+};
+
+static int ozone_egl_videoPlaneCount(const ozone_egl_VideoData* video)
+{
+    return video->format == OZONE_EGL_VIDEO_NV12 ? 2 : 3;
+}
+
+static void ozone_egl_videoPlaneSize(const ozone_egl_VideoData* video,
+                                     int plane, GLint* width, GLint* height,
+                                     GLenum* format, int* bpp)
+{
+    *width = plane ? (video->width + 1) / 2 : video->width;
+    *height = plane ? (video->height + 1) / 2 : video->height;
+    *format = GL_LUMINANCE;
+    *bpp = 1;
+    if (plane && video->format == OZONE_EGL_VIDEO_NV12)
+    {
+        *format = GL_LUMINANCE_ALPHA;
+        *bpp = 2;
+    }
+}
+
+int ozone_egl_videoInit(ozone_egl_VideoData* video)
+{
+    static const char* kSamplers[] = { "s_y", "s_u", "s_v" };
+    int planes = ozone_egl_videoPlaneCount(video);
+    int i;
+
+    if (!ozone_egl_makecurrent())
+        return OZONE_EGL_FAILURE;
+
+    video->programObject = ozone_egl_loadProgram(
+        kVideoVertexShader, video->format == OZONE_EGL_VIDEO_NV12 ?
+            kVideoNV12FragmentShader : kVideoI420FragmentShader);
+    if (!video->programObject)
+        return OZONE_EGL_FAILURE;
+
+    video->positionLoc = OZONE_GL(glGetAttribLocation)(video->programObject,
+                                                       "a_position");
+    video->texCoordLoc = OZONE_GL(glGetAttribLocation)(video->programObject,
+                                                       "a_texCoord");
+    video->matrixLoc = OZONE_GL(glGetUniformLocation)(video->programObject,
+                                                      "u_yuvToRgb");
+    video->offsetLoc = OZONE_GL(glGetUniformLocation)(video->programObject,
+                                                      "u_offset");
+
+    for (i = 0; i < planes; i++)
+    {
+        GLint width, height;
+        GLenum format;
+        int bpp;
+
+        video->samplerLoc[i] = OZONE_GL(glGetUniformLocation)(
+            video->programObject,
+            (i == 1 && planes == 2) ? "s_uv" : kSamplers[i]);
+
+        ozone_egl_videoPlaneSize(video, i, &width, &height, &format, &bpp);
+        OZONE_GL(glGenTextures)(1, &video->textureId[i]);
+        OZONE_GL(glBindTexture)(GL_TEXTURE_2D, video->textureId[i]);
+        OZONE_GL(glTexImage2D)(GL_TEXTURE_2D, 0, format, width, height, 0,
+                               format, GL_UNSIGNED_BYTE, NULL);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        OZONE_GL(glTexParameteri)(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    video->external = 0;
+    return OZONE_EGL_SUCCESS;
+}
+
+int ozone_egl_videoImportImage(ozone_egl_VideoData* video, EGLImageKHR image)
+{
+    PFNGLEGLIMAGETARGETTEXTURE2DOESPROC imageTargetTexture;
+    const char* extensions;
+
+    if (!ozone_egl_makecurrent())
+        return OZONE_EGL_FAILURE;
+
+    if (!video->externalProgram)
+    {
+        extensions = (const char*)OZONE_GL(glGetString)(GL_EXTENSIONS);
+        if (!extensions || !strstr(extensions, "GL_OES_EGL_image_external"))
+            return OZONE_EGL_FAILURE;
+        video->externalProgram = ozone_egl_loadProgram(
+            kVideoVertexShader, kVideoExternalFragmentShader);
+        if (!video->externalProgram)
+            return OZONE_EGL_FAILURE;
+        video->externalPositionLoc = OZONE_GL(glGetAttribLocation)(
+            video->externalProgram, "a_position");
+        video->externalTexCoordLoc = OZONE_GL(glGetAttribLocation)(
+            video->externalProgram, "a_texCoord");
+        video->externalSamplerLoc = OZONE_GL(glGetUniformLocation)(
+            video->externalProgram, "s_texture");
+        OZONE_GL(glGenTextures)(1, &video->externalTextureId);
+    }
+
+    imageTargetTexture = (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)
+        eglGetProcAddress("glEGLImageTargetTexture2DOES");
+    if (!imageTargetTexture)
+        return OZONE_EGL_FAILURE;
+
+    OZONE_GL(glBindTexture)(GL_TEXTURE_EXTERNAL_OES, video->externalTextureId);
+    OZONE_GL(glTexParameteri)(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    OZONE_GL(glTexParameteri)(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    imageTargetTexture(GL_TEXTURE_EXTERNAL_OES, (GLeglImageOES)image);
+    if (OZONE_GL(glGetError)() != GL_NO_ERROR)
+        return OZONE_EGL_FAILURE;
+
+    video->external = 1;
+    return OZONE_EGL_SUCCESS;
+}
+
+static void ozone_egl_videoUpload(ozone_egl_VideoData* video)
+{
+    int planes = ozone_egl_videoPlaneCount(video);
+    int i, row;
+
+    // Odd chroma widths leave rows that are not 4-byte aligned.
+    OZONE_GL(glPixelStorei)(GL_UNPACK_ALIGNMENT, 1);
+    for (i = 0; i < planes; i++)
+    {
+        GLint width, height;
+        GLenum format;
+        int bpp;
+        const uint8_t* pixels = video->planes[i];
+        int row_bytes;
+
+        ozone_egl_videoPlaneSize(video, i, &width, &height, &format, &bpp);
+        row_bytes = width * bpp;
+        if (!pixels)
+            continue;
+
+        OZONE_GL(glBindTexture)(GL_TEXTURE_2D, video->textureId[i]);
+        if (video->strides[i] && video->strides[i] != row_bytes)
+        {
+            if (video->packedSize < (size_t)row_bytes * height)
+            {
+                free(video->packed);
+                video->packed = (uint8_t*)malloc((size_t)row_bytes * height);
+                video->packedSize = video->packed ?
+                    (size_t)row_bytes * height : 0;
+            }
+            if (!video->packed)
+            {
+                // No memory for the copy: one upload per row instead
+                for (row = 0; row < height; row++)
+                    OZONE_GL(glTexSubImage2D)(GL_TEXTURE_2D, 0, 0, row,
+                                              width, 1, format,
+                                              GL_UNSIGNED_BYTE,
+                                              pixels + row * video->strides[i]);
+                pixels = NULL;
+            }
+            else
+            {
+                for (row = 0; row < height; row++)
+                    memcpy(video->packed + row * row_bytes,
+                           pixels + row * video->strides[i], row_bytes);
+                pixels = video->packed;
+            }
+        }
+
+        if (pixels)
+            OZONE_GL(glTexSubImage2D)(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                                      format, GL_UNSIGNED_BYTE, pixels);
+        OZONE_GL_UPLOAD_BYTES(row_bytes * height);
+        ozone_egl_telemetryUpload(row_bytes * height);
+    }
+    OZONE_GL(glPixelStorei)(GL_UNPACK_ALIGNMENT, 4);
+    video->external = 0;
+}
+
+void ozone_egl_videoDraw(ozone_egl_VideoData* video,
+                         int x, int y, int width, int height)
+{
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GLfloat left, right, top, bottom;
+    GLint positionLoc, texCoordLoc;
+    int planes = ozone_egl_videoPlaneCount(video);
+    int screen_width, screen_height;
+    int i;
+
+    if (!ozone_egl_makecurrent())
+        return;
+
+    if (video->planes[0])
+        ozone_egl_videoUpload(video);
+
+    ozone_egl_StateLock lock;
+    if (!g_State.windowWidth || !g_State.windowHeight)
+        return;
+
+    ozone_egl_screenSize(&screen_width, &screen_height);
+    left = -1.0f + 2.0f * x / screen_width;
+    right = -1.0f + 2.0f * (x + width) / screen_width;
+    top = 1.0f - 2.0f * y / screen_height;
+    bottom = 1.0f - 2.0f * (y + height) / screen_height;
+
+    GLfloat vVertices[] = { left,  top,    0.0f, 0.0f, 0.0f,
+                            left,  bottom, 0.0f, 0.0f, 1.0f,
+                            right, bottom, 0.0f, 1.0f, 1.0f,
+                            right, top,    0.0f, 1.0f, 0.0f };
+    ozone_egl_transformVertices(vVertices, 4, 5);
+    ozone_egl_transformRect(&x, &y, &width, &height);
+
+    OZONE_GL_STATE("viewport",
+                   ((uint64_t)g_State.windowWidth << 32) | g_State.windowHeight);
+    OZONE_GL(glViewport)(0, 0, g_State.windowWidth, g_State.windowHeight);
+    ozone_egl_captureDamage(x, y, width, height);
+
+    if (video->external)
+    {
+        OZONE_GL_STATE("program", video->externalProgram);
+        OZONE_GL(glUseProgram)(video->externalProgram);
+        positionLoc = video->externalPositionLoc;
+        texCoordLoc = video->externalTexCoordLoc;
+        OZONE_GL(glActiveTexture)(GL_TEXTURE0);
+        OZONE_GL(glBindTexture)(GL_TEXTURE_EXTERNAL_OES,
+                                video->externalTextureId);
+        OZONE_GL(glUniform1i)(video->externalSamplerLoc, 0);
+    }
+    else
+    {
+        const GLfloat* matrix;
+        GLfloat offset[3];
+
+        if (video->colorSpace == OZONE_EGL_VIDEO_BT709)
+            matrix = video->fullRange ? kBT709Full : kBT709Limited;
+        else
+            matrix = video->fullRange ? kBT601Full : kBT601Limited;
+        offset[0] = video->fullRange ? 0.0f : 16.0f / 255.0f;
+        offset[1] = 128.0f / 255.0f;
+        offset[2] = 128.0f / 255.0f;
+
+        OZONE_GL_STATE("program", video->programObject);
+        OZONE_GL(glUseProgram)(video->programObject);
+        positionLoc = video->positionLoc;
+        texCoordLoc = video->texCoordLoc;
+        OZONE_GL(glUniformMatrix3fv)(video->matrixLoc, 1, GL_FALSE, matrix);
+        OZONE_GL(glUniform3fv)(video->offsetLoc, 1, offset);
+        for (i = 0; i < planes; i++)
+        {
+            OZONE_GL(glActiveTexture)(GL_TEXTURE0 + i);
+            OZONE_GL(glBindTexture)(GL_TEXTURE_2D, video->textureId[i]);
+            OZONE_GL(glUniform1i)(video->samplerLoc[i], i);
+        }
+    }
+
+    OZONE_GL(glEnableVertexAttribArray)(positionLoc);
+    OZONE_GL(glEnableVertexAttribArray)(texCoordLoc);
+    OZONE_GL(glVertexAttribPointer)(positionLoc, 3, GL_FLOAT, GL_FALSE,
+                                    5 * sizeof(GLfloat), vVertices);
+    OZONE_GL(glVertexAttribPointer)(texCoordLoc, 2, GL_FLOAT, GL_FALSE,
+                                    5 * sizeof(GLfloat), &vVertices[3]);
+    OZONE_GL(glDisable)(GL_BLEND);
+    OZONE_GL(glDrawElements)(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
+    // A front buffer keeps the video where the canvas is not redrawn.
+    g_State.frontBufferOwner = NULL;
+
+    // The canvas program samples unit 0.
+    OZONE_GL(glActiveTexture)(GL_TEXTURE0);
+    OZONE_GL_CHECK_ERROR();
+}
+
+void ozone_egl_videoShutDown(ozone_egl_VideoData* video)
+{
+    int current = ozone_egl_makecurrent();
+    int i;
+
+    for (i = 0; current && i < 3; i++)
+    {
+        if (video->textureId[i])
+            OZONE_GL(glDeleteTextures)(1, &video->textureId[i]);
+    }
+    if (current && video->externalTextureId)
+        OZONE_GL(glDeleteTextures)(1, &video->externalTextureId);
+    if (current)
+    {
+        OZONE_GL(glDeleteProgram)(video->programObject);
+        OZONE_GL(glDeleteProgram)(video->externalProgram);
+    }
+    memset(video->textureId, 0, sizeof(video->textureId));
+    video->externalTextureId = 0;
+    video->programObject = 0;
+    video->externalProgram = 0;
+    video->external = 0;
+
+    free(video->packed);
+    video->packed = NULL;
+    video->packedSize = 0;
 }
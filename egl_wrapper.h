@@ -4,35 +4,69 @@
 #ifndef UI_OZONE_EGL_WRAPPER_H_
 #define UI_OZONE_EGL_WRAPPER_H_
 
+#include <stdint.h>
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
-#include <EGL/egl.h>
 
 #define OZONE_EGL_SUCCESS 1
 #define OZONE_EGL_FAILURE 0
 
-#define GLCheckError() \
-    {                                                                \
-        GLint err = glGetError();                                    \
-        if (err != GL_NO_ERROR)                                      \
-        {                                                            \
-            fprintf(stderr, "\nfunction: %s, line: %d, err: 0x%x\n", \
-                    __FUNCTION__, __LINE__, err);                              \
-            return HI_FAILURE;                                       \
-        }                                                            \
-    }
-
-#define EGLCheckError() \
-    {                                                                \
-        GLint err = eglGetError();                                   \
-        if (err != EGL_SUCCESS)                                      \
-        {                                                            \
-            fprintf(stderr, "\nfunction: %s, line: %d, err: 0x%x\n", \
-                    __FUNCTION__, __LINE__, err);                              \
-            return HI_FAILURE;                                       \
-        }                                                            \
-    }
+#define OZONE_EGL_TILE_CLEAN   0
+#define OZONE_EGL_TILE_DAMAGED 1
+#define OZONE_EGL_TILE_PACKED  2
+
+// One texture of the canvas grid. Canvases wider or taller than
+// GL_MAX_TEXTURE_SIZE (2048 on VideoCore IV and older Vivante cores) are
+// split into several of these.
+typedef struct
+{
+   GLuint textureId;
+
+   // Tile rectangle in canvas pixels
+   GLint x;
+   GLint y;
+   GLint width;
+   GLint height;
+
+   // Rectangle the texture holds: the tile plus a one pixel border shared
+   // with its neighbours, so linear filtering of a scaled canvas blends
+   // across tile edges instead of clamping at them
+   GLint texX;
+   GLint texY;
+   GLint texWidth;
+   GLint texHeight;
+
+   // OZONE_EGL_TILE_*
+   int state;
+
+   // Tightly packed copy of the texture's rows, for tiles narrower than the
+   // canvas (GLES2 has no GL_UNPACK_ROW_LENGTH)
+   char * packed;
 
+   // Content hash of the uploaded pixels, with OZONE_EGL_TILE_HASH
+   uint64_t hash;
+   int hashValid;
+   // Set when a hash was taken since the last draw, which took hashUsec
+   // and found the tile unchanged or not
+   int hashTaken;
+   int hashUnchanged;
+   uint64_t hashUsec;
+
+   // Set when the tile changed since a front buffer last showed it
+   int stale;
+} ozone_egl_Tile;
+
+// Totals since ozone_egl_textureInit() for content-hash damage correction.
+typedef struct
+{
+   uint64_t tilesHashed;
+   uint64_t tilesSkipped;
+   uint64_t bytesHashed;
+   // Upload bytes avoided because a damaged tile hashed unchanged
+   uint64_t bytesSaved;
+   uint64_t hashUsec;
+} ozone_egl_TileHashStats;
 
 typedef struct
 {
@@ -46,7 +80,7 @@ typedef struct
    // Sampler location
    GLint samplerLoc;
 
-   // Texture handle
+   // Texture handle of the first tile
    GLuint textureId;
    
    GLint colorType;
@@ -54,20 +88,299 @@ typedef struct
    GLint height;
    char * data;
 
+   // Bytes between rows of |data|; 0 means tightly packed
+   GLint stride;
+
+   // Set when every pixel of |data| is opaque. The canvas then covers the
+   // whole window without a clear or blending, and tiles are uploaded as
+   // GL_RGB, dropping alpha while they are packed. Takes effect with
+   // ozone_egl_textureInit().
+   int opaque;
+
+   // Texture grid, set up by ozone_egl_textureInit()
+   GLint tileCols;
+   GLint tileRows;
+   ozone_egl_Tile * tiles;
+
+   // Set from OZONE_EGL_TILE_HASH: damaged tiles whose content hash did not
+   // change since their last upload are dropped from the damage
+   int hashTiles;
+   ozone_egl_TileHashStats hashStats;
+
+   // Bytes uploaded into the tile textures since ozone_egl_textureInit(),
+   // after tiles that hashed unchanged were dropped
+   uint64_t uploadBytes;
+
+   // Set when the canvas is rendered on the GPU, e.g. by Skia through an
+   // FBO, rather than uploaded from |data|. ozone_egl_textureInit() then
+   // makes one GL_RGBA texture covering the canvas, or clears this if the
+   // canvas does not fit in one, and ozone_egl_textureDraw() draws it with
+   // |data| NULL after restoring the GL state the renderer changed.
+   int renderTarget;
+
 } ozone_egl_UserData;
 
 
+// Video frame layouts for ozone_egl_VideoData
+#define OZONE_EGL_VIDEO_I420 0
+#define OZONE_EGL_VIDEO_NV12 1
+
+#define OZONE_EGL_VIDEO_BT601 0
+#define OZONE_EGL_VIDEO_BT709 1
+
+// Video shown through a second program that converts planar YUV in the
+// fragment shader, so neither the CPU conversion nor a 32-bit upload is
+// needed: luma is one byte per pixel and chroma a quarter of that per
+// plane.
+typedef struct
+{
+   // OZONE_EGL_VIDEO_I420 or OZONE_EGL_VIDEO_NV12
+   int format;
+   // OZONE_EGL_VIDEO_BT601 or OZONE_EGL_VIDEO_BT709
+   int colorSpace;
+   // Non-zero for full range (JPEG) levels, zero for studio swing
+   int fullRange;
+   GLint width;
+   GLint height;
+
+   // Planes of the next frame: Y, U, V for I420 and Y, interleaved UV for
+   // NV12, with |strides| bytes between rows (0 means tightly packed).
+   // ozone_egl_videoDraw() uploads them if planes[0] is set.
+   const uint8_t * planes[3];
+   GLint strides[3];
+
+   // Set by ozone_egl_videoInit()
+   GLuint programObject;
+   GLint positionLoc;
+   GLint texCoordLoc;
+   GLint samplerLoc[3];
+   GLint matrixLoc;
+   GLint offsetLoc;
+   GLuint textureId[3];
+
+   // GL_OES_EGL_image_external path, see ozone_egl_videoImportImage()
+   GLuint externalProgram;
+   GLint externalPositionLoc;
+   GLint externalTexCoordLoc;
+   GLint externalSamplerLoc;
+   GLuint externalTextureId;
+   int external;
+
+   // Row copies for planes whose stride differs from their width (GLES2
+   // has no GL_UNPACK_ROW_LENGTH)
+   uint8_t * packed;
+   size_t packedSize;
+} ozone_egl_VideoData;
+
+#define OZONE_EGL_MAX_OUTPUTS 4
+#define OZONE_EGL_MAX_MODES 32
+
+#define OZONE_EGL_OUTPUT_UNKNOWN     0
+#define OZONE_EGL_OUTPUT_INTERNAL    1
+#define OZONE_EGL_OUTPUT_VGA         2
+#define OZONE_EGL_OUTPUT_HDMI        3
+#define OZONE_EGL_OUTPUT_DVI         4
+#define OZONE_EGL_OUTPUT_DISPLAYPORT 5
+
+typedef struct
+{
+   int width;
+   int height;
+   // Hz, 0 if unknown
+   float refreshRate;
+   int interlaced;
+} ozone_egl_Mode;
+
+// A connected display head as reported by the backend.
+typedef struct
+{
+   int64_t id;
+   char name[32];
+   // OZONE_EGL_OUTPUT_*
+   int type;
+   // Position in the combined desktop, in pixels
+   int x;
+   int y;
+   // Physical size, 0 if unknown
+   int widthMm;
+   int heightMm;
+   // Indices into modes, -1 if none
+   int currentMode;
+   int nativeMode;
+   int modeCount;
+   ozone_egl_Mode modes[OZONE_EGL_MAX_MODES];
+} ozone_egl_Output;
+
+// Invoked once a presented frame has reached the screen. |usec| is the
+// CLOCK_MONOTONIC time of the flip in microseconds. Backends without flip
+// events call it right after the swap, on the presenting thread.
+typedef void (*ozone_egl_FlipCallback)(void* data, uint64_t usec);
+
+// How the flip times reported by the backend relate to the screen.
+// Frames are shown in phase with the output's refresh
+#define OZONE_EGL_PRESENT_VSYNC         0x1
+// The flip time is taken from the display hardware, not from the CPU
+#define OZONE_EGL_PRESENT_HW_CLOCK      0x2
+// The flip callback runs when the hardware reports scanout
+#define OZONE_EGL_PRESENT_HW_COMPLETION 0x4
+// The EGL buffer is scanned out directly, without a copy
+#define OZONE_EGL_PRESENT_ZERO_COPY     0x8
+
+// Display transform between the screen Chromium draws and the panel: the
+// content is mirrored left to right if FLIP_H is set, then rotated
+// clockwise. Quarter turns swap the screen's width and height.
+#define OZONE_EGL_TRANSFORM_NORMAL        0
+#define OZONE_EGL_TRANSFORM_ROT_90        1
+#define OZONE_EGL_TRANSFORM_ROT_180       2
+#define OZONE_EGL_TRANSFORM_ROT_270       3
+#define OZONE_EGL_TRANSFORM_ROTATION_MASK 3
+#define OZONE_EGL_TRANSFORM_FLIP_H        4
+// Mirrored top to bottom
+#define OZONE_EGL_TRANSFORM_FLIP_V \
+   (OZONE_EGL_TRANSFORM_ROT_180 | OZONE_EGL_TRANSFORM_FLIP_H)
+
+// Frame capture, e.g. for remote streaming. Frames drawn through
+// ozone_egl_textureDraw()/ozone_egl_videoDraw() are copied and scaled on
+// the GPU at swap time and read back a few frames later, with GLES3 pixel
+// pack buffers or behind EGL_KHR_fence_sync fences, so the swap never
+// waits for the readback.
+typedef struct
+{
+   // Window rectangle to capture; a zero width captures the whole window.
+   // Frames are captured as the panel shows them when the present pass
+   // applies the display transform.
+   int x;
+   int y;
+   int width;
+   int height;
+   // Size the rectangle is scaled to; 0 keeps its size
+   int scaledWidth;
+   int scaledHeight;
+   // Read back only the part that changed since the last captured frame
+   int damageOnly;
+   // Minimum time between captured frames, 0 for every frame
+   uint64_t intervalUsec;
+} ozone_egl_CaptureParams;
+
+// Runs on the swapping thread. |pixels| are RGBA rows |stride| bytes apart
+// covering (x, y, width, height) of the scaled capture, straight from the
+// GL mapping where there is one; they are only valid during the call, which
+// should copy or hand them off quickly. |usec| is the swap time of the
+// frame.
+typedef void (*ozone_egl_CaptureCallback)(void* data, const uint8_t* pixels,
+                                          int stride, int x, int y,
+                                          int width, int height,
+                                          uint64_t usec);
+
+// Probes the compiled-in backends (see egl_backend.h) and brings up the
+// first usable one. OZONE_EGL_BACKEND forces a backend by name and
+// OZONE_EGL_BACKEND_BENCHMARK=1 ranks all usable backends by speed once.
+// OZONE_EGL_FRONT_BUFFER=1 asks for a single buffered window surface, for
+// the lowest latency at the cost of tearing; ozone_egl_textureDraw() then
+// redraws only changed tiles, ordered against the scanout where its timing
+// is known, and the swap only flushes. Backends or drivers that cannot do
+// it fall back to double buffering.
 EGLint ozone_egl_setup(EGLint x, EGLint y, EGLint width, EGLint height );
 int     ozone_egl_destroy();
 int     ozone_egl_swap();
+int     ozone_egl_swapWithCallback(ozone_egl_FlipCallback callback, void* data);
+int     ozone_egl_present(ozone_egl_FlipCallback callback, void* data);
+int     ozone_egl_getVSyncParameters(uint64_t* timebase, uint64_t* interval);
+// OZONE_EGL_PRESENT_* flags of the active backend.
+int     ozone_egl_getPresentFlags();
+// Non-zero if OZONE_EGL_FRONT_BUFFER got a single buffered surface.
+int     ozone_egl_isFrontBuffer();
+// Fills |outputs| with the connected heads, the one the wrapper draws on
+// first, and returns how many there are. Backends that cannot enumerate
+// report a single output of the window size. The modes of the first output
+// are those of the screen, i.e. rotated by the display transform.
+int     ozone_egl_getOutputs(ozone_egl_Output* outputs, int max_outputs);
+// OZONE_EGL_TRANSFORM_* set through OZONE_EGL_ROTATION (0, 90, 180 or 270
+// degrees clockwise) and OZONE_EGL_FLIP (h or v). The backend applies it at
+// scanout where the display hardware can, the present pass of
+// ozone_egl_textureDraw()/ozone_egl_videoDraw() otherwise.
+int     ozone_egl_getTransform();
+// Maps a point in panel pixels, e.g. from a touchscreen mounted with the
+// panel, to screen pixels.
+void    ozone_egl_panelToScreen(float* x, float* y);
 NativeDisplayType ozone_egl_getNativedisp();
-EGLint * ozone_egl_getConfigAttribs();
+const EGLint * ozone_egl_getConfigAttribs();
+const char* ozone_egl_getBackendName();
 EGLDisplay ozone_egl_getdisp();
 EGLSurface ozone_egl_getsurface();
-void ozone_egl_makecurrent();
+// Makes the wrapper's context and window surface current on the calling
+// thread. The wrapper remembers what each thread has bound and skips the
+// call when nothing changed, so the texture functions below call it on
+// entry. Code that binds other contexts with EGL directly on a thread must
+// ozone_egl_releasecurrent() first, and a helper thread must release before
+// another thread can bind the context.
+int ozone_egl_makecurrent();
+void ozone_egl_releasecurrent();
+// eglMakeCurrent calls made and skipped during the last swapped frame.
+void ozone_egl_getMakeCurrentStats(uint32_t* switches, uint32_t* skipped);
+// Compiles and links a program, 0 on failure.
+GLuint ozone_egl_loadProgram(const char* vertShaderSrc,
+                             const char* fragShaderSrc);
 int ozone_egl_textureInit (ozone_egl_UserData * userData );
 void ozone_egl_textureDraw ( ozone_egl_UserData *userData );
 void ozone_egl_textureShutDown ( ozone_egl_UserData *userData );
+
+// Marks the tiles touching the given canvas rectangle for upload by the next
+// ozone_egl_textureDraw() with non-NULL data. ozone_egl_textureInit() marks
+// the whole grid.
+void ozone_egl_textureDamage(ozone_egl_UserData* userData,
+                             int x, int y, int width, int height);
+// Copies a damaged tile out of |data| ahead of the draw. Makes no GL calls,
+// so distinct tiles may be packed on worker threads; tiles that are not
+// packed here are packed by ozone_egl_textureDraw(). With hashTiles set, a
+// tile whose content did not change is marked clean instead.
+void ozone_egl_texturePackTile(ozone_egl_UserData* userData, int index);
+
+// Creates the plane textures and the conversion program for a video of the
+// given format and size. Returns OZONE_EGL_FAILURE if the program does not
+// build.
+int ozone_egl_videoInit(ozone_egl_VideoData* video);
+// Points the next draw at a frame the decoder exported as an EGLImage, which
+// the driver samples and converts itself. Fails without
+// GL_OES_EGL_image_external; the caller then uploads planes instead.
+// Setting planes[0] goes back to plane uploads.
+int ozone_egl_videoImportImage(ozone_egl_VideoData* video, EGLImageKHR image);
+// Draws the video into the screen rectangle (x, y, width, height) of the
+// frame being built, uploading new planes first. Swapping is left to the
+// caller.
+void ozone_egl_videoDraw(ozone_egl_VideoData* video,
+                         int x, int y, int width, int height);
+void ozone_egl_videoShutDown(ozone_egl_VideoData* video);
+
+// Frees the packed tile copies; the next draw recreates them as needed.
+// Returns the number of bytes freed.
+uint64_t ozone_egl_textureTrim(ozone_egl_UserData* userData);
+// Frees the textures, packed copies and program but keeps the canvas size,
+// so ozone_egl_textureInit() can bring it back with every tile damaged. The
+// program binary is cached where GL_OES_get_program_binary allows, so that
+// the shaders are not compiled again. Returns the number of bytes freed.
+uint64_t ozone_egl_textureRelease(ozone_egl_UserData* userData);
+
+// Destroys the EGL window surface while nothing is shown, keeping the
+// context. Swaps fail until ozone_egl_resume(). ozone_egl_suspend() returns
+// the estimated size of the released buffers.
+uint64_t ozone_egl_suspend();
+int ozone_egl_resume();
 NativeWindowType ozone_egl_GetNativeWin();
 
+// Replaces any running capture. Captures start with the next swap.
+int ozone_egl_captureStart(const ozone_egl_CaptureParams* params,
+                           ozone_egl_CaptureCallback callback, void* data);
+// Frames still in flight are dropped; the callback is not called again.
+void ozone_egl_captureStop();
+
+// Cursor layer. |pixels| are premultiplied N32 rows |stride| bytes apart, or
+// NULL to hide the cursor; (x, y) is the hotspot position in canvas pixels.
+// Both return OZONE_EGL_SUCCESS if a hardware plane shows the change, and
+// OZONE_EGL_FAILURE if the software cursor has to be redrawn with
+// ozone_egl_textureDraw().
+int ozone_egl_cursorSetImage(const void* pixels, int width, int height,
+                             int stride, int hot_x, int hot_y);
+int ozone_egl_cursorMove(int x, int y);
+
 #endif
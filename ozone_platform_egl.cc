@@ -5,7 +5,7 @@
 #include "ui/ozone/platform/egl/ozone_platform_egl.h"
 #include "ui/ozone/platform/egl/egl_surface_factory.h"
 
-#include "ui/ozone/common/native_display_delegate_ozone.h"
+#include "ui/ozone/common/bitmap_cursor_factory_ozone.h"
 #include "ui/ozone/common/stub_overlay_manager.h"
 #include "ui/ozone/public/cursor_factory_ozone.h"
 #include "ui/ozone/public/gpu_platform_support.h"
@@ -17,6 +17,10 @@
 #include "ui/ozone/public/ozone_platform.h"
 #include "ui/ozone/public/system_input_injector.h"
 #include "ui/platform_window/platform_window.h"
+#include "egl_cursor.h"
+#include "egl_gpu_platform_support.h"
+#include "egl_gpu_platform_support_host.h"
+#include "egl_native_display_delegate.h"
 #include "egl_window.h"
 #include "egl_wrapper.h"
 
@@ -59,14 +63,16 @@ class OzonePlatformEgl : public OzonePlatform {
     return event_factory_ozone_->CreateSystemInputInjector();
   }
   scoped_ptr<NativeDisplayDelegate> CreateNativeDisplayDelegate() override {
-    return scoped_ptr<NativeDisplayDelegate>(new NativeDisplayDelegateOzone());
+    return scoped_ptr<NativeDisplayDelegate>(
+        new EglNativeDisplayDelegate(surface_factory_ozone_.get()));
   }
   scoped_ptr<PlatformWindow> CreatePlatformWindow(
       PlatformWindowDelegate* delegate,
       const gfx::Rect& bounds) override {
       scoped_ptr<eglWindow> platform_window(
         new eglWindow(delegate, surface_factory_ozone_.get(),
-           event_factory_ozone_.get(), bounds));
+           event_factory_ozone_.get(), cursor_.get(),
+           gpu_platform_support_host_.get(), bounds));
       platform_window->Initialize();
       return platform_window.Pass();
   }
@@ -76,32 +82,38 @@ class OzonePlatformEgl : public OzonePlatform {
   void InitializeUI() override {
    device_manager_ = CreateDeviceManager();
    overlay_manager_.reset(new StubOverlayManager());
+    cursor_.reset(new EglCursor());
     KeyboardLayoutEngineManager::SetKeyboardLayoutEngine(
         make_scoped_ptr(new StubKeyboardLayoutEngine()));
     event_factory_ozone_.reset(new EventFactoryEvdev(
-        nullptr, device_manager_.get(),
+        cursor_.get(), device_manager_.get(),
         KeyboardLayoutEngineManager::GetKeyboardLayoutEngine()));
     if(!surface_factory_ozone_)
      surface_factory_ozone_.reset(new SurfaceFactoryEgl());
-    cursor_factory_ozone_.reset(new CursorFactoryOzone());
-    gpu_platform_support_host_.reset(CreateStubGpuPlatformSupportHost());
+    surface_factory_ozone_->SetCursor(cursor_.get());
+    cursor_factory_ozone_.reset(new BitmapCursorFactoryOzone());
+    gpu_platform_support_host_.reset(new EglGpuPlatformSupportHost());
   }
 
   void InitializeGPU() override {
     if(!surface_factory_ozone_)
      surface_factory_ozone_.reset(new SurfaceFactoryEgl());
-    cursor_factory_ozone_.reset(new CursorFactoryOzone());
-    gpu_platform_support_.reset(CreateStubGpuPlatformSupport());
+    // In single-process mode the UI side already installed its factory.
+    if (!cursor_factory_ozone_)
+      cursor_factory_ozone_.reset(new BitmapCursorFactoryOzone());
+    gpu_platform_support_.reset(new EglGpuPlatformSupport());
+    surface_factory_ozone_->SetGpuPlatformSupport(gpu_platform_support_.get());
  }
 
  private:
   scoped_ptr<DeviceManager> device_manager_;
+  scoped_ptr<EglCursor> cursor_;
   scoped_ptr<EventFactoryEvdev> event_factory_ozone_;
   scoped_ptr<SurfaceFactoryEgl> surface_factory_ozone_;
   scoped_ptr<CursorFactoryOzone> cursor_factory_ozone_;
 
-  scoped_ptr<GpuPlatformSupport> gpu_platform_support_;
-  scoped_ptr<GpuPlatformSupportHost> gpu_platform_support_host_;
+  scoped_ptr<EglGpuPlatformSupport> gpu_platform_support_;
+  scoped_ptr<EglGpuPlatformSupportHost> gpu_platform_support_host_;
   scoped_ptr<OverlayManagerOzone> overlay_manager_;
   DISALLOW_COPY_AND_ASSIGN(OzonePlatformEgl);
 };